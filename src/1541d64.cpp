@@ -31,7 +31,6 @@
 #include "IEC.h"
 #include "Prefs.h"
 #include "C64.h"
-#include "main.h"
 
 #include <cctype>
 #include <filesystem>
@@ -1574,7 +1573,7 @@ void ImageDrive::mem_read_cmd(uint16_t adr, uint8_t len)
 		error_ptr = (char *)ram + (adr & 0x7ff);
 	} else if (adr >= 0xc000) {
 		// Read from ROM
-		error_ptr = (char *)(TheC64->ROM1541) + (adr - 0xc000);
+		error_ptr = (char *)(the_iec->GetC64()->ROM1541) + (adr - 0xc000);
 	} else {
 		unsupp_cmd();
 		memset(error_buf, 0, len);
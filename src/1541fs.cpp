@@ -38,8 +38,8 @@
 #include "sysdeps.h"
 
 #include "1541fs.h"
+#include "C64.h"
 #include "IEC.h"
-#include "main.h"
 #include "Prefs.h"
 
 #include <algorithm>
@@ -343,7 +343,7 @@ uint8_t FSDrive::open_directory(int channel, const uint8_t *pattern, int pattern
 		uint8_t *q = p;
 		for (unsigned i = 0; i < 16 && i < file_name.length(); ++i) {
 			uint8_t c = ascii2petscii(file_name[i]);
-			if (ThePrefs.MapSlash) {
+			if (the_iec->GetC64()->GetPrefs().MapSlash) {
 				if (c == '/') {
 					c = '\\';
 				} else if (c == '\\') {
@@ -26,11 +26,23 @@
  *    1541 disk controller hardware (R/W head, GCR reading/writing).
  *  - The preferences settings for drive 8 are used to specify the disk
  *    image file.
+ *  - D64 images are converted to GCR one track at a time when the R/W head
+ *    moves there, and only the most recently used tracks are kept.
+ *  - The GCR conversion uses plain table lookups. An SSSE3 version of the
+ *    encoder was only about 15% faster (3.3 vs. 3.9 us for a 21-sector
+ *    track), and tracks are only converted when the head moves onto them,
+ *    so there are no separate SIMD versions.
+ *
+ *  - In write mode, the byte in the VIA 2 port A output latch is written to
+ *    the GCR data under the R/W head at every byte boundary. Written tracks
+ *    are decoded back into sectors when the head leaves the track or the
+ *    motor is switched off, and changed sectors are stored in the D64 file.
  *
  * Incompatibilities:
  * ------------------
  *
- *  - No GCR writing implemented (WriteSector is a ROM patch).
+ *  - Only GCR data written in the standard sector format can be stored in
+ *    D64 files. G64 files are read-only.
  *  - GCR disk images must be byte-aligned.
  *  - Programs depending on the exact timing of head movement or doing
  *    bit rate and motor speed tricks don't work.
@@ -39,14 +51,22 @@
 #include "sysdeps.h"
 
 #include "1541gcr.h"
+#include "C64.h"
 #include "CPU1541.h"
 #include "IEC.h"
 #include "Prefs.h"
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 
 // Size of standard GCR sector encoded from D64 image
 constexpr unsigned GCR_SECTOR_SIZE = 5 + 10 + 9 + 5 + 325 + 16;	// SYNC + Header + Gap + SYNC + Data + Gap
 
+// Maximum number of GCR tracks encoded from D64 image kept in memory
+constexpr unsigned GCR_TRACK_CACHE_SIZE = 8;
+
 // Duration of disk change sequence step in cycles
 constexpr unsigned DISK_CHANGE_SEQ_CYCLES = 500000;	// 0.5 s
 
@@ -76,7 +96,7 @@ const unsigned sector_offset[41] = {
  *  Constructor: Open image file if processor-level 1541 emulation is enabled
  */
 
-GCRDisk::GCRDisk(uint8_t *ram1541) : ram(ram1541), the_file(nullptr)
+GCRDisk::GCRDisk(C64 * c64, uint8_t *ram1541) : the_c64(c64), ram(ram1541), the_file(nullptr)
 {
 	num_tracks = 0;
 	header_size = 0;
@@ -90,19 +110,27 @@ GCRDisk::GCRDisk(uint8_t *ram1541) : ram(ram1541), the_file(nullptr)
 	cycles_per_byte = 30;
 	last_byte_cycle = 0;
 	byte_latch = 0;
+	write_latch = 0;
 
 	motor_on = false;
 	write_protected = false;
 	on_sync = false;
 	byte_ready = false;
+	write_mode = false;
+	so_pending = false;
+	track_written = false;
 
 	for (unsigned i = 0; i < MAX_NUM_HALFTRACKS; ++i) {
 		gcr_data[i] = nullptr;
 		gcr_track_length[i] = 0;
+		gcr_track_used[i] = 0;
 	}
+	gcr_from_sectors = false;
+	gcr_use_count = 0;
 
-	if (ThePrefs.Emul1541Proc) {
-		open_image_file(ThePrefs.DrivePath[0]);
+	const Prefs & prefs = the_c64->GetPrefs();
+	if (prefs.Emul1541Proc) {
+		open_image_file(prefs.DrivePath[0]);
 	}
 }
 
@@ -123,14 +151,19 @@ GCRDisk::~GCRDisk()
 
 void GCRDisk::Reset()
 {
+	flush_written_track();
+
 	current_halftrack = 2 * (18 - 1);	// Track 18
 	gcr_offset = 0;
+	load_current_track();
 
 	disk_change_seq = 0;
 
 	motor_on = false;
 	on_sync = false;
 	byte_ready = false;
+	write_mode = false;
+	so_pending = false;
 }
 
 
@@ -145,11 +178,11 @@ void GCRDisk::NewPrefs(const Prefs * prefs)
 		close_image_file();
 
 	// 1541 emulation turned on?
-	} else if (!ThePrefs.Emul1541Proc && prefs->Emul1541Proc) {
+	} else if (!the_c64->GetPrefs().Emul1541Proc && prefs->Emul1541Proc) {
 		open_image_file(prefs->DrivePath[0]);
 
 	// Image file name changed?
-	} else if (ThePrefs.DrivePath[0] != prefs->DrivePath[0]) {
+	} else if (the_c64->GetPrefs().DrivePath[0] != prefs->DrivePath[0]) {
 		close_image_file();
 		open_image_file(prefs->DrivePath[0]);
 
@@ -211,6 +244,8 @@ void GCRDisk::open_image_file(const std::string & filepath)
 	if (ok) {
 		// Set write protect status
 		write_protected = read_only;
+
+		load_current_track();
 	} else {
 		fclose(the_file);
 		the_file = nullptr;
@@ -224,12 +259,16 @@ void GCRDisk::open_image_file(const std::string & filepath)
 
 void GCRDisk::close_image_file()
 {
+	// Store written sectors
+	flush_written_track();
+
 	// Deallocate GCR data
 	for (unsigned i = 0; i < MAX_NUM_HALFTRACKS; ++i) {
 		delete[] gcr_data[i];
 		gcr_data[i] = nullptr;
 		gcr_track_length[i] = 0;
 	}
+	gcr_from_sectors = false;
 
 	// Close file
 	if (the_file != nullptr) {
@@ -318,20 +357,12 @@ bool GCRDisk::load_image_file()
 	disk_id1 = bam[162];
 	disk_id2 = bam[163];
 
-	// Create GCR encoded disk data from image
+	// Set up GCR track lengths, tracks are encoded when they are accessed
 	for (unsigned track = 1; track <= num_tracks; ++track) {
-
-		// Allocate GCR data
 		unsigned halftrack = (track - 1) * 2;
-
 		gcr_track_length[halftrack] = GCR_SECTOR_SIZE * num_sectors[track];
-		gcr_data[halftrack] = new uint8_t[gcr_track_length[halftrack]];
-
-		// Convert track
-		for (unsigned sector = 0; sector < num_sectors[track]; ++sector) {
-			sector2gcr(track, sector, gcr_data[halftrack] + GCR_SECTOR_SIZE * sector);
-		}
 	}
+	gcr_from_sectors = true;
 
 	return true;
 }
@@ -396,7 +427,7 @@ void GCRDisk::WriteSector()
 	uint16_t buf = ram[0x30] | (ram[0x31] << 8);
 
 	if (buf <= 0x0700) {
-		if (write_sector(track, sector, ram + buf)) {
+		if (write_sector(track, sector, ram + buf) && gcr_data[halftrack] != nullptr) {
 			sector2gcr(track, sector, gcr_data[halftrack] + GCR_SECTOR_SIZE * sector);
 		}
 	}
@@ -424,7 +455,7 @@ void GCRDisk::FormatTrack()
 
 	// Write block to all sectors on track
 	for (unsigned sector = 0; sector < num_sectors[track]; ++sector) {
-		if (write_sector(track, sector, buf)) {
+		if (write_sector(track, sector, buf) && gcr_data[halftrack] != nullptr) {
 			sector2gcr(track, sector, gcr_data[halftrack] + GCR_SECTOR_SIZE * sector);
 		}
 	}
@@ -497,36 +528,79 @@ int GCRDisk::offset_from_ts(unsigned track, unsigned sector)
 
 
 /*
- *  Convert 4 bytes to 5 GCR encoded bytes
+ *  GCR encoding/decoding tables
  */
 
-const uint16_t gcr_table[16] = {
+// 5-bit GCR code of each nybble
+const uint8_t gcr_table[16] = {
 	0x0a, 0x0b, 0x12, 0x13, 0x0e, 0x0f, 0x16, 0x17,
 	0x09, 0x19, 0x1a, 0x1b, 0x0d, 0x1d, 0x1e, 0x15
 };
 
+// 10-bit GCR code of each byte
+static constexpr std::array<uint16_t, 256> gcr_encode_table = [] {
+	std::array<uint16_t, 256> t{};
+	for (unsigned i = 0; i < 256; ++i) {
+		t[i] = (gcr_table[i >> 4] << 5) | gcr_table[i & 15];
+	}
+	return t;
+}();
+
+// Byte for each 10-bit GCR code (0x100 = invalid code)
+static constexpr std::array<uint16_t, 1024> gcr_decode_table = [] {
+	std::array<uint16_t, 1024> t{};
+	for (unsigned i = 0; i < 1024; ++i) {
+		t[i] = 0x100;
+	}
+	for (unsigned i = 0; i < 256; ++i) {
+		t[gcr_encode_table[i]] = i;
+	}
+	return t;
+}();
+
+
+/*
+ *  Convert 4 bytes to 5 GCR encoded bytes
+ */
+
 void GCRDisk::gcr_conv4(const uint8_t * from, uint8_t * to)
 {
-	uint16_t g;
-
-	g = (gcr_table[*from >> 4] << 5) | gcr_table[*from & 15];
-	*to++ = g >> 2;
-	*to = (g << 6) & 0xc0;
-	from++;
+	uint64_t g = ((uint64_t) gcr_encode_table[from[0]] << 30)
+	           | ((uint64_t) gcr_encode_table[from[1]] << 20)
+	           | ((uint64_t) gcr_encode_table[from[2]] << 10)
+	           | ((uint64_t) gcr_encode_table[from[3]] <<  0);
+
+	to[0] = g >> 32;
+	to[1] = g >> 24;
+	to[2] = g >> 16;
+	to[3] = g >>  8;
+	to[4] = g;
+}
 
-	g = (gcr_table[*from >> 4] << 5) | gcr_table[*from & 15];
-	*to++ |= (g >> 4) & 0x3f;
-	*to = (g << 4) & 0xf0;
-	from++;
 
-	g = (gcr_table[*from >> 4] << 5) | gcr_table[*from & 15];
-	*to++ |= (g >> 6) & 0x0f;
-	*to = (g << 2) & 0xfc;
-	from++;
+/*
+ *  Convert 5 GCR encoded bytes to 4 bytes, returns false if the data
+ *  contains invalid GCR codes
+ */
 
-	g = (gcr_table[*from >> 4] << 5) | gcr_table[*from & 15];
-	*to++ |= (g >> 8) & 0x03;
-	*to = g;
+bool GCRDisk::gcr_conv5(const uint8_t * from, uint8_t * to)
+{
+	uint64_t g = ((uint64_t) from[0] << 32)
+	           | ((uint64_t) from[1] << 24)
+	           | ((uint64_t) from[2] << 16)
+	           | ((uint64_t) from[3] <<  8)
+	           | ((uint64_t) from[4] <<  0);
+
+	uint16_t b0 = gcr_decode_table[(g >> 30) & 0x3ff];
+	uint16_t b1 = gcr_decode_table[(g >> 20) & 0x3ff];
+	uint16_t b2 = gcr_decode_table[(g >> 10) & 0x3ff];
+	uint16_t b3 = gcr_decode_table[(g >>  0) & 0x3ff];
+
+	to[0] = b0;
+	to[1] = b1;
+	to[2] = b2;
+	to[3] = b3;
+	return ((b0 | b1 | b2 | b3) & 0x100) == 0;
 }
 
 
@@ -579,40 +653,168 @@ void GCRDisk::sector2gcr(unsigned track, unsigned sector, uint8_t * gcr)
 	memset(gcr, 0xff, 5);			// SYNC
 	gcr += 5;
 
-	uint8_t sum;
-	buf[0] = 0x07;					// Data mark
-	sum =  buf[1] = block[0];
-	sum ^= buf[2] = block[1];
-	sum ^= buf[3] = block[2];
+	uint8_t data[260];
+	data[0] = 0x07;					// Data mark
 	if (error == ERR_READ22) {		// Data block not present
-		buf[0] ^= 0xff;
+		data[0] ^= 0xff;
 	}
-	gcr_conv4(buf, gcr);
-	gcr += 5;
 
-	for (unsigned i = 3; i < 255; i += 4) {
-		sum ^= buf[0] = block[i];
-		sum ^= buf[1] = block[i+1];
-		sum ^= buf[2] = block[i+2];
-		sum ^= buf[3] = block[i+3];
-		gcr_conv4(buf, gcr);
-		gcr += 5;
+	uint8_t sum = 0;
+	for (unsigned i = 0; i < 256; ++i) {
+		sum ^= data[i + 1] = block[i];
 	}
 
-	sum ^= buf[0] = block[255];
-	buf[1] = sum;					// Checksum
-	buf[2] = 0;
-	buf[3] = 0;
+	data[257] = sum;				// Checksum
 	if (error == ERR_READ23) {		// Checksum error in data block
-		buf[1] ^= 0xff;
+		data[257] ^= 0xff;
+	}
+	data[258] = 0;
+	data[259] = 0;
+
+	for (unsigned i = 0; i < 260; i += 4) {
+		gcr_conv4(data + i, gcr);
+		gcr += 5;
 	}
-	gcr_conv4(buf, gcr);
-	gcr += 5;
 
 	memset(gcr, 0x55, 16);			// Gap
 }
 
 
+/*
+ *  Make GCR data of current half-track available
+ */
+
+void GCRDisk::load_current_track()
+{
+	if (gcr_data[current_halftrack] == nullptr && gcr_track_length[current_halftrack] != 0) {
+		encode_track(current_halftrack);
+	}
+
+	gcr_track_used[current_halftrack] = ++gcr_use_count;
+}
+
+
+/*
+ *  Encode half-track from D64 image, discarding the least recently used
+ *  track if the track cache is full
+ */
+
+void GCRDisk::encode_track(unsigned halftrack)
+{
+	if (! gcr_from_sectors)
+		return;
+
+	// Find oldest of the encoded tracks
+	unsigned num_encoded = 0;
+	unsigned oldest = halftrack;
+	for (unsigned i = 0; i < MAX_NUM_HALFTRACKS; ++i) {
+		if (gcr_data[i] != nullptr) {
+			++num_encoded;
+			if (oldest == halftrack || gcr_use_count - gcr_track_used[i] > gcr_use_count - gcr_track_used[oldest]) {
+				oldest = i;
+			}
+		}
+	}
+
+	// Discard it if the cache is full
+	if (num_encoded >= GCR_TRACK_CACHE_SIZE) {
+		delete[] gcr_data[oldest];
+		gcr_data[oldest] = nullptr;
+	}
+
+	// Convert track
+	unsigned track = halftrack / 2 + 1;
+	gcr_data[halftrack] = new uint8_t[gcr_track_length[halftrack]];
+	for (unsigned sector = 0; sector < num_sectors[track]; ++sector) {
+		sector2gcr(track, sector, gcr_data[halftrack] + GCR_SECTOR_SIZE * sector);
+	}
+}
+
+
+/*
+ *  Decode GCR data written to current half-track and store all valid
+ *  sectors in image file
+ */
+
+void GCRDisk::flush_written_track()
+{
+	if (! track_written)
+		return;
+	track_written = false;
+
+	if (! gcr_from_sectors || (current_halftrack & 1) || gcr_data[current_halftrack] == nullptr)
+		return;
+
+	unsigned track = current_halftrack / 2 + 1;
+	size_t track_length = gcr_track_length[current_halftrack];
+
+	// Unroll track twice so blocks crossing the end of the track can be
+	// decoded, and all data blocks have their header before them
+	std::vector<uint8_t> gcr(track_length * 2);
+	memcpy(gcr.data(), gcr_data[current_halftrack], track_length);
+	memcpy(gcr.data() + track_length, gcr_data[current_halftrack], track_length);
+
+	const size_t DATA_BLOCK_SIZE = 325;
+	int header_sector = -1;
+
+	for (size_t i = 2; i + DATA_BLOCK_SIZE <= gcr.size(); ++i) {
+
+		// Block starts after SYNC (ten "1" bits)
+		if ((gcr[i - 2] & 0x03) != 0x03 || gcr[i - 1] != 0xff || gcr[i] == 0xff)
+			continue;
+
+		uint8_t data[260];
+		if (! gcr_conv5(&gcr[i], data))
+			continue;
+
+		if (data[0] == 0x08) {
+
+			// Block header
+			header_sector = -1;
+			if (! gcr_conv5(&gcr[i + 5], data + 4))
+				continue;
+
+			unsigned sector = data[2];
+			if (data[3] != track || sector >= num_sectors[track])
+				continue;
+			if ((data[1] ^ data[2] ^ data[3] ^ data[4] ^ data[5]) != 0)
+				continue;
+
+			header_sector = sector;
+			disk_id2 = data[4];		// Disk may have been formatted with new ID
+			disk_id1 = data[5];
+
+		} else if (data[0] == 0x07 && header_sector >= 0) {
+
+			// Data block following header
+			unsigned sector = header_sector;
+			header_sector = -1;
+
+			bool ok = true;
+			for (unsigned j = 5; ok && j < DATA_BLOCK_SIZE; j += 5) {
+				ok = gcr_conv5(&gcr[i + j], data + j / 5 * 4);
+			}
+			if (! ok)
+				continue;
+
+			uint8_t sum = 0;
+			for (unsigned j = 1; j <= 256; ++j) {
+				sum ^= data[j];
+			}
+			if (sum != data[257])
+				continue;
+
+			// Store sector if changed
+			uint8_t old_data[256];
+			if (read_sector(track, sector, old_data) != ERR_OK || memcmp(old_data, data + 1, 256) != 0) {
+				write_sector(track, sector, data + 1);
+			}
+			error_info[sector_offset[track] + sector] = 1;	// No error
+		}
+	}
+}
+
+
 /*
  *  Set read/write bit rate
  */
@@ -624,6 +826,20 @@ void GCRDisk::SetBitRate(uint8_t rate)
 }
 
 
+/*
+ *  Switch spindle motor on or off
+ */
+
+void GCRDisk::SetMotor(bool on)
+{
+	motor_on = on;
+
+	if (! on) {
+		flush_written_track();
+	}
+}
+
+
 /*
  *  Move R/W head out (lower track numbers)
  */
@@ -635,7 +851,10 @@ void GCRDisk::MoveHeadOut()
 	if (current_halftrack == 0)
 		return;
 
+	flush_written_track();
+
 	--current_halftrack;
+	load_current_track();
 }
 
 
@@ -650,7 +869,10 @@ void GCRDisk::MoveHeadIn()
 	if (current_halftrack >= MAX_NUM_HALFTRACKS - 1)
 		return;
 
+	flush_written_track();
+
 	++current_halftrack;
+	load_current_track();
 }
 
 
@@ -669,11 +891,13 @@ void GCRDisk::GetState(GCRDiskState * s) const
 
 	s->byte_latch = byte_latch;
 	s->disk_change_seq = disk_change_seq;
+	s->write_latch = write_latch;
 
 	s->motor_on = motor_on;
 	s->write_protected = write_protected;
 	s->on_sync = on_sync;
 	s->byte_ready = byte_ready;
+	s->write_mode = write_mode;
 }
 
 
@@ -683,8 +907,11 @@ void GCRDisk::GetState(GCRDiskState * s) const
 
 void GCRDisk::SetState(const GCRDiskState * s)
 {
+	flush_written_track();
+
 	current_halftrack = s->current_halftrack;
 	gcr_offset = s->gcr_offset;
+	load_current_track();
 
 	cycles_per_byte = s->cycles_per_byte;
 	last_byte_cycle = s->last_byte_cycle;
@@ -692,11 +919,14 @@ void GCRDisk::SetState(const GCRDiskState * s)
 
 	byte_latch = s->byte_latch;
 	disk_change_seq = s->disk_change_seq;
+	write_latch = s->write_latch;
 
 	motor_on = s->motor_on;
 	write_protected = s->write_protected;
 	on_sync = s->on_sync;
 	byte_ready = s->byte_ready;
+	write_mode = s->write_mode;
+	so_pending = byte_ready;
 }
 
 
@@ -731,7 +961,33 @@ void GCRDisk::rotate_disk(uint32_t cycle_counter)
 		uint32_t elapsed = cycle_counter - last_byte_cycle;
 		uint32_t advance = elapsed / cycles_per_byte;
 
-		if (advance > 0) {
+		if (advance > 0 && write_mode) {
+			size_t track_length = gcr_track_length[current_halftrack];
+
+			// Write latched byte to all byte positions passed by the head
+			// (the write gate is disabled on write-protected disks)
+			if (! write_protected) {
+				uint8_t * p = gcr_data[current_halftrack];
+				size_t num_bytes = std::min<size_t>(advance, track_length);
+				size_t offset = gcr_offset;
+				for (size_t i = 0; i < num_bytes; ++i) {
+					if (++offset >= track_length) {
+						offset = 0;
+					}
+					p[offset] = write_latch;
+				}
+				track_written = true;
+			}
+
+			gcr_offset = (gcr_offset + advance) % track_length;
+
+			// Ready for next byte, no sync detection while writing
+			on_sync = false;
+			so_pending = true;
+
+			last_byte_cycle += advance * cycles_per_byte;
+
+		} else if (advance > 0) {
 			size_t track_length = gcr_track_length[current_halftrack];
 
 			gcr_offset += advance;
@@ -754,6 +1010,7 @@ void GCRDisk::rotate_disk(uint32_t cycle_counter)
 					byte_latch = p[0];
 					byte_ready = true;
 				}
+				so_pending = true;
 			} else {
 				byte_ready = false;
 			}
@@ -766,6 +1023,7 @@ void GCRDisk::rotate_disk(uint32_t cycle_counter)
 		last_byte_cycle = cycle_counter;
 		on_sync = false;
 		byte_ready = false;
+		so_pending = false;
 	}
 }
 
@@ -790,7 +1048,9 @@ bool GCRDisk::ByteReady(uint32_t cycle_counter)
 {
 	rotate_disk(cycle_counter);
 
-	return byte_ready;
+	bool ready = so_pending;
+	so_pending = false;		// Signaled only once per byte
+	return ready;
 }
 
 
@@ -803,10 +1063,39 @@ uint8_t GCRDisk::ReadGCRByte(uint32_t cycle_counter)
 	rotate_disk(cycle_counter);
 
 	byte_ready = false;
+	so_pending = false;
 	return byte_latch;
 }
 
 
+/*
+ *  Switch R/W head between read and write mode
+ */
+
+void GCRDisk::SetWriteMode(uint32_t cycle_counter, bool write)
+{
+	if (write != write_mode) {
+		rotate_disk(cycle_counter);
+
+		write_mode = write;
+		byte_ready = false;
+		so_pending = false;
+	}
+}
+
+
+/*
+ *  Set GCR byte to be written to disk
+ */
+
+void GCRDisk::WriteGCRByte(uint32_t cycle_counter, uint8_t byte)
+{
+	rotate_disk(cycle_counter);
+
+	write_latch = byte;
+}
+
+
 /*
  *  Return state of write protect sensor
  */
@@ -30,6 +30,7 @@
 constexpr unsigned MAX_NUM_HALFTRACKS = 84;
 
 
+class C64;
 class MOS6502_1541;
 class Prefs;
 struct GCRDiskState;
@@ -38,7 +39,7 @@ struct GCRDiskState;
 // 1541 GCR-level disk emulation
 class GCRDisk {
 public:
-	GCRDisk(uint8_t *ram1541);
+	GCRDisk(C64 * c64, uint8_t *ram1541);
 	~GCRDisk();
 
 	void SetCPU(MOS6502_1541 * cpu) { the_cpu = cpu; }
@@ -49,7 +50,8 @@ public:
 	void SetState(const GCRDiskState * s);
 	void NewPrefs(const Prefs * prefs);
 
-	void SetMotor(bool on) { motor_on = on; }
+	void SetMotor(bool on);
+	bool MotorOn() const { return motor_on; }
 	void SetBitRate(uint8_t rate);
 	void MoveHeadOut();
 	void MoveHeadIn();
@@ -57,6 +59,8 @@ public:
 	bool SyncFound(uint32_t cycle_counter);
 	bool ByteReady(uint32_t cycle_counter);
 	uint8_t ReadGCRByte(uint32_t cycle_counter);
+	void SetWriteMode(uint32_t cycle_counter, bool write);
+	void WriteGCRByte(uint32_t cycle_counter, uint8_t byte);
 	bool WPSensorClosed(uint32_t cycle_counter);
 
 	void WriteSector();
@@ -75,11 +79,16 @@ private:
 	int offset_from_ts(unsigned track, unsigned sector);
 
 	void gcr_conv4(const uint8_t * from, uint8_t * to);
+	bool gcr_conv5(const uint8_t * from, uint8_t * to);
 	void sector2gcr(unsigned track, unsigned sector, uint8_t * gcr);
+	void load_current_track();
+	void encode_track(unsigned halftrack);
+	void flush_written_track();
 
 	void advance_disk_change_seq(uint32_t cycle_counter);
 	void rotate_disk(uint32_t cycle_counter);
 
+	C64 * the_c64;				// Pointer to C64 object
 	uint8_t * ram;				// Pointer to 1541 RAM
 	MOS6502_1541 * the_cpu;		// Pointer to 1541 CPU object
 
@@ -90,8 +99,12 @@ private:
 	uint8_t disk_id1, disk_id2;			// ID of disk
 	uint8_t error_info[NUM_SECTORS_40];	// Sector error information (1 byte/sector)
 
-	uint8_t * gcr_data[MAX_NUM_HALFTRACKS];			// GCR data for each half-track (nullptr = not present)
-	size_t gcr_track_length[MAX_NUM_HALFTRACKS];	// Number of GCR bytes for each half-track (nullptr = not present)
+	uint8_t * gcr_data[MAX_NUM_HALFTRACKS];			// GCR data for each half-track (nullptr = not present or not encoded yet)
+	size_t gcr_track_length[MAX_NUM_HALFTRACKS];	// Number of GCR bytes for each half-track (0 = not present)
+
+	bool gcr_from_sectors;		// Flag: GCR data is encoded from D64 sectors on demand
+	uint32_t gcr_track_used[MAX_NUM_HALFTRACKS];	// Time stamp of last use of each encoded half-track
+	uint32_t gcr_use_count;		// Time stamp counter for track cache
 
 	unsigned current_halftrack;		// Current halftrack number (0..MAX_NUM_HALFTRACKS-1)
 	size_t gcr_offset;				// Offset of GCR data byte under R/W head, relative to gcr_data[current_halftrack]
@@ -103,11 +116,15 @@ private:
 	unsigned cycles_per_byte;	// Clock cycles per GCR byte
 	uint32_t last_byte_cycle;	// Cycle when last byte was available
 	uint8_t byte_latch;			// Latch for read GCR byte
+	uint8_t write_latch;		// Latch for GCR byte to be written
 
 	bool motor_on;				// Flag: Spindle motor on
 	bool write_protected;		// Flag: Disk write-protected
 	bool on_sync;				// Flag: Sync detected
 	bool byte_ready;			// Flag: GCR byte ready for reading
+	bool write_mode;			// Flag: R/W head in write mode
+	bool so_pending;			// Flag: Byte ready signal to CPU SO line pending (once per byte)
+	bool track_written;			// Flag: GCR data of current half-track was written to, sectors not yet stored in image file
 };
 
 
@@ -122,11 +139,13 @@ struct GCRDiskState {
 
 	uint8_t byte_latch;
 	uint8_t disk_change_seq;
+	uint8_t write_latch;
 
 	bool motor_on;
 	bool write_protected;
 	bool on_sync;
 	bool byte_ready;
+	bool write_mode;
 };
 
 
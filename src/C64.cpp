@@ -36,10 +36,12 @@
 
 #include <SDL.h>
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <thread>
 #include <utility>
+#include <vector>
 namespace chrono = std::chrono;
 
 
@@ -58,23 +60,13 @@ bool IsFrodoSC = false;
 
 
 // Snapshot magic header
-#define SNAPSHOT_HEADER "FrodoSnapshot4\x01\0"
+#define SNAPSHOT_HEADER "FrodoSnapshot4\x02\0"
 
 // Snapshot flags
 #define SNAPSHOT_FLAG_1541_PROC 1
 
-// Snapshot data structure
-struct Snapshot {
-	uint8_t magic[16];
-	uint16_t flags;
-
-	char drive8Path[256];
-
-	uint8_t ram[C64_RAM_SIZE];
-	uint8_t color[COLOR_RAM_SIZE];
-
-	uint8_t driveRam[DRIVE_RAM_SIZE];
-
+// State of all chips (except for memory contents)
+struct ChipState {
 	uint32_t cycleCounter;
 
 	MOS6510State cpu;
@@ -87,18 +79,41 @@ struct Snapshot {
 	GCRDiskState driveGCR;
 
 	TapeSaveState tape;
+};
+
+// Snapshot data structure
+struct Snapshot {
+	uint8_t magic[16];
+	uint16_t flags;
+
+	char drive8Path[256];
+
+	uint8_t ram[C64_RAM_SIZE];
+	uint8_t color[COLOR_RAM_SIZE];
+
+	uint8_t driveRam[DRIVE_RAM_SIZE];
+
+	ChipState state;
 
 	// TODO: REU state is not saved
 };
 
 
-// Length of rewind buffer
-constexpr size_t REWIND_LENGTH = SCREEN_FREQ * 30;  // 30 seconds
+// Rewind buffer entry: Chip state of one frame, and the previous contents
+// of all memory pages which were changed during that frame
+struct RewindRecord {
+	uint16_t flags;
+	ChipState state;
+
+	std::vector<uint16_t> undo_pages;	// Page numbers
+	std::vector<uint8_t> undo_data;		// Page contents before frame
+};
 
 
 // For speed limiting to 50/60 fps
 constexpr int FRAME_TIME_us = 1000000 / SCREEN_FREQ;	// 20 ms for 50 fps (PAL)
 constexpr int FORWARD_SCALE = 4;	// Fast-forward is four times faster
+constexpr unsigned IDLE_FRAMES = 25;	// Frames waiting for keyboard input until the C64 is considered idle (0.5 s)
 
 
 // Joystick dead zone around center (+/-), and hysteresis to prevent jitter
@@ -110,7 +125,7 @@ constexpr int JOYSTICK_HYSTERESIS = 1000;
  *  Constructor: Allocate objects and memory
  */
 
-C64::C64() : quit_requested(false), prefs_editor_requested(false), load_snapshot_requested(false)
+C64::C64(const Prefs & prefs) : the_prefs(prefs), quit_requested(false), prefs_editor_requested(false), load_snapshot_requested(false)
 {
 	// Allocate RAM/ROM memory
 	RAM = new uint8_t[C64_RAM_SIZE];
@@ -128,27 +143,27 @@ C64::C64() : quit_requested(false), prefs_editor_requested(false), load_snapshot
 	init_memory();
 
 	// Load ROM files
-	load_rom_files(ThePrefs.SelectedROMPaths());
+	load_rom_files(the_prefs.SelectedROMPaths());
 
 	// Patch ROMs for IEC routines and fast reset
-	patch_roms(ThePrefs.FastReset, ThePrefs.Emul1541Proc, ThePrefs.AutoStart);
+	patch_roms(the_prefs.FastReset, the_prefs.FastTapeLoad, the_prefs.Emul1541Proc, the_prefs.AutoStart);
 
 	// Create the chips
 	TheCPU = new MOS6510(this, RAM, Basic, Kernal, Char, Color);
 
-	TheGCRDisk = new GCRDisk(RAM1541);
+	TheGCRDisk = new GCRDisk(this, RAM1541);
 	TheCPU1541 = new MOS6502_1541(this, TheGCRDisk, RAM1541, ROM1541);
 	TheGCRDisk->SetCPU(TheCPU1541);
 
 	TheVIC = new MOS6569(this, TheDisplay, TheCPU, RAM, Char, Color);
-	TheSID = new MOS6581;
-	TheCIA1 = new MOS6526_1(TheCPU, TheVIC);
-	TheCIA2 = TheCPU1541->TheCIA2 = new MOS6526_2(TheCPU, TheVIC, TheCPU1541);
+	TheSID = new MOS6581(this);
+	TheCIA1 = new MOS6526_1(this, TheCPU, TheVIC);
+	TheCIA2 = TheCPU1541->TheCIA2 = new MOS6526_2(this, TheCPU, TheVIC, TheCPU1541);
 	TheIEC = new IEC(this);
-	TheTape = new Tape(TheCIA1);
+	TheTape = new Tape(this, TheCIA1);
 
 	TheCart = new NoCartridge;
-	swap_cartridge(REU_NONE, "", ThePrefs.REUType, ThePrefs.CartridgePath);
+	swap_cartridge(REU_NONE, "", the_prefs.REUType, the_prefs.CartridgePath);
 
 	TheCPU->SetChips(TheVIC, TheSID, TheCIA1, TheCIA2, TheCart, TheIEC, TheTape);
 
@@ -164,11 +179,12 @@ C64::C64() : quit_requested(false), prefs_editor_requested(false), load_snapshot
 	joy_trigl_on[1] = joy_trigr_on[1] = false;
 
 	// Open joystick drivers if required
-	open_close_joysticks(0, 0, ThePrefs.Joystick1Port, ThePrefs.Joystick2Port);
+	open_close_joysticks(0, 0, the_prefs.Joystick1Port, the_prefs.Joystick2Port);
 	joykey = 0xff;
 
 	// Allocate buffer for rewinding
-	rewind_buffer = new Snapshot[REWIND_LENGTH];
+	rewind_buffer.resize(the_prefs.RewindLength * SCREEN_FREQ);
+	rewind_image.resize(NUM_MEM_PAGES * MEM_PAGE_SIZE);
 }
 
 
@@ -178,7 +194,7 @@ C64::C64() : quit_requested(false), prefs_editor_requested(false), load_snapshot
 
 C64::~C64()
 {
-	open_close_joysticks(ThePrefs.Joystick1Port, ThePrefs.Joystick2Port, 0, 0);
+	open_close_joysticks(the_prefs.Joystick1Port, the_prefs.Joystick2Port, 0, 0);
 
 	delete TheTape;
 	delete TheGCRDisk;
@@ -199,8 +215,6 @@ C64::~C64()
 	delete[] Color;
 	delete[] RAM1541;
 	delete[] ROM1541;
-
-	delete[] rewind_buffer;
 }
 
 
@@ -292,6 +306,23 @@ void C64::init_memory()
 
 	// Clear 1541 RAM
 	memset(RAM1541, 0, DRIVE_RAM_SIZE);
+
+	mark_all_pages_dirty();
+}
+
+
+/*
+ *  Mark all memory pages as modified (after changing memory contents
+ *  without going through the CPUs)
+ */
+
+void C64::mark_all_pages_dirty()
+{
+	memset(DirtyPages, 1, sizeof(DirtyPages));
+
+	if (TheCPU) {
+		TheCPU->InvalidateCode();
+	}
 }
 
 
@@ -302,6 +333,9 @@ void C64::init_memory()
 int C64::Run()
 {
 	cycle_counter = 0;
+#ifdef FRODO_SC
+	drive_cycle_counter = 0;
+#endif
 
 	// Reset chips
 	TheCPU->Reset();
@@ -360,6 +394,10 @@ void C64::RequestLoadSnapshot(const std::string & path)
 
 void C64::Reset(bool clear_memory)
 {
+#ifdef FRODO_SC
+	SyncDrive();
+#endif
+
 	TheCPU->AsyncReset();
 	TheCPU1541->AsyncReset();
 	TheGCRDisk->Reset();
@@ -385,7 +423,7 @@ void C64::Reset(bool clear_memory)
 
 void C64::ResetAndAutoStart()
 {
-	patch_roms(ThePrefs.FastReset, ThePrefs.Emul1541Proc, true);
+	patch_roms(the_prefs.FastReset, the_prefs.FastTapeLoad, the_prefs.Emul1541Proc, true);
 
 	Reset(true);
 }
@@ -403,12 +441,14 @@ void C64::NMI()
 
 /*
  *  The preferences have changed. prefs is a pointer to the new
- *  preferences, ThePrefs still holds the previous ones.
+ *  preferences, the_prefs still holds the previous ones (the chips
+ *  get the old values via GetPrefs()). The new preferences are
+ *  copied to the_prefs at the end.
  */
 
 void C64::NewPrefs(const Prefs *prefs)
 {
-	open_close_joysticks(ThePrefs.Joystick1Port, ThePrefs.Joystick2Port, prefs->Joystick1Port, prefs->Joystick2Port);
+	open_close_joysticks(the_prefs.Joystick1Port, the_prefs.Joystick2Port, prefs->Joystick1Port, prefs->Joystick2Port);
 
 	TheDisplay->NewPrefs(prefs);
 
@@ -418,27 +458,35 @@ void C64::NewPrefs(const Prefs *prefs)
 
 	TheSID->NewPrefs(prefs);
 
-	auto old_roms = ThePrefs.SelectedROMPaths();
+	auto old_roms = the_prefs.SelectedROMPaths();
 	auto new_roms = prefs->SelectedROMPaths();
 	if (old_roms != new_roms) {
 		load_rom_files(new_roms);
 		Reset(true);	// Reset C64 if ROMs have changed
 	}
 
-	patch_roms(prefs->FastReset, prefs->Emul1541Proc, prefs->AutoStart);
+	patch_roms(prefs->FastReset, prefs->FastTapeLoad, prefs->Emul1541Proc, prefs->AutoStart);
 
 	if (prefs->AutoStart) {
 		Reset(true);	// Reset C64 if auto-start requested
 	}
 
-	swap_cartridge(ThePrefs.REUType, ThePrefs.CartridgePath, prefs->REUType, prefs->CartridgePath);
+	swap_cartridge(the_prefs.REUType, the_prefs.CartridgePath, prefs->REUType, prefs->CartridgePath);
 	TheCPU->SetChips(TheVIC, TheSID, TheCIA1, TheCIA2, TheCart, TheIEC, TheTape);
 
 	// Reset 1541 processor if turned on or off (to bring IEC lines back to sane state)
-	if (ThePrefs.Emul1541Proc != prefs->Emul1541Proc) {
+	if (the_prefs.Emul1541Proc != prefs->Emul1541Proc) {
 		TheCPU1541->AsyncReset();
 	}
 
+	// Resize rewind buffer if length has changed
+	if (the_prefs.RewindLength != prefs->RewindLength) {
+		rewind_buffer.clear();
+		rewind_buffer.resize(prefs->RewindLength * SCREEN_FREQ);
+	}
+
+	the_prefs = *prefs;
+
 	reset_play_mode();
 }
 
@@ -449,11 +497,10 @@ void C64::NewPrefs(const Prefs *prefs)
 
 void C64::MountDrive8(bool emul_1541_proc, const char * path)
 {
-	auto prefs = std::make_unique<Prefs>(ThePrefs);
+	auto prefs = std::make_unique<Prefs>(the_prefs);
 	prefs->DrivePath[0] = path;
 	prefs->Emul1541Proc = emul_1541_proc;
 	NewPrefs(prefs.get());
-	ThePrefs = *prefs;
 }
 
 
@@ -463,10 +510,9 @@ void C64::MountDrive8(bool emul_1541_proc, const char * path)
 
 void C64::MountDrive1(const char * path)
 {
-	auto prefs = std::make_unique<Prefs>(ThePrefs);
+	auto prefs = std::make_unique<Prefs>(the_prefs);
 	prefs->TapePath = path;
 	NewPrefs(prefs.get());
-	ThePrefs = *prefs;
 }
 
 
@@ -476,18 +522,17 @@ void C64::MountDrive1(const char * path)
 
 void C64::InsertCartridge(const std::string & path)
 {
-	auto prefs = std::make_unique<Prefs>(ThePrefs);
+	auto prefs = std::make_unique<Prefs>(the_prefs);
 	prefs->CartridgePath = path;
 	if (! path.empty()) {
 		prefs->REUType = REU_NONE;	// Cartridge overrides REU
 	}
 	NewPrefs(prefs.get());
-	ThePrefs = *prefs;
 }
 
 
 /*
- *  Patch kernal ROM reset and IEC routines
+ *  Patch kernal ROM reset, IEC, and tape routines
  */
 
 static void apply_patch(bool apply, uint8_t * rom, const uint8_t * builtin, uint16_t offset, unsigned size, const uint8_t * patch)
@@ -508,7 +553,7 @@ static void apply_patch(bool apply, uint8_t * rom, const uint8_t * builtin, uint
 	}
 }
 
-void C64::patch_roms(bool fast_reset, bool emul_1541_proc, bool auto_start)
+void C64::patch_roms(bool fast_reset, bool fast_tape_load, bool emul_1541_proc, bool auto_start)
 {
 	// Fast reset
 	static const uint8_t fast_reset_patch[] = { 0xa0, 0x00 };
@@ -542,6 +587,11 @@ void C64::patch_roms(bool fast_reset, bool emul_1541_proc, bool auto_start)
 	apply_patch(!emul_1541_proc, Kernal, BuiltinKernalROM, 0x0dcc, sizeof(iec_patch_7), iec_patch_7);
 	apply_patch(!emul_1541_proc, Kernal, BuiltinKernalROM, 0x0e03, sizeof(iec_patch_8), iec_patch_8);
 
+	// Tape
+	static const uint8_t tape_patch[] = { 0xf2, 0x11 };	// Read block, replaces JSR $FCBD
+
+	apply_patch(fast_tape_load, Kernal, BuiltinKernalROM, 0x18a1, sizeof(tape_patch), tape_patch);
+
 	// Auto start after reset
 	static const uint8_t auto_start_patch[] = { 0xf2, 0x10 };	// BASIC interactive input loop
 
@@ -558,6 +608,11 @@ void C64::patch_roms(bool fast_reset, bool emul_1541_proc, bool auto_start)
 	apply_patch(true, ROM1541, BuiltinDriveROM, 0x2c9b, sizeof(drive_patch_2), drive_patch_2);
 	apply_patch(true, ROM1541, BuiltinDriveROM, 0x3594, sizeof(drive_patch_3), drive_patch_3);
 	apply_patch(true, ROM1541, BuiltinDriveROM, 0x3b0c, sizeof(drive_patch_4), drive_patch_4);
+
+	// Patched ROM code may be cached by the CPU
+	if (TheCPU) {
+		TheCPU->InvalidateCode();
+	}
 }
 
 
@@ -617,15 +672,24 @@ void C64::swap_cartridge(int oldreu, const std::string & oldpath, int newreu, co
 
 bool C64::emulate_c64_cycle()
 {
-	// The order of calls is important here
+	// The order of calls is important here. The CIAs and the tape are
+	// skipped while they are asleep in the scheduler.
 	unsigned flags = TheVIC->EmulateCycle();
 	if (flags & VIC_HBLANK) {
 		TheSID->EmulateLine();
 	}
-	TheCIA1->EmulateCycle();
-	TheCIA2->EmulateCycle();
+	if (! TheScheduler.AllAsleep(cycle_counter)) {
+		if (TheScheduler.IsActive(EVENT_CIA1, cycle_counter)) {
+			TheCIA1->EmulateCycle();
+		}
+		if (TheScheduler.IsActive(EVENT_CIA2, cycle_counter)) {
+			TheCIA2->EmulateCycle();
+		}
+	}
 	TheCPU->EmulateCycle();
-	TheTape->EmulateCycle();
+	if (TheScheduler.IsActive(EVENT_TAPE, cycle_counter)) {
+		TheTape->EmulateCycle();
+	}
 
 	++cycle_counter;
 
@@ -645,6 +709,29 @@ void C64::emulate_1541_cycle()
 	}
 }
 
+
+/*
+ *  Let the 1541 catch up with the C64.
+ *
+ *  The 1541 runs behind the C64 and is only brought up to the current
+ *  cycle when the C64 accesses the IEC lines (the only connection between
+ *  the two) and at the end of each frame. The 1541 sees the same IEC line
+ *  states in every cycle as when running both in lockstep, so the result
+ *  is identical.
+ */
+
+void C64::SyncDrive()
+{
+	uint32_t cycles = cycle_counter - drive_cycle_counter;
+	drive_cycle_counter = cycle_counter;
+
+	if (the_prefs.Emul1541Proc) {
+		while (cycles-- > 0) {
+			emulate_1541_cycle();
+		}
+	}
+}
+
 #endif // def FRODO_SC
 
 
@@ -666,7 +753,9 @@ void C64::pause()
 void C64::resume()
 {
 	TheDisplay->Resume();
-	TheSID->ResumeSound();
+	if (! auto_warp) {
+		TheSID->ResumeSound();
+	}
 
 	// Flush event queue
 	SDL_PumpEvents();
@@ -690,6 +779,9 @@ void C64::vblank()
 		play_mode = PlayMode::Pause;
 	}
 
+	// Render sound of last frame if sound output is driven by emulation
+	TheSID->EmulateFrame();
+
 	// Poll keyboard and joysticks
 	poll_input();
 
@@ -707,7 +799,7 @@ void C64::vblank()
 	// Handle request for snapshot loading
 	if (load_snapshot_requested) {
 		std::string error;
-		if (LoadSnapshot(requested_snapshot, &ThePrefs, error)) {
+		if (LoadSnapshot(requested_snapshot, &the_prefs, error)) {
 			ShowNotification("Snapshot loaded");
 		} else {
 			ShowNotification(error);
@@ -733,6 +825,12 @@ void C64::vblank()
 	// Handle rewind feature
 	handle_rewind();
 
+	// Go to full speed while loading
+	update_auto_warp();
+
+	// Slow down to 100% while waiting for keyboard input
+	update_idle();
+
 	// Calculate time between frames, display speedometer
 	chrono::time_point<chrono::steady_clock> now = chrono::steady_clock::now();
 
@@ -740,7 +838,7 @@ void C64::vblank()
 	int speed_index = FRAME_TIME_us / double(elapsed_us + 1) * 100;
 
 	// Limit speed to 100% (and FPS to 50 Hz) if desired
-	if ((elapsed_us < FRAME_TIME_us) && ThePrefs.LimitSpeed) {
+	if ((elapsed_us < FRAME_TIME_us) && speed_limited()) {
 		std::this_thread::sleep_until(frame_start);
 		if (play_mode == PlayMode::Forward) {
 			frame_start += chrono::microseconds(FRAME_TIME_us / FORWARD_SCALE);
@@ -760,6 +858,91 @@ void C64::vblank()
 	}
 
 	TheDisplay->SetSpeedometer(speed_index);
+
+	// Tell the VIC whether the next frame will be displayed, so it can
+	// skip drawing it otherwise (headless mode only needs the final frame
+	// for the regression test screenshot)
+	unsigned next_skip_counter = frame_skip_counter == 1 ? frame_skip_factor : frame_skip_counter - 1;
+	bool visible = !the_prefs.Headless && next_skip_counter == 1;
+	if (! the_prefs.TestScreenshotPath.empty()) {
+		visible = true;
+	}
+	TheVIC->SetFrameVisible(visible);
+}
+
+
+/*
+ *  Switch automatic warp mode on or off, depending on whether the disk
+ *  drive or tape drive is active. In warp mode, the speed limit is lifted
+ *  and sound output is muted. Frames are skipped according to the speed
+ *  by vblank().
+ */
+
+void C64::update_auto_warp()
+{
+	bool busy = false;
+	if (the_prefs.AutoWarp && the_prefs.LimitSpeed && play_mode == PlayMode::Play) {
+		busy = drive_led_on
+		    || (the_prefs.Emul1541Proc && TheGCRDisk->MotorOn())
+		    || TheTape->DriveState() != TapeState::Stop;
+	}
+
+	if (busy != auto_warp) {
+		auto_warp = busy;
+		if (auto_warp) {
+			TheSID->PauseSound();
+		} else {
+			TheSID->ResumeSound();
+		}
+	}
+}
+
+
+/*
+ *  Detect the C64 sitting in the Kernal loop that waits for keyboard input
+ *  (BASIC direct mode and INPUT). The speed is then limited to 100% even if
+ *  the "LimitSpeed" setting is off, which saves host CPU time without
+ *  changing the results of the emulation. The PC is only sampled once per
+ *  frame, and may occasionally be caught in the interrupt handler, so a
+ *  single miss doesn't end the idle state.
+ */
+
+void C64::update_idle()
+{
+	static const uint8_t wait_loop[] = {
+		0xa5, 0xc6,			// $e5cd  LDA $c6
+		0x85, 0xcc,			//        STA $cc
+		0x8d, 0x92, 0x02,	//        STA $0292
+		0xf0, 0xf7			//        BEQ $e5cd
+	};
+	const uint16_t wait_loop_adr = 0xe5cd;
+
+	uint16_t pc = TheCPU->GetPC();
+	bool waiting = play_mode == PlayMode::Play
+	            && TheCPU->KernalIn()
+	            && pc >= wait_loop_adr && pc <= wait_loop_adr + sizeof(wait_loop)	// Frodo SC may be in the middle of the BEQ
+	            && memcmp(Kernal + (wait_loop_adr & 0x1fff), wait_loop, sizeof(wait_loop)) == 0;
+
+	if (! waiting) {
+		idle_frames -= std::min(idle_frames, IDLE_FRAMES / 5);
+	} else if (idle_frames < IDLE_FRAMES * 2) {
+		++idle_frames;
+	}
+}
+
+
+/*
+ *  Check whether the emulation speed is limited to 100%: if desired, while
+ *  the C64 is idle, and in pause mode (headless mode and automatic warp
+ *  mode always run as fast as possible)
+ */
+
+bool C64::speed_limited() const
+{
+	if (the_prefs.Headless || auto_warp)
+		return false;
+
+	return the_prefs.LimitSpeed || idle_frames >= IDLE_FRAMES || play_mode == PlayMode::Pause;
 }
 
 
@@ -786,9 +969,10 @@ int C64::main_loop()
 
 #ifdef FRODO_SC
 
+		// The 1541 is emulated in batches by SyncDrive()
 		new_frame = emulate_c64_cycle();
-		if (ThePrefs.Emul1541Proc) {
-			emulate_1541_cycle();
+		if (new_frame) {
+			SyncDrive();
 		}
 
 #else
@@ -800,12 +984,12 @@ int C64::main_loop()
 
 		TheSID->EmulateLine();
 #if !PRECISE_CIA_CYCLES
-		TheCIA1->EmulateLine(ThePrefs.CIACycles);
-		TheCIA2->EmulateLine(ThePrefs.CIACycles);
+		TheCIA1->EmulateLine(the_prefs.CIACycles);
+		TheCIA2->EmulateLine(the_prefs.CIACycles);
 #endif
 
-		if (ThePrefs.Emul1541Proc) {
-			int cycles_1541 = ThePrefs.FloppyCycles;
+		if (the_prefs.Emul1541Proc) {
+			int cycles_1541 = the_prefs.FloppyCycles;
 			TheCPU1541->CountVIATimers(cycles_1541);
 
 			if (!TheCPU1541->Idle) {
@@ -836,7 +1020,7 @@ int C64::main_loop()
 		// Poll keyboard and mouse, and delay execution at three points
 		// within the frame to reduce input lag. This also helps with the
 		// asynchronously running SID emulation.
-		if (ThePrefs.LimitSpeed && play_mode == PlayMode::Play) {
+		if (play_mode == PlayMode::Play && speed_limited()) {
 			unsigned raster_y = TheVIC->RasterY();
 			if (raster_y != prev_raster_y) {
 				if (raster_y == TOTAL_RASTERS * 1 / 4) {
@@ -864,9 +1048,9 @@ int C64::main_loop()
 			}
 
 			// Exit with code 1 if automated test time has elapsed
-			if (ThePrefs.TestMaxFrames > 0) {
-				--ThePrefs.TestMaxFrames;
-				if (ThePrefs.TestMaxFrames == 0) {
+			if (the_prefs.TestMaxFrames > 0) {
+				--the_prefs.TestMaxFrames;
+				if (the_prefs.TestMaxFrames == 0) {
 					main_loop_exit_code = 1;
 					quit_requested = true;
 				}
@@ -888,7 +1072,7 @@ void C64::poll_input()
 	TheCIA1->Joystick1 = poll_joystick(0);
 	TheCIA1->Joystick2 = poll_joystick(1);
 
-	if (ThePrefs.JoystickSwap) {
+	if (the_prefs.JoystickSwap) {
 		std::swap(TheCIA1->Joystick1, TheCIA1->Joystick2);
 	}
 
@@ -935,6 +1119,9 @@ void C64::open_close_joystick(int port, int oldjoy, int newjoy)
 
 void C64::open_close_joysticks(int oldjoy1, int oldjoy2, int newjoy1, int newjoy2)
 {
+	if (the_prefs.Headless)
+		return;	// Game controller subsystem not initialized
+
 	open_close_joystick(0, oldjoy1, newjoy1);
 	open_close_joystick(1, oldjoy2, newjoy2);
 }
@@ -947,16 +1134,16 @@ void C64::open_close_joysticks(int oldjoy1, int oldjoy2, int newjoy1, int newjoy
 void C64::JoystickAdded(int32_t index)
 {
 	// Assign to port 2 first, then to port 1
-	if (joy[1] == nullptr && ThePrefs.Joystick1Port != index + 1) {
+	if (joy[1] == nullptr && the_prefs.Joystick1Port != index + 1) {
 
-		ThePrefs.Joystick2Port = index + 1;
-		open_close_joystick(1, 0, ThePrefs.Joystick2Port);
+		the_prefs.Joystick2Port = index + 1;
+		open_close_joystick(1, 0, the_prefs.Joystick2Port);
 		ShowNotification("Controller assigned to port 2");
 
-	} else if (joy[0] == nullptr && ThePrefs.Joystick2Port != index + 1) {
+	} else if (joy[0] == nullptr && the_prefs.Joystick2Port != index + 1) {
 
-		ThePrefs.Joystick1Port = index + 1;
-		open_close_joystick(0, 0, ThePrefs.Joystick1Port);
+		the_prefs.Joystick1Port = index + 1;
+		open_close_joystick(0, 0, the_prefs.Joystick1Port);
 		ShowNotification("Controller assigned to port 1");
 	}
 }
@@ -971,15 +1158,15 @@ void C64::JoystickRemoved(int32_t instance_id)
 	if (joy[0] && SDL_JoystickInstanceID(joy[0]) == instance_id) {
 
 		// Unassign joystick port 1
-		open_close_joystick(0, ThePrefs.Joystick1Port, 0);
-		ThePrefs.Joystick1Port = 0;
+		open_close_joystick(0, the_prefs.Joystick1Port, 0);
+		the_prefs.Joystick1Port = 0;
 		ShowNotification("Controller on port 1 removed");
 
 	} else if (joy[1] && SDL_JoystickInstanceID(joy[1]) == instance_id) {
 
 		// Unassign joystick port 2
-		open_close_joystick(1, ThePrefs.Joystick2Port, 0);
-		ThePrefs.Joystick2Port = 0;
+		open_close_joystick(1, the_prefs.Joystick2Port, 0);
+		the_prefs.Joystick2Port = 0;
 		ShowNotification("Controller on port 2 removed");
 	}
 }
@@ -1060,7 +1247,7 @@ uint8_t C64::poll_joystick(int port)
 		y = SDL_GameControllerGetAxis(controller[port], SDL_CONTROLLER_AXIS_LEFTY);
 
 		// Control rumble effects
-		if (ThePrefs.TapeRumble) {
+		if (the_prefs.TapeRumble) {
 			if (TheTape->MotorOn()) {
 				SDL_GameControllerRumble(controller[port], 0, 0x8000, 1000 / SCREEN_FREQ);
 			} else {
@@ -1080,7 +1267,7 @@ uint8_t C64::poll_joystick(int port)
 	}
 
 	// In twin-stick mode, axes are controlled by right stick on opposite port
-	if (ThePrefs.TwinStick) {
+	if (the_prefs.TwinStick) {
 		if (controller[port ^ 1]) {
 			x = SDL_GameControllerGetAxis(controller[port ^ 1], SDL_CONTROLLER_AXIS_RIGHTX);
 			y = SDL_GameControllerGetAxis(controller[port ^ 1], SDL_CONTROLLER_AXIS_RIGHTY);
@@ -1193,18 +1380,12 @@ int C64::TapePosition() const
 
 
 /*
- *  Save state to snapshot (emulation must be in VBlank)
+ *  Save chip state (emulation must be in VBlank), returns snapshot flags
  */
 
-void C64::MakeSnapshot(Snapshot * s, bool instruction_boundary)
+uint16_t C64::save_chip_state(ChipState * s, bool instruction_boundary)
 {
-	memset(s, 0, sizeof(*s));
-
-	memcpy(s->magic, SNAPSHOT_HEADER, sizeof(s->magic));
-
-	if (ThePrefs.DrivePath[0].length() < sizeof(s->drive8Path)) {
-		strcpy(s->drive8Path, ThePrefs.DrivePath[0].c_str());
-	}
+	uint16_t flags = 0;
 
 #ifdef FRODO_SC
 	while (true) {
@@ -1215,10 +1396,8 @@ void C64::MakeSnapshot(Snapshot * s, bool instruction_boundary)
 
 		// Advance C64 state by one cycle
 		emulate_c64_cycle();
-		if (ThePrefs.Emul1541Proc) {
-			emulate_1541_cycle();
-		}
 	}
+	SyncDrive();
 #else
 	TheCPU->GetState(&(s->cpu));
 #endif
@@ -1229,11 +1408,8 @@ void C64::MakeSnapshot(Snapshot * s, bool instruction_boundary)
 	TheCIA1->GetState(&(s->cia1));
 	TheCIA2->GetState(&(s->cia2));
 
-	memcpy(s->ram, RAM, C64_RAM_SIZE);
-	memcpy(s->color, Color, COLOR_RAM_SIZE);
-
-	if (ThePrefs.Emul1541Proc) {
-		s->flags |= SNAPSHOT_FLAG_1541_PROC;
+	if (the_prefs.Emul1541Proc) {
+		flags |= SNAPSHOT_FLAG_1541_PROC;
 
 #ifdef FRODO_SC
 		while (true) {
@@ -1254,24 +1430,22 @@ void C64::MakeSnapshot(Snapshot * s, bool instruction_boundary)
 
 	TheTape->GetState(&(s->tape));
 
-	memcpy(s->driveRam, RAM1541, DRIVE_RAM_SIZE);
+	return flags;
 }
 
 
 /*
- *  Restore state from snapshot (emulation must be paused and in VBlank)
+ *  Restore chip state (emulation must be paused and in VBlank)
  *
- *  Note: The magic header is not checked by this function.
+ *  Note: Memory contents must be restored before calling this function.
  */
 
-void C64::RestoreSnapshot(const Snapshot * s)
+void C64::restore_chip_state(const ChipState * s, uint16_t flags)
 {
-	// SL CPU64::SetState() overwrites ram[0/1], so we need to restore that
-	// first in case we're loading an SC snapshot
-	memcpy(RAM, s->ram, C64_RAM_SIZE);
-	memcpy(Color, s->color, COLOR_RAM_SIZE);
-
 	cycle_counter = s->cycleCounter;
+#ifdef FRODO_SC
+	drive_cycle_counter = cycle_counter;
+#endif
 
 	TheCPU->SetState(&(s->cpu));
 	TheVIC->SetState(&(s->vic));
@@ -1279,10 +1453,7 @@ void C64::RestoreSnapshot(const Snapshot * s)
 	TheCIA1->SetState(&(s->cia1));
 	TheCIA2->SetState(&(s->cia2));
 
-	if (s->flags & SNAPSHOT_FLAG_1541_PROC) {
-
-		memcpy(RAM1541, s->driveRam, DRIVE_RAM_SIZE);
-
+	if (flags & SNAPSHOT_FLAG_1541_PROC) {
 		TheCPU1541->SetState(&(s->driveCPU));
 		TheGCRDisk->SetState(&(s->driveGCR));
 	}
@@ -1291,6 +1462,51 @@ void C64::RestoreSnapshot(const Snapshot * s)
 }
 
 
+/*
+ *  Save state to snapshot (emulation must be in VBlank)
+ */
+
+void C64::MakeSnapshot(Snapshot * s, bool instruction_boundary)
+{
+	memset(s, 0, sizeof(*s));
+
+	memcpy(s->magic, SNAPSHOT_HEADER, sizeof(s->magic));
+
+	if (the_prefs.DrivePath[0].length() < sizeof(s->drive8Path)) {
+		strcpy(s->drive8Path, the_prefs.DrivePath[0].c_str());
+	}
+
+	s->flags = save_chip_state(&(s->state), instruction_boundary);
+
+	memcpy(s->ram, RAM, C64_RAM_SIZE);
+	memcpy(s->color, Color, COLOR_RAM_SIZE);
+	memcpy(s->driveRam, RAM1541, DRIVE_RAM_SIZE);
+}
+
+
+/*
+ *  Restore state from snapshot (emulation must be paused and in VBlank)
+ *
+ *  Note: The magic header is not checked by this function.
+ */
+
+void C64::RestoreSnapshot(const Snapshot * s)
+{
+	// SL CPU64::SetState() overwrites ram[0/1], so we need to restore that
+	// first in case we're loading an SC snapshot
+	memcpy(RAM, s->ram, C64_RAM_SIZE);
+	memcpy(Color, s->color, COLOR_RAM_SIZE);
+
+	if (s->flags & SNAPSHOT_FLAG_1541_PROC) {
+		memcpy(RAM1541, s->driveRam, DRIVE_RAM_SIZE);
+	}
+
+	mark_all_pages_dirty();
+
+	restore_chip_state(&(s->state), s->flags);
+}
+
+
 /*
  *  Save snapshot file (emulation must be paused and in VBlank)
  */
@@ -1356,8 +1572,7 @@ bool C64::LoadSnapshot(const std::string & filename, Prefs * prefs, std::string
 	new_prefs->Emul1541Proc = s->flags & SNAPSHOT_FLAG_1541_PROC;
 	new_prefs->DrivePath[0] = s->drive8Path;
 	NewPrefs(new_prefs.get());
-	ThePrefs = *new_prefs;
-	if (prefs != &ThePrefs) {
+	if (prefs != &the_prefs) {
 		prefs->Emul1541Proc = new_prefs->Emul1541Proc;
 		prefs->DrivePath[0] = new_prefs->DrivePath[0];
 	}
@@ -1412,6 +1627,7 @@ bool C64::DMALoad(const std::string & filename, std::string & ret_error_msg)
 		RAM[0x42] = RAM[0x7b];
 	}
 
+	mark_all_pages_dirty();
 	return true;
 }
 
@@ -1424,13 +1640,13 @@ bool C64::DMALoad(const std::string & filename, std::string & ret_error_msg)
 void C64::AutoStartOp()
 {
 	// Remove ROM patch to avoid recursion
-	patch_roms(ThePrefs.FastReset, ThePrefs.Emul1541Proc, ThePrefs.AutoStart = false);
+	patch_roms(the_prefs.FastReset, the_prefs.FastTapeLoad, the_prefs.Emul1541Proc, the_prefs.AutoStart = false);
 
-	if (! ThePrefs.LoadProgram.empty() ) {
+	if (! the_prefs.LoadProgram.empty() ) {
 
 		// Load specified program
 		std::string error_msg;
-		if (! DMALoad(ThePrefs.LoadProgram, error_msg)) {
+		if (! DMALoad(the_prefs.LoadProgram, error_msg)) {
 			fprintf(stderr, "Unable to auto-start: %s\n", error_msg.c_str());
 			return;
 		}
@@ -1438,7 +1654,7 @@ void C64::AutoStartOp()
 		// Put RUN <RETURN> into keyboard buffer
 		set_keyboard_buffer("RUN\x0d");
 
-	} else if (! ThePrefs.DrivePath[0].empty()) {
+	} else if (! the_prefs.DrivePath[0].empty()) {
 
 		// Starting from drive 8, write LOAD command to screen
 		write_to_screen("load\"*\",8,1");
@@ -1446,7 +1662,7 @@ void C64::AutoStartOp()
 		// Put <RETURN> RUN <RETURN> into keyboard buffer
 		set_keyboard_buffer("\x0dRUN\x0d");
 
-	} else if (! ThePrefs.TapePath.empty()) {
+	} else if (! the_prefs.TapePath.empty()) {
 
 		// Starting from drive 1, write LOAD command to screen
 		//
@@ -1464,6 +1680,51 @@ void C64::AutoStartOp()
 }
 
 
+/*
+ *  Read tape block directly into memory (called from Kernal tape read
+ *  routine before the tape interrupt is set up), returns false if no
+ *  standard Kernal block was found
+ */
+
+bool C64::TapeReadBlockOp()
+{
+	std::vector<uint8_t> block;
+	if (! TheTape->ReadKernalBlock(block))
+		return false;
+
+	// The skipped Kernal code sets CAS1 to keep the Kernal interrupt from
+	// switching the tape motor on again while the button is still pressed
+	RAM[0xc0] = 1;					// CAS1, tape motor interlock
+
+	uint16_t start_addr = RAM[0xc1] | (RAM[0xc2] << 8);	// STAL, start address
+	uint16_t end_addr = RAM[0xae] | (RAM[0xaf] << 8);	// EAL, end address
+	unsigned len = end_addr > start_addr ? end_addr - start_addr : 0;
+
+	// Store or verify data
+	unsigned num_bytes = std::min<unsigned>(block.size(), len);
+	if (RAM[0x93]) {	// VERCK, verify flag
+		if (memcmp(RAM + start_addr, block.data(), num_bytes) != 0) {
+			RAM[0x90] |= 0x10;			// STATUS = verify error
+		}
+	} else {
+		memcpy(RAM + start_addr, block.data(), num_bytes);
+	}
+
+	if (block.size() < len) {
+		RAM[0x90] |= 0x04;				// STATUS = short block
+	} else if (block.size() > len) {
+		RAM[0x90] |= 0x08;				// STATUS = long block
+	}
+
+	uint16_t sal = start_addr + num_bytes;
+	RAM[0xac] = sal & 0xff;				// SAL, current address
+	RAM[0xad] = sal >> 8;
+
+	mark_all_pages_dirty();
+	return true;
+}
+
+
 /*
  *  Write string to C64 screen memory
  */
@@ -1486,6 +1747,8 @@ void C64::write_to_screen(const char * str)
 
 		RAM[pnt++] = c;
 	}
+
+	mark_all_pages_dirty();
 }
 
 
@@ -1508,6 +1771,8 @@ void C64::set_keyboard_buffer(const char * str)
 	}
 
 	RAM[0xc6] = i;	// Number of characters
+
+	mark_all_pages_dirty();
 }
 
 
@@ -1533,37 +1798,139 @@ void C64::SetPlayMode(PlayMode mode)
 }
 
 
+/*
+ *  Get pointer to memory page covered by rewind buffer
+ */
+
+uint8_t * C64::rewind_page(unsigned page) const
+{
+	if (page < FIRST_COLOR_PAGE) {
+		return RAM + page * MEM_PAGE_SIZE;
+	} else if (page < FIRST_DRIVE_PAGE) {
+		return Color + (page - FIRST_COLOR_PAGE) * MEM_PAGE_SIZE;
+	} else {
+		return RAM1541 + (page - FIRST_DRIVE_PAGE) * MEM_PAGE_SIZE;
+	}
+}
+
+
+/*
+ *  Record current frame to rewind buffer entry
+ *
+ *  Only the newest frame's memory contents are kept in full (in
+ *  rewind_image), each entry stores the pages its frame has changed,
+ *  with the contents they had in the previous entry.
+ *
+ *  Memory pages which may differ from rewind_image are marked in
+ *  DirtyPages, so only those have to be compared.
+ */
+
+void C64::record_rewind_frame(RewindRecord & r, bool first)
+{
+	r.flags = save_chip_state(&r.state);
+
+	uint16_t changed[NUM_MEM_PAGES];
+	unsigned num_changed = 0;
+
+	if (first) {
+
+		// No previous frame, take complete image
+		for (unsigned page = 0; page < NUM_MEM_PAGES; ++page) {
+			memcpy(rewind_image.data() + page * MEM_PAGE_SIZE, rewind_page(page), MEM_PAGE_SIZE);
+		}
+
+	} else {
+
+		// Find pages changed since previous frame
+		for (unsigned page = 0; page < NUM_MEM_PAGES; ++page) {
+			if (DirtyPages[page] && memcmp(rewind_image.data() + page * MEM_PAGE_SIZE, rewind_page(page), MEM_PAGE_SIZE) != 0) {
+				changed[num_changed++] = page;
+			}
+		}
+	}
+
+	memset(DirtyPages, 0, sizeof(DirtyPages));
+
+	// Save previous contents of changed pages and update image
+	r.undo_pages = std::vector<uint16_t>(changed, changed + num_changed);
+	r.undo_data = std::vector<uint8_t>(num_changed * MEM_PAGE_SIZE);
+
+	for (unsigned i = 0; i < num_changed; ++i) {
+		uint8_t * p = rewind_image.data() + changed[i] * MEM_PAGE_SIZE;
+		memcpy(r.undo_data.data() + i * MEM_PAGE_SIZE, p, MEM_PAGE_SIZE);
+		memcpy(p, rewind_page(changed[i]), MEM_PAGE_SIZE);
+	}
+}
+
+
+/*
+ *  Restore frame from newest rewind buffer entry, and optionally
+ *  step rewind_image back to the previous entry
+ */
+
+void C64::replay_rewind_frame(RewindRecord & r, bool step_back)
+{
+	// Memory must be restored first (see RestoreSnapshot()),
+	// 1541 RAM only if it was saved with 1541 processor emulation
+	unsigned num_pages = (r.flags & SNAPSHOT_FLAG_1541_PROC) ? NUM_MEM_PAGES : FIRST_DRIVE_PAGE;
+	for (unsigned page = 0; page < num_pages; ++page) {
+		if (DirtyPages[page]) {
+			memcpy(rewind_page(page), rewind_image.data() + page * MEM_PAGE_SIZE, MEM_PAGE_SIZE);
+			DirtyPages[page] = 0;
+		}
+	}
+
+	restore_chip_state(&r.state, r.flags);
+
+	if (step_back) {
+		for (unsigned i = 0; i < r.undo_pages.size(); ++i) {
+			unsigned page = r.undo_pages[i];
+			memcpy(rewind_image.data() + page * MEM_PAGE_SIZE, r.undo_data.data() + i * MEM_PAGE_SIZE, MEM_PAGE_SIZE);
+			DirtyPages[page] = 1;	// Now differs from memory
+		}
+
+		r.undo_pages.clear();
+		r.undo_pages.shrink_to_fit();
+		r.undo_data.clear();
+		r.undo_data.shrink_to_fit();
+	}
+}
+
+
 /*
  *  Handle rewind recording and replay (to be called in VBlank)
  */
 
 void C64::handle_rewind()
 {
-	if (rewind_buffer != nullptr) {
+	size_t length = rewind_buffer.size();
+	if (length > 0) {
 		if (play_mode == PlayMode::Rewind || play_mode == PlayMode::RewindFrame) {
 
-			// Pop snapshot from ring buffer
+			// Pop frame from ring buffer
 			if (rewind_fill > 0) {
-				size_t read_index = (rewind_start + rewind_fill - 1) % REWIND_LENGTH;
-				RestoreSnapshot(rewind_buffer + read_index);
+				size_t read_index = (rewind_start + rewind_fill - 1) % length;
 
-				// Keep first snapshot in buffer so we can repeat it when
+				// Keep first frame in buffer so we can repeat it when
 				// reaching the end of the buffer
-				if (rewind_fill > 1) {
+				bool step_back = rewind_fill > 1;
+				replay_rewind_frame(rewind_buffer[read_index], step_back);
+				if (step_back) {
 					--rewind_fill;
 				}
 			}
 
 		} else if (play_mode == PlayMode::Play || play_mode == PlayMode::Forward || play_mode == PlayMode::ForwardFrame) {
 
-			// Add snapshot to ring buffer
-			size_t write_index = (rewind_start + rewind_fill) % REWIND_LENGTH;
-			MakeSnapshot(rewind_buffer + write_index);
+			// Add frame to ring buffer (when overwriting the oldest entry
+			// its undo data is no longer needed)
+			size_t write_index = (rewind_start + rewind_fill) % length;
+			record_rewind_frame(rewind_buffer[write_index], rewind_fill == 0);
 
-			if (rewind_fill < REWIND_LENGTH) {
+			if (rewind_fill < length) {
 				++rewind_fill;
 			} else {
-				rewind_start = (rewind_start + 1) % REWIND_LENGTH;
+				rewind_start = (rewind_start + 1) % length;
 			}
 		}
 	}
@@ -1596,12 +1963,23 @@ bool IsSnapshotFile(const char * filename)
 }
 
 
+/*
+ *  Display type changed by user (remembered in prefs)
+ */
+
+void C64::SetDisplayType(int type)
+{
+	the_prefs.DisplayType = type;
+}
+
+
 /*
  *  Set drive LEDs (forward to display)
  */
 
 void C64::SetDriveLEDs(int l0, int l1, int l2, int l3)
 {
+	drive_led_on = l0 == DRVLED_ON || l1 == DRVLED_ON || l2 == DRVLED_ON || l3 == DRVLED_ON;
 	TheDisplay->SetLEDs(l0, l1, l2, l3);
 }
 
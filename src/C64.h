@@ -26,9 +26,15 @@
 
 #include <chrono>
 #include <string>
+#include <vector>
 
+#include "Prefs.h"
 #include "Tape.h"
 
+#ifdef FRODO_SC
+#include "Scheduler.h"
+#endif
+
 
 // Sizes of memory areas
 constexpr unsigned C64_RAM_SIZE = 0x10000;
@@ -39,6 +45,12 @@ constexpr unsigned CHAR_ROM_SIZE = 0x1000;
 constexpr unsigned DRIVE_RAM_SIZE = 0x800;
 constexpr unsigned DRIVE_ROM_SIZE = 0x4000;
 
+// Memory pages tracked for modifications (C64 RAM, color RAM, 1541 RAM)
+constexpr unsigned MEM_PAGE_SIZE = 0x100;
+constexpr unsigned FIRST_COLOR_PAGE = C64_RAM_SIZE / MEM_PAGE_SIZE;
+constexpr unsigned FIRST_DRIVE_PAGE = FIRST_COLOR_PAGE + COLOR_RAM_SIZE / MEM_PAGE_SIZE;
+constexpr unsigned NUM_MEM_PAGES = FIRST_DRIVE_PAGE + DRIVE_RAM_SIZE / MEM_PAGE_SIZE;
+
 #ifdef NTSC
 // Screen refresh frequency (NTSC)
 constexpr unsigned SCREEN_FREQ = 60;
@@ -69,8 +81,6 @@ enum class PlayMode {
 };
 
 
-class Prefs;
-class ROMPaths;
 class Display;
 class MOS6510;
 class MOS6569;
@@ -83,12 +93,14 @@ class MOS6502_1541;
 class GCRDisk;
 class Tape;
 struct Snapshot;
+struct ChipState;
+struct RewindRecord;
 
 
 // Main C64 emulator object
 class C64 {
 public:
-	C64();
+	C64(const Prefs & prefs);
 	~C64();
 
 	int Run();
@@ -102,7 +114,11 @@ public:
 	void NMI();
 
 	uint32_t CycleCounter() const { return cycle_counter; }
+#ifdef FRODO_SC
+	void SyncDrive();
+#endif
 
+	const Prefs & GetPrefs() const { return the_prefs; }
 	void NewPrefs(const Prefs *prefs);
 	void MountDrive8(bool emul_1541_proc, const char * path);
 	void MountDrive1(const char * path = nullptr);
@@ -115,6 +131,7 @@ public:
 
 	bool DMALoad(const std::string & filename, std::string & ret_error_msg);
 	void AutoStartOp();
+	bool TapeReadBlockOp();
 
 	void SetPlayMode(PlayMode mode);
 	PlayMode GetPlayMode() const { return play_mode; }
@@ -130,6 +147,8 @@ public:
 	TapeState TapeDriveState() const;
 	int TapePosition() const;
 
+	void SetDisplayType(int type);
+
 	void SetDriveLEDs(int l0, int l1, int l2, int l3);
 	void ShowNotification(std::string s);
 
@@ -142,9 +161,11 @@ public:
 	uint8_t * RAM1541;			// 1541 memories
 	uint8_t * ROM1541;
 
+	uint8_t DirtyPages[NUM_MEM_PAGES];	// Memory pages written to since last rewind frame (non-zero = dirty)
+
 	Display * TheDisplay;		// Display object
 
-	MOS6510 * TheCPU;			// C64 chip objects
+	MOS6510 * TheCPU = nullptr;	// C64 chip objects
 	MOS6569 * TheVIC;
 	MOS6581 * TheSID;
 	MOS6526_1 * TheCIA1;
@@ -157,6 +178,10 @@ public:
 
 	Tape * TheTape;				// Datasette object
 
+#ifdef FRODO_SC
+	Scheduler TheScheduler;		// Cycle scheduler for idle chips
+#endif
+
 	// Builtin ROM data
 	static const uint8_t BuiltinBasicROM[BASIC_ROM_SIZE];
 	static const uint8_t BuiltinKernalROM[KERNAL_ROM_SIZE];
@@ -167,11 +192,12 @@ private:
 	void load_rom(const std::string & which, const std::string & path, uint8_t * where, size_t size, const uint8_t * builtin);
 	void load_rom_files(const ROMPaths & p);
 	void init_memory();
+	void mark_all_pages_dirty();
 
 	void pause();
 	void resume();
 
-	void patch_roms(bool fast_reset, bool emul_1541_proc, bool auto_start);
+	void patch_roms(bool fast_reset, bool fast_tape_load, bool emul_1541_proc, bool auto_start);
 
 	void write_to_screen(const char * str);
 	void set_keyboard_buffer(const char * str);
@@ -190,8 +216,19 @@ private:
 	int main_loop();
 	void poll_input();
 	void vblank();
+	uint16_t save_chip_state(ChipState * s, bool instruction_boundary = false);
+	void restore_chip_state(const ChipState * s, uint16_t flags);
+
+	uint8_t * rewind_page(unsigned page) const;
+	void record_rewind_frame(RewindRecord & r, bool first);
+	void replay_rewind_frame(RewindRecord & r, bool step_back);
 	void handle_rewind();
 	void reset_play_mode();
+	void update_auto_warp();
+	void update_idle();
+	bool speed_limited() const;
+
+	Prefs the_prefs;				// Preferences of this C64 instance
 
 	bool quit_requested;			// Emulator shall quit
 	int main_loop_exit_code = 0;	// Exit code to return from main loop
@@ -201,6 +238,9 @@ private:
 	std::string requested_snapshot;
 
 	uint32_t cycle_counter;			// Cycle counter
+#ifdef FRODO_SC
+	uint32_t drive_cycle_counter = 0;	// C64 cycle up to which the 1541 has been emulated
+#endif
 
 	SDL_Joystick * joy[2] = { nullptr, nullptr };				// SDL joystick devices
 	SDL_GameController * controller[2] = { nullptr, nullptr };	// SDL game controller devices
@@ -215,9 +255,13 @@ private:
 	unsigned frame_skip_counter;			// For display update limiting
 
 	PlayMode play_mode = PlayMode::Play;	// Current play mode
-	Snapshot * rewind_buffer = nullptr;		// Snapshot buffer for rewinding
-	size_t rewind_start = 0;				// Index of first recorded snapshot
-	size_t rewind_fill = 0;					// Number of recorded snapshots
+	bool auto_warp = false;					// Flag: Running at full speed because of disk or tape activity
+	bool drive_led_on = false;				// Flag: One of the drive LEDs is on
+	unsigned idle_frames = 0;				// Number of consecutive frames the C64 was waiting for keyboard input
+	std::vector<RewindRecord> rewind_buffer;	// Ring buffer of recorded frames for rewinding
+	std::vector<uint8_t> rewind_image;		// Memory contents of newest recorded frame
+	size_t rewind_start = 0;				// Index of first recorded frame
+	size_t rewind_fill = 0;					// Number of recorded frames
 };
 
 
@@ -99,7 +99,7 @@ void MOS6526_2::Reset()
  *  Get CIA state
  */
 
-void MOS6526::GetState(MOS6526State * s) const
+void MOS6526::GetState(MOS6526State * s)
 {
 	s->pra = pra;
 	s->prb = prb;
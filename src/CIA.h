@@ -21,6 +21,7 @@
 #ifndef CIA_H
 #define CIA_H
 
+#include "C64.h"
 #include "Prefs.h"
 
 
@@ -33,12 +34,12 @@ struct MOS6526State;
 // 6526 emulation (CIA) base class
 class MOS6526 {
 public:
-	MOS6526(MOS6510 * cpu) : the_cpu(cpu) { }
+	MOS6526(C64 * c64, MOS6510 * cpu) : the_c64(c64), the_cpu(cpu) { }
 	virtual ~MOS6526() { }
 
 	void Reset();
 
-	void GetState(MOS6526State * s) const;
+	void GetState(MOS6526State * s);
 	virtual void SetState(const MOS6526State * s);
 
 #ifdef FRODO_SC
@@ -65,6 +66,7 @@ protected:
 
 	void check_tod_alarm();
 
+	C64 * the_c64;		// Pointer to C64 object
 	MOS6510 * the_cpu;	// Pointer to CPU object
 
 	// Registers
@@ -97,6 +99,9 @@ protected:
 
 #ifdef FRODO_SC
 	void emulate_timer(Timer & t, uint8_t & cr, bool input);
+	void check_sleep();
+	void sync(uint32_t end);
+	void wake();
 #endif
 	uint8_t timer_on_pb(uint8_t prb) const;
 
@@ -117,6 +122,10 @@ protected:
 	uint8_t clear_ir_delay;	// Delay line for clearing IR bit in ICR
 	uint8_t irq_delay;		// Delay line for asserting IRQ
 	bool trigger_tb_bug;	// Flag: Timer B bug triggered
+
+	SchedulerEvent sched_event;	// Scheduler event for this CIA
+	bool sleeping = false;		// Flag: Emulation suspended, state lags behind
+	uint32_t sleep_start = 0;	// First cycle not emulated while sleeping
 #endif
 };
 
@@ -124,7 +133,12 @@ protected:
 // First CIA of C64 ($dcxx)
 class MOS6526_1 : public MOS6526 {
 public:
-	MOS6526_1(MOS6510 * cpu, MOS6569 * vic) : MOS6526(cpu), the_vic(vic) { }
+	MOS6526_1(C64 * c64, MOS6510 * cpu, MOS6569 * vic) : MOS6526(c64, cpu), the_vic(vic)
+	{
+#ifdef FRODO_SC
+		sched_event = EVENT_CIA1;
+#endif
+	}
 
 	void Reset();
 
@@ -152,7 +166,12 @@ private:
 // Second CIA of C64 ($ddxx)
 class MOS6526_2 : public MOS6526{
 public:
-	MOS6526_2(MOS6510 * cpu, MOS6569 * vic, MOS6502_1541 * cpu_1541) : MOS6526(cpu), the_vic(vic), the_cpu_1541(cpu_1541) { }
+	MOS6526_2(C64 * c64, MOS6510 * cpu, MOS6569 * vic, MOS6502_1541 * cpu_1541) : MOS6526(c64, cpu), the_vic(vic), the_cpu_1541(cpu_1541)
+	{
+#ifdef FRODO_SC
+		sched_event = EVENT_CIA2;
+#endif
+	}
 
 	void Reset();
 
@@ -233,6 +252,18 @@ struct MOS6526State {
 };
 
 
+#ifdef FRODO_SC
+/*
+ *  Resume emulation of sleeping CIA in the next cycle
+ */
+
+inline void MOS6526::wake()
+{
+	the_c64->TheScheduler.Activate(sched_event);
+}
+#endif
+
+
 /*
  *  Set interrupt flag
  */
@@ -240,7 +271,11 @@ struct MOS6526State {
 inline void MOS6526::set_int_flag(uint8_t flag)
 {
 	icr |= flag;
-#ifndef FRODO_SC
+#ifdef FRODO_SC
+	if (int_mask & flag) {
+		wake();		// Interrupt has to be processed in the next cycle
+	}
+#else
 	if (int_mask & flag) {
 		icr |= 0x80;
 		trigger_irq();
@@ -501,7 +536,7 @@ inline void MOS6526::write_register(uint8_t reg, uint8_t byte)
 				}
 			}
 #else
-			if (ThePrefs.CIAIRQHack) {	// Hack for addressing modes that read from the address
+			if (the_c64->GetPrefs().CIAIRQHack) {	// Hack for addressing modes that read from the address
 				icr = 0;
 			}
 			if (byte & 0x80) {
@@ -24,6 +24,12 @@
  *
  *  - The EmulateCycle() function is called for every emulated Phi2 clock
  *    cycle. It counts down the timers and triggers interrupts if necessary.
+ *  - When both timers are stopped or counting Phi2 steadily, and no
+ *    interrupt is pending, nothing happens until the next timer underflow.
+ *    The CIA then goes to sleep in the cycle scheduler until shortly before
+ *    that underflow. The skipped cycles are caught up in a single step by
+ *    sync() when the CIA wakes up, or when registers are accessed or the
+ *    state is read.
  *  - The TOD clocks are counted by CountTOD() during the VBlank, so the
  *    input frequency is 50Hz.
  *  - The fields KeyMatrix and RevMatrix contain one bit for each key on the
@@ -74,6 +80,9 @@ void MOS6526::Reset()
 	clear_ir_delay = 0;
 	irq_delay = 0;
 	trigger_tb_bug = false;
+
+	sleeping = false;
+	wake();
 }
 
 void MOS6526_1::Reset()
@@ -105,8 +114,10 @@ void MOS6526_2::Reset()
  *  Get CIA state
  */
 
-void MOS6526::GetState(MOS6526State * s) const
+void MOS6526::GetState(MOS6526State * s)
 {
+	sync(the_c64->CycleCounter());
+
 	s->pra = pra;
 	s->prb = prb;
 	s->ddra = ddra;
@@ -224,6 +235,9 @@ void MOS6526::SetState(const MOS6526State * s)
 	clear_ir_delay = s->clear_ir_delay;
 	irq_delay = s->irq_delay;
 	trigger_tb_bug = s->trigger_tb_bug;
+
+	sleeping = false;
+	wake();
 }
 
 void MOS6526_2::SetState(const MOS6526State * s)
@@ -271,6 +285,8 @@ uint8_t MOS6526::timer_on_pb(uint8_t byte) const
 
 uint8_t MOS6526_1::ReadRegister(uint8_t reg)
 {
+	sync(the_c64->CycleCounter() + 1);
+
 	switch (reg) {
 		case 0: {	// Port A: Handle keyboard and joysticks
 			uint8_t ret = PAOut(), tst = PBOut() & Joystick1;
@@ -302,6 +318,11 @@ uint8_t MOS6526_1::ReadRegister(uint8_t reg)
 
 			return ret;
 		}
+		case 13: {	// ICR: Clearing the interrupt flags needs cycle emulation
+			uint8_t ret = read_register(reg);
+			wake();
+			return ret;
+		}
 		default:
 			return read_register(reg);
 	}
@@ -314,8 +335,11 @@ uint8_t MOS6526_1::ReadRegister(uint8_t reg)
 
 uint8_t MOS6526_2::ReadRegister(uint8_t reg)
 {
+	sync(the_c64->CycleCounter() + 1);
+
 	switch (reg) {
 		case 0: {	// Port A: IEC
+			the_c64->SyncDrive();
 			uint8_t in = ((the_cpu_1541->CalcIECLines() & 0x30) << 2)	// DATA and CLK from bus
 			           | 0x3f;											// Other lines high
 			SetPAIn(in);
@@ -325,6 +349,11 @@ uint8_t MOS6526_2::ReadRegister(uint8_t reg)
 			SetPBIn(0xff);
 			break;
 		}
+		case 13: {	// ICR: Clearing the interrupt flags needs cycle emulation
+			uint8_t ret = read_register(reg);
+			wake();
+			return ret;
+		}
 	}
 
 	return read_register(reg);
@@ -347,7 +376,11 @@ inline void MOS6526_1::check_lp()
 
 void MOS6526_1::WriteRegister(uint8_t reg, uint8_t byte)
 {
+	sync(the_c64->CycleCounter() + 1);
 	write_register(reg, byte);
+	if ((reg >= 4 && reg <= 7) || reg >= 13) {	// Timer or interrupt control register changed
+		wake();
+	}
 
 	switch (reg) {
 		case 1:	// Port B: Handle VIC lightpen input
@@ -379,7 +412,14 @@ inline void MOS6526_2::write_pa(uint8_t inv_out)
 
 void MOS6526_2::WriteRegister(uint8_t reg, uint8_t byte)
 {
+	sync(the_c64->CycleCounter() + 1);
+	if (reg == 0 || reg == 2) {	// 1541 must see the IEC lines change at the right time
+		the_c64->SyncDrive();
+	}
 	write_register(reg, byte);
+	if ((reg >= 4 && reg <= 7) || reg >= 13) {	// Timer or interrupt control register changed
+		wake();
+	}
 
 	switch (reg) {
 		case 0:	// Port A: Handle VIC bank and IEC port
@@ -433,6 +473,12 @@ void MOS6526::emulate_timer(Timer & t, uint8_t & cr, bool input)
 
 void MOS6526::EmulateCycle()
 {
+	// Catch up with cycles skipped while sleeping
+	if (sleeping) {
+		sync(the_c64->CycleCounter());
+		sleeping = false;
+	}
+
 	if (! ta.idle) {
 
 		// Shift timer A delay lines
@@ -530,6 +576,109 @@ void MOS6526::EmulateCycle()
 	set_ir_delay <<= 1;
 	clear_ir_delay <<= 1;
 	irq_delay <<= 1;
+
+	check_sleep();
+}
+
+
+/*
+ *  Go to sleep if nothing is going to happen in the next cycles
+ */
+
+// Check whether running timer counts Phi2 with no load pending, returns
+// the number of cycles until the underflow
+static inline unsigned steady_timer_cycles(uint16_t counter, uint8_t count_delay, uint8_t load_delay)
+{
+	if ((count_delay & 3) != 3 || (load_delay & 3) != 0)
+		return 0;
+
+	return counter ? counter : 0x10000;
+}
+
+void MOS6526::check_sleep()
+{
+	// Interrupt in progress?
+	if ((icr & int_mask) || ((set_ir_delay | clear_ir_delay | irq_delay) & 2) || trigger_tb_bug)
+		return;
+
+	// Emulate cycles up to the next timer underflow
+	uint32_t cycles = SLEEP_FOREVER;
+
+	if (! ta.idle) {
+		if ((cra & 0x21) != 0x01)	// Started, counting Phi2?
+			return;
+		unsigned underflow = steady_timer_cycles(ta.counter, ta.count_delay, ta.load_delay);
+		if (underflow < cycles) {
+			cycles = underflow;
+		}
+	}
+
+	if (! tb.idle) {
+		if ((crb & 0x61) != 0x01)	// Started, counting Phi2?
+			return;
+		unsigned underflow = steady_timer_cycles(tb.counter, tb.count_delay, tb.load_delay);
+		if (underflow < cycles) {
+			cycles = underflow;
+		}
+	}
+
+	// Not worth it for just a few cycles
+	if (cycles < 4)
+		return;
+
+	uint32_t now = the_c64->CycleCounter();
+
+	sleeping = true;
+	sleep_start = now + 1;
+	the_c64->TheScheduler.Sleep(sched_event, sleep_start, now + cycles);
+}
+
+
+/*
+ *  Catch up with cycles skipped while sleeping, up to (but not including)
+ *  the given cycle
+ */
+
+// Shift delay line by given number of cycles
+static inline uint8_t shift_delay(uint8_t delay, uint32_t cycles)
+{
+	return cycles < 8 ? delay << cycles : 0;
+}
+
+// Shift delay line by given number of cycles, with input active
+static inline uint8_t fill_delay(uint8_t delay, uint32_t cycles)
+{
+	return cycles < 8 ? (delay << cycles) | ((1 << cycles) - 1) : 0xff;
+}
+
+void MOS6526::sync(uint32_t end)
+{
+	if (! sleeping)
+		return;
+
+	int32_t cycles = end - sleep_start;
+	if (cycles <= 0)
+		return;
+
+	sleep_start = end;
+
+	// Timers are either idle or counting without underflow
+	if (! ta.idle) {
+		ta.counter -= cycles;
+		ta.count_delay = fill_delay(ta.count_delay, cycles);
+		ta.load_delay = shift_delay(ta.load_delay, cycles);
+		ta.oneshot_delay = (cra & 8) ? fill_delay(ta.oneshot_delay, cycles) : shift_delay(ta.oneshot_delay, cycles);
+	}
+	if (! tb.idle) {
+		tb.counter -= cycles;
+		tb.count_delay = fill_delay(tb.count_delay, cycles);
+		tb.load_delay = shift_delay(tb.load_delay, cycles);
+		tb.oneshot_delay = (crb & 8) ? fill_delay(tb.oneshot_delay, cycles) : shift_delay(tb.oneshot_delay, cycles);
+	}
+
+	set_ir_delay = shift_delay(set_ir_delay, cycles);
+	clear_ir_delay = shift_delay(clear_ir_delay, cycles);
+	irq_delay = shift_delay(irq_delay, cycles);
 }
 
 
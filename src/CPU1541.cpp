@@ -69,7 +69,7 @@
  */
 
 MOS6502_1541::MOS6502_1541(C64 * c64, GCRDisk * gcr, uint8_t * Ram, uint8_t * Rom)
- : ram(Ram), rom(Rom), the_c64(c64), the_gcr_disk(gcr)
+ : ram(Ram), rom(Rom), dirty_pages(c64->DirtyPages + FIRST_DRIVE_PAGE), the_c64(c64), the_gcr_disk(gcr)
 {
 	a = x = y = 0;
 	sp = 0xff;
@@ -362,6 +362,7 @@ inline void MOS6502_1541::write_byte(uint16_t adr, uint8_t byte)
 
 		// RAM
 		ram[adr & 0x07ff] = byte;
+		dirty_pages[(adr >> 8) & 0x07] = 1;
 
 	} else if ((adr & 0x1c00) == 0x1800) {
 
@@ -419,6 +420,17 @@ inline void MOS6502_1541::write_byte(uint16_t adr, uint8_t byte)
 				}
 				break;
 			}
+
+			case 1:		// Port A
+			case 3:		// DDR A
+			case 15:	// Port A (no handshake)
+				the_gcr_disk->WriteGCRByte(cycle_counter, via2->PAOut());
+				break;
+
+			case 12:	// PCR
+				// CB2: R/W head mode (low = write)
+				the_gcr_disk->SetWriteMode(cycle_counter, (via2->PCR() & 0xe0) == 0xc0);
+				break;
 		}
 	}
 }
@@ -451,6 +463,7 @@ inline uint16_t MOS6502_1541::read_zp_word(uint16_t adr)
 inline void MOS6502_1541::write_zp(uint16_t adr, uint8_t byte)
 {
 	ram[adr & 0xff] = byte;
+	dirty_pages[0] = 1;
 }
 
 
@@ -106,6 +106,7 @@ private:
 
 	uint8_t * ram;			// Pointer to main RAM
 	uint8_t * rom;			// Pointer to ROM
+	uint8_t * dirty_pages;	// Pointer to dirty page map of RAM (see C64::DirtyPages)
 	C64 * the_c64;			// Pointer to C64 object
 	GCRDisk * the_gcr_disk;	// Pointer to GCR disk object
 
@@ -73,7 +73,7 @@
  */
 
 MOS6502_1541::MOS6502_1541(C64 * c64, GCRDisk * gcr, uint8_t * Ram, uint8_t * Rom)
- : ram(Ram), rom(Rom), the_c64(c64), the_gcr_disk(gcr)
+ : ram(Ram), rom(Rom), dirty_pages(c64->DirtyPages + FIRST_DRIVE_PAGE), the_c64(c64), the_gcr_disk(gcr)
 {
 	a = x = y = 0;
 	sp = 0xff;
@@ -385,6 +385,7 @@ inline void MOS6502_1541::write_byte(uint16_t adr, uint8_t byte)
 
 		// RAM
 		ram[adr & 0x07ff] = byte;
+		dirty_pages[(adr >> 8) & 0x07] = 1;
 
 	} else if ((adr & 0x1c00) == 0x1800) {
 
@@ -442,6 +443,17 @@ inline void MOS6502_1541::write_byte(uint16_t adr, uint8_t byte)
 				}
 				break;
 			}
+
+			case 1:		// Port A
+			case 3:		// DDR A
+			case 15:	// Port A (no handshake)
+				the_gcr_disk->WriteGCRByte(cycle_counter, via2->PAOut());
+				break;
+
+			case 12:	// PCR
+				// CB2: R/W head mode (low = write)
+				the_gcr_disk->SetWriteMode(cycle_counter, (via2->PCR() & 0xe0) == 0xc0);
+				break;
 		}
 	}
 }
@@ -595,7 +607,7 @@ void MOS6502_1541::EmulateCPUCycle()
 #include "CPU_emulcycle.h"
 
 		// Extension opcode
-		case O_EXT:
+		STATE(O_EXT):
 			if (pc < 0xc000) {
 				illegal_op(pc - 1);
 				break;
@@ -619,7 +631,7 @@ void MOS6502_1541::EmulateCPUCycle()
 			}
 			break;
 
-		default:
+		STATE_ILLEGAL:
 			illegal_op(pc - 1);
 			break;
 	}
@@ -27,11 +27,16 @@
  *    executed opcode and if the counter goes below zero, the function
  *    returns.
  *  - All memory accesses are done with the read_byte() and
- *    write_byte() functions which also do the memory address decoding. The
- *    read_zp() and write_zp() functions allow faster access to the zero
- *    page, the pop_byte() and push_byte() macros for the stack.
+ *    write_byte() functions. They look up the page in read_table[] or
+ *    write_table[] and access RAM or ROM directly, only I/O space and
+ *    cartridge banks with side effects are decoded by read_byte_io() and
+ *    write_byte_io(). The read_zp() and write_zp() functions allow faster
+ *    access to the zero page, the pop_byte() and push_byte() macros for the
+ *    stack.
  *  - If a write occurs to addresses 0 or 1, new_config() is called to check
- *    whether the memory configuration has changed
+ *    whether the memory configuration has changed. The page tables are
+ *    rebuilt by update_page_tables() when it has, or when the cartridge
+ *    switches banks or its EXROM/GAME lines.
  *  - The possible interrupt sources are:
  *      INT_VICIRQ: I flag is checked, jump to ($fffe)
  *      INT_CIAIRQ: I flag is checked, jump to ($fffe)
@@ -47,6 +52,8 @@
  *  - Only the highest bit of the n_flag variable is used.
  *  - The $f2 opcode that would normally crash the 6510 is used to implement
  *    emulator-specific functions, mainly those for the IEC routines.
+ *  - If CPU_BLOCK_CACHE is set, opcodes and operands are not fetched with
+ *    read_byte() but taken from pre-decoded basic blocks (see fetch_block()).
  */
 
 #include "sysdeps.h"
@@ -69,7 +76,7 @@
  */
 
 MOS6510::MOS6510(C64 *c64, uint8_t *Ram, uint8_t *Basic, uint8_t *Kernal, uint8_t *Char, uint8_t *Color)
- : the_c64(c64), ram(Ram), basic_rom(Basic), kernal_rom(Kernal), char_rom(Char), color_ram(Color)
+ : the_c64(c64), ram(Ram), basic_rom(Basic), kernal_rom(Kernal), char_rom(Char), color_ram(Color), dirty_pages(c64->DirtyPages)
 {
 	a = x = y = 0;
 	sp = 0xff;
@@ -88,6 +95,22 @@ MOS6510::MOS6510(C64 *c64, uint8_t *Ram, uint8_t *Basic, uint8_t *Kernal, uint8_
 
 	borrowed_cycles = 0;
 	dfff_byte = 0x55;
+
+	basic_in = kernal_in = char_in = io_in = false;
+
+	// $0000..$7fff and $c000..$cfff are always RAM, the rest of the
+	// tables is set up by update_page_tables()
+	for (unsigned page = 0; page < 0x100; ++page) {
+		read_table[page] = ram + (page << 8);
+		write_table[page] = ram + (page << 8);
+	}
+	write_table[0xff] = nullptr;	// For FF00Trigger()
+	cart_map_gen = 0;
+
+#if CPU_BLOCK_CACHE
+	code_blocks.resize(NUM_CODE_BLOCKS);
+	memset(page_gen, 0, sizeof(page_gen));
+#endif
 }
 
 
@@ -119,8 +142,10 @@ void MOS6510::Reset()
 {
 	// Initialize extra 6510 registers and memory configuration
 	ram[0] = ram[1] = 0;
+	dirty_pages[0] = 1;
 	tape_sense = false;
 	new_config();
+	InvalidateCode();
 
 	// Clear all interrupt lines
 	int_line[INT_VICIRQ] = false;
@@ -204,7 +229,9 @@ void MOS6510::SetState(const MOS6510State *s)
 
 	ram[0] = s->ddr;
 	ram[1] = s->pr;
+	dirty_pages[0] = 1;
 	new_config();
+	InvalidateCode();
 
 	pc = s->pc;
 	sp = s->sp & 0xff;
@@ -253,6 +280,9 @@ void MOS6510::new_config()
 
 	uint8_t port = ~ram[0] | ram[1];
 
+	bool old_basic_in = basic_in, old_kernal_in = kernal_in;
+	bool old_char_in = char_in, old_io_in = io_in;
+
 	basic_in = (port & 3) == 3;
 	kernal_in = port & 2;
 	if (the_cart->notGAME) {
@@ -262,11 +292,114 @@ void MOS6510::new_config()
 	}
 	io_in = (port & 3) && (port & 4);
 
+	if (basic_in != old_basic_in || kernal_in != old_kernal_in || char_in != old_char_in || io_in != old_io_in) {
+		update_page_tables();
+	} else {
+		check_cart_mapping();
+	}
+
 	bool tape_motor = (port & 0x20) == 0;
 	the_tape->SetMotor(tape_motor);
 }
 
 
+/*
+ *  Discard all pre-decoded code (after changing memory contents
+ *  or cartridge without going through the CPU)
+ */
+
+void MOS6510::InvalidateCode()
+{
+#if CPU_BLOCK_CACHE
+	for (auto & gen : page_gen) {
+		++gen;
+	}
+#endif
+}
+
+
+/*
+ *  Page was written to or mapped differently, discard pre-decoded code from it
+ */
+
+inline void MOS6510::code_changed([[maybe_unused]] unsigned page)
+{
+#if CPU_BLOCK_CACHE
+	++page_gen[page];
+#endif
+}
+
+
+/*
+ *  Set memory for direct reads from page
+ */
+
+inline void MOS6510::map_read_page(unsigned page, const uint8_t * p)
+{
+	if (read_table[page] != p) {
+		read_table[page] = p;
+		code_changed(page);
+	}
+}
+
+
+/*
+ *  Rebuild page tables for $8000..$ffff from the memory configuration
+ *  and the cartridge state
+ */
+
+void MOS6510::update_page_tables()
+{
+	cart_map_gen = the_cart->mapGeneration;
+
+	// Cartridge ROML or RAM
+	const uint8_t * roml = ram + 0x8000;
+	if (! the_cart->notEXROM) {
+		roml = the_cart->MapROML(ram + 0x8000, basic_in);
+	}
+
+	// Cartridge ROMH or RAM or BASIC ROM
+	const uint8_t * romh;
+	if (the_cart->notEXROM || the_cart->notGAME) {
+		romh = basic_in ? basic_rom : ram + 0xa000;
+	} else {
+		romh = the_cart->MapROMH(ram + 0xa000, basic_rom, basic_in, kernal_in);
+	}
+
+	// I/O or char ROM or RAM
+	const uint8_t * io = nullptr;
+	if (! io_in) {
+		io = char_in ? char_rom : ram + 0xd000;
+	}
+
+	// Kernal ROM or RAM
+	const uint8_t * kernal = kernal_in ? kernal_rom : ram + 0xe000;
+
+	for (unsigned i = 0; i < 0x20; ++i) {
+		map_read_page(0x80 + i, roml ? roml + (i << 8) : nullptr);
+		map_read_page(0xa0 + i, romh ? romh + (i << 8) : nullptr);
+		map_read_page(0xe0 + i, kernal + (i << 8));
+	}
+	for (unsigned i = 0; i < 0x10; ++i) {
+		map_read_page(0xd0 + i, io ? io + (i << 8) : nullptr);
+		write_table[0xd0 + i] = io_in ? nullptr : ram + 0xd000 + (i << 8);
+	}
+}
+
+
+/*
+ *  Cartridge may have switched banks or changed its EXROM/GAME lines,
+ *  rebuild page tables if it did
+ */
+
+inline void MOS6510::check_cart_mapping()
+{
+	if (the_cart->mapGeneration != cart_map_gen) {
+		update_page_tables();
+	}
+}
+
+
 /*
  *  Read a byte from I/O / ROM space
  */
@@ -312,14 +445,21 @@ inline uint8_t MOS6510::read_byte_io(uint16_t adr)
 						return the_cia1->ReadRegister(adr & 0x0f);
 					case 0xd:	// CIA 2
 						return the_cia2->ReadRegister(adr & 0x0f);
-					case 0xe:	// Cartridge I/O 1 (or open)
-						return the_cart->ReadIO1(adr & 0xff, rand());
+					case 0xe: {	// Cartridge I/O 1 (or open)
+						uint8_t byte = the_cart->ReadIO1(adr & 0xff, rand());
+						check_cart_mapping();
+						return byte;
+					}
 					case 0xf:	// Cartridge I/O 2 (or open)
 						if (adr < 0xdfa0) {
-							return the_cart->ReadIO2(adr & 0xff, rand());
+							uint8_t byte = the_cart->ReadIO2(adr & 0xff, rand());
+							check_cart_mapping();
+							return byte;
 						} else {
 							return read_emulator_id(adr & 0x7f);
 						}
+					default:	// Can't happen
+						return 0;
 				}
 			} else if (char_in) {
 				return char_rom[adr & 0x0fff];
@@ -345,8 +485,9 @@ inline uint8_t MOS6510::read_byte_io(uint16_t adr)
 
 uint8_t MOS6510::read_byte(uint16_t adr)
 {
-	if (adr < 0x8000) {
-		return ram[adr];
+	const uint8_t * p = read_table[adr >> 8];
+	if (p) {
+		return p[adr & 0xff];
 	} else {
 		return read_byte_io(adr);
 	}
@@ -385,40 +526,11 @@ uint8_t MOS6510::read_emulator_id(uint16_t adr)
 
 inline uint16_t MOS6510::read_word(uint16_t adr)
 {
-	switch (adr >> 12) {
-		case 0x0:
-		case 0x1:
-		case 0x2:
-		case 0x3:
-		case 0x4:
-		case 0x5:
-		case 0x6:
-		case 0x7:
-			return *(uint16_t *)&ram[adr];
-		case 0x8:
-		case 0x9:
-		case 0xa:
-		case 0xb:
-			return read_byte_io(adr) | (read_byte_io(adr + 1) << 8);
-		case 0xc:
-			return *(uint16_t *)&ram[adr];
-		case 0xd:
-			if (io_in) {
-				return read_byte_io(adr) | (read_byte_io(adr + 1) << 8);
-			} else if (char_in) {
-				return *(uint16_t *)&char_rom[adr & 0x0fff];
-			} else {
-				return *(uint16_t *)&ram[adr];
-			}
-		case 0xe:
-		case 0xf:
-			if (kernal_in) {
-				return *(uint16_t *)&kernal_rom[adr & 0x1fff];
-			} else {
-				return *(uint16_t *)&ram[adr];
-			}
-		default:	// Can't happen
-			return 0;
+	const uint8_t * p = read_table[adr >> 8];
+	if (p && (adr & 0xff) != 0xff) {
+		return *(uint16_t *)&p[adr & 0xff];
+	} else {
+		return read_byte(adr) | (read_byte(adr + 1) << 8);
 	}
 }
 
@@ -440,6 +552,8 @@ void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 {
 	if (adr >= 0xe000) {
 		ram[adr] = byte;
+		dirty_pages[adr >> 8] = 1;
+		code_changed(adr >> 8);
 		if (adr == 0xff00) {
 			the_cart->FF00Trigger();
 		}
@@ -457,7 +571,7 @@ void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 				the_sid->WriteRegister(adr & 0x1f, byte);
 				return;
 			case 0x7:
-				if (ThePrefs.TestBench && adr == 0xd7ff) {
+				if (the_c64->GetPrefs().TestBench && adr == 0xd7ff) {
 					the_c64->RequestQuit(byte);
 				} else {
 					the_sid->WriteRegister(adr & 0x1f, byte);
@@ -468,6 +582,7 @@ void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 			case 0xa:
 			case 0xb:
 				color_ram[adr & 0x03ff] = byte & 0x0f;
+				dirty_pages[FIRST_COLOR_PAGE + ((adr >> 8) & 0x03)] = 1;
 				return;
 			case 0xc:	// CIA 1
 				the_cia1->WriteRegister(adr & 0x0f, byte);
@@ -477,13 +592,17 @@ void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 				return;
 			case 0xe:	// Cartridge I/O 1 (or open)
 				the_cart->WriteIO1(adr & 0xff, byte);
+				check_cart_mapping();
 				return;
 			case 0xf:	// Cartridge I/O 2 (or open)
 				the_cart->WriteIO2(adr & 0xff, byte);
+				check_cart_mapping();
 				return;
 		}
 	} else {
 		ram[adr] = byte;
+		dirty_pages[adr >> 8] = 1;
+		code_changed(adr >> 8);
 	}
 }
 
@@ -494,8 +613,11 @@ void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 
 inline void MOS6510::write_byte(uint16_t adr, uint8_t byte)
 {
-	if (adr < 0xd000) {
-		ram[adr] = byte;
+	uint8_t * p = write_table[adr >> 8];
+	if (p) {
+		p[adr & 0xff] = byte;
+		dirty_pages[adr >> 8] = 1;
+		code_changed(adr >> 8);
 		if (adr < 2) {
 			new_config();
 		}
@@ -533,6 +655,7 @@ inline uint16_t MOS6510::read_zp_word(uint16_t adr)
 inline void MOS6510::write_zp(uint16_t adr, uint8_t byte)
 {
 	ram[adr & 0xff] = byte;
+	dirty_pages[0] = 1;
 
 	// Check if memory configuration may have changed.
 	if (adr < 2) {
@@ -555,12 +678,14 @@ uint8_t MOS6510::ExtReadByte(uint16_t adr)
 	kernal_in = ExtConfig & 2;
 	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	update_page_tables();
 
 	// Read byte
 	uint8_t byte = read_byte(adr);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	update_page_tables();
 
 	return byte;
 }
@@ -580,12 +705,14 @@ void MOS6510::ExtWriteByte(uint16_t adr, uint8_t byte)
 	kernal_in = ExtConfig & 2;
 	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	update_page_tables();
 
 	// Write byte
 	write_byte(adr, byte);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	update_page_tables();
 }
 
 
@@ -682,6 +809,162 @@ void MOS6510::illegal_op(uint16_t adr)
 }
 
 
+#if CPU_BLOCK_CACHE
+
+/*
+ *  Basic block translation cache
+ *
+ *  Instead of fetching opcodes and operands from memory, EmulateLine()
+ *  executes runs of pre-decoded instructions. A block ends after a jump,
+ *  branch, or other control transfer, after MAX_BLOCK_OPS instructions,
+ *  or at the end of the page. Every page has a generation counter which is
+ *  incremented on writes to the page and on changes of its memory mapping.
+ *  A block is only valid as long as the counter of its page still has the
+ *  value it had at decoding time; this is checked before every instruction
+ *  so self-modifying code works.
+ *
+ *  The zero page and stack, I/O space, and cartridge ROM which can't be
+ *  read directly (see update_page_tables()) are not cached.
+ *  Instructions from there are decoded one at a time.
+ */
+
+// Instruction lengths (must match the operand fetches in CPU_emulline.h)
+static const uint8_t op_length[256] = {
+	1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $00
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $10
+	3, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $20
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $30
+	1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $40
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $50
+	1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $60
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $70
+	2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $80
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $90
+	2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $a0
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $b0
+	2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $c0
+	2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $d0
+	2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,	// $e0
+	2, 2, 2, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,	// $f0
+};
+
+// Check whether instruction ends a basic block
+static bool ends_block(uint8_t opcode)
+{
+	switch (opcode) {
+		case 0x00:	// BRK
+		case 0x20:	// JSR
+		case 0x40:	// RTI
+		case 0x4c:	// JMP abs
+		case 0x60:	// RTS
+		case 0x6c:	// JMP (ind)
+		case 0x10: case 0x30: case 0x50: case 0x70:	// Branches
+		case 0x90: case 0xb0: case 0xd0: case 0xf0:
+		case 0x02: case 0x12: case 0x22: case 0x32:	// Illegal
+		case 0x42: case 0x52: case 0x62: case 0x72:
+		case 0x92: case 0xb2: case 0xd2:
+		case 0xf2:	// Extension opcode
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+/*
+ *  Get pointer to contents of page as seen by instruction fetches
+ *  (nullptr = page is not cacheable)
+ */
+
+const uint8_t * MOS6510::code_page(unsigned page) const
+{
+	if (page < 2) {	// Zero page and stack change all the time
+		return nullptr;
+	}
+	return read_table[page];
+}
+
+
+/*
+ *  Find or decode basic block starting at adr, returns pointer to first
+ *  instruction and sets end and gen for the caller's validity checks
+ */
+
+const MOS6510::DecodedOp * MOS6510::fetch_block(uint16_t adr, const DecodedOp * & end, uint64_t & gen)
+{
+	unsigned page = adr >> 8;
+	gen = page_gen[page];
+
+	CodeBlock & b = code_blocks[(adr ^ (adr >> 12)) & (NUM_CODE_BLOCKS - 1)];
+	if (b.start != adr || b.gen != gen || b.num_ops == 0) {
+
+		// Decode new block
+		unsigned n = 0;
+		const uint8_t * p = code_page(page);
+		if (p) {
+			unsigned ofs = adr & 0xff;
+			while (n < MAX_BLOCK_OPS) {
+				uint8_t opcode = p[ofs];
+				unsigned length = op_length[opcode];
+				if (ofs + length > 0x100) {
+					break;	// Instruction crosses page boundary
+				}
+
+				DecodedOp & op = b.ops[n++];
+				op.opcode = opcode;
+				op.length = length;
+				switch (length) {
+					case 2:
+						op.operand = p[ofs + 1];
+						break;
+					case 3:
+						op.operand = p[ofs + 1] | (p[ofs + 2] << 8);
+						break;
+					default:
+						op.operand = 0;
+						break;
+				}
+
+				ofs += length;
+				if (ofs == 0x100 || ends_block(opcode)) {
+					break;
+				}
+			}
+		}
+
+		if (n == 0) {
+
+			// Not cacheable, decode single instruction
+			// (reads all operand bytes, even those the instruction ignores)
+			single_op.opcode = read_byte(adr);
+			single_op.length = op_length[single_op.opcode];
+			switch (single_op.length) {
+				case 2:
+					single_op.operand = read_byte(adr + 1);
+					break;
+				case 3:
+					single_op.operand = read_word(adr + 1);
+					break;
+				default:
+					single_op.operand = 0;
+					break;
+			}
+			end = &single_op + 1;
+			return &single_op;
+		}
+
+		b.gen = gen;
+		b.start = adr;
+		b.num_ops = n;
+	}
+
+	end = b.ops + b.num_ops;
+	return b.ops;
+}
+
+#endif
+
+
 /*
  *  Emulate cycles_left worth of 6510 instructions
  *  Returns number of cycles of last instruction
@@ -694,6 +977,14 @@ int MOS6510::EmulateLine(int cycles_left)
 
 	int last_cycles = 0;
 
+#if CPU_BLOCK_CACHE
+	const DecodedOp * op = nullptr;		// Next instruction in current block
+	const DecodedOp * op_end = nullptr;	// End of current block
+	uint64_t op_gen = 0;				// Generation of current block
+	uint16_t op_pc = 0;					// Address of next instruction in current block
+	uint16_t op_operand;				// Operand of current instruction
+#endif
+
 #define RESET_PENDING (int_line[INT_RESET])
 #define IRQ_PENDING (int_line[INT_VICIRQ] || int_line[INT_CIAIRQ])
 #define CHECK_SO ;
@@ -707,21 +998,25 @@ int MOS6510::EmulateLine(int cycles_left)
 			} else switch (read_byte_imm()) {
 				case 0x00:
 					ram[0x90] |= the_iec->Out(ram[0x95], ram[0xa3] & 0x80);
+					dirty_pages[0] = 1;
 					c_flag = false;
 					jump(0xedac);
 					break;
 				case 0x01:
 					ram[0x90] |= the_iec->OutATN(ram[0x95]);
+					dirty_pages[0] = 1;
 					c_flag = false;
 					jump(0xedac);
 					break;
 				case 0x02:
 					ram[0x90] |= the_iec->OutSec(ram[0x95]);
+					dirty_pages[0] = 1;
 					c_flag = false;
 					jump(0xedac);
 					break;
 				case 0x03:
 					ram[0x90] |= the_iec->In(a);
+					dirty_pages[0] = 1;
 					set_nz(a);
 					c_flag = false;
 					jump(0xedac);
@@ -746,6 +1041,21 @@ int MOS6510::EmulateLine(int cycles_left)
 					the_c64->AutoStartOp();
 					x = 0;	// patch replaces LDX #0
 					break;
+				case 0x11:	// Read tape block (replaces JSR $FCBD)
+					if (x == 0x0e && the_c64->TapeReadBlockOp()) {
+						// Block loaded, continue like the tape interrupt
+						// routine does after the last byte: CLI at $F8BD,
+						// then JSR $FC93 to restore the IRQ vector
+						i_flag = false;
+						push_byte(0xf8);
+						push_byte(0xbd);
+						jump(0xfc93);
+					} else {
+						push_byte(0xf8);
+						push_byte(0xa3);
+						jump(0xfcbd);
+					}
+					break;
 				default:
 					illegal_op(pc - 1);
 					break;
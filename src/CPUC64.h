@@ -23,6 +23,8 @@
 
 #include "C64.h"
 
+#include <vector>
+
 
 // Set this to 1 for more precise CPU cycle calculation
 #ifndef PRECISE_CPU_CYCLES
@@ -34,6 +36,12 @@
 #define PRECISE_CIA_CYCLES 0
 #endif
 
+// Set this to 1 to execute pre-decoded basic blocks from a translation cache
+// (Frodo only)
+#ifndef CPU_BLOCK_CACHE
+#define CPU_BLOCK_CACHE 0
+#endif
+
 
 // Interrupt types
 enum {
@@ -70,6 +78,8 @@ public:
 		the_cart = cart;
 		the_iec = iec;
 		the_tape = tape;
+		update_page_tables();
+		InvalidateCode();
 	}
 
 #ifdef FRODO_SC
@@ -85,6 +95,8 @@ public:
 	void GetState(MOS6510State *s) const;
 	void SetState(const MOS6510State *s);
 
+	void InvalidateCode();				// Memory was changed without going through the CPU
+
 	uint8_t ExtReadByte(uint16_t adr);
 	void ExtWriteByte(uint16_t adr, uint8_t byte);
 	uint8_t REUReadByte(uint16_t adr);
@@ -100,6 +112,7 @@ public:
 	void SetTapeSense(bool pressed);
 
 	uint16_t GetPC() const { return pc; }
+	bool KernalIn() const { return kernal_in; }
 
 	int ExtConfig;			// Memory configuration for ExtRead/WriteByte (0..7)
 
@@ -119,6 +132,9 @@ private:
 	void write_zp(uint16_t adr, uint8_t byte);
 
 	void new_config();
+	void update_page_tables();
+	void map_read_page(unsigned page, const uint8_t * p);
+	void check_cart_mapping();
 	void illegal_op(uint16_t adr);
 
 	void do_adc(uint8_t byte);
@@ -141,6 +157,7 @@ private:
 	uint8_t * kernal_rom;
 	uint8_t * char_rom;
 	uint8_t * color_ram;	// Pointer to color RAM
+	uint8_t * dirty_pages;	// Pointer to dirty page map (see C64::DirtyPages)
 
 	bool int_line[4];		// Interrupt line state (index: INT_*)
 	bool nmi_triggered;		// Flag: NMI triggered by transition
@@ -174,9 +191,42 @@ private:
 	bool tape_sense;			// Tape sense line (true = button pressed)
 	int	borrowed_cycles;		// Borrowed cycles from next line
 	uint8_t dfff_byte;			// Byte at $dfff for emulator ID
+
+	void code_changed(unsigned page);
+
+#if CPU_BLOCK_CACHE
+	// Pre-decoded instruction
+	struct DecodedOp {
+		uint8_t opcode;
+		uint8_t length;			// Instruction length in bytes
+		uint16_t operand;		// Operand byte or word
+	};
+
+	// Pre-decoded basic block (never crosses a page boundary)
+	static constexpr unsigned MAX_BLOCK_OPS = 16;
+	static constexpr unsigned NUM_CODE_BLOCKS = 4096;
+
+	struct CodeBlock {
+		DecodedOp ops[MAX_BLOCK_OPS];
+		uint64_t gen;			// Value of page_gen[] at decoding time
+		uint16_t start;			// Address of first instruction
+		uint8_t num_ops;		// Number of instructions (0 = unused entry)
+	};
+
+	const DecodedOp * fetch_block(uint16_t adr, const DecodedOp * & end, uint64_t & gen);
+	const uint8_t * code_page(unsigned page) const;
+
+	std::vector<CodeBlock> code_blocks;	// Direct-mapped block cache
+	DecodedOp single_op;		// Instruction outside of cacheable memory
+	uint64_t page_gen[256];		// Per-page generation counter, incremented when contents or mapping change
+#endif
 #endif
 
 	bool basic_in, kernal_in, char_in, io_in;
+
+	const uint8_t * read_table[256];	// Memory for direct reads per page (nullptr = read_byte_io())
+	uint8_t * write_table[256];			// Memory for direct writes per page (nullptr = write_byte_io())
+	unsigned cart_map_gen;				// Cartridge::mapGeneration the tables were built for
 };
 
 
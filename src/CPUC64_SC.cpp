@@ -32,9 +32,14 @@
  *  - The states 0x0008..0x0017 are used for interrupts
  *  - There is exactly one memory access in each clock cycle
  *  - All memory accesses are done with the read_byte() and write_byte()
- *    functions which also do the memory address decoding.
+ *    functions. They look up the page in read_table[] or write_table[] and
+ *    access RAM or ROM directly, only the processor port, I/O space, and
+ *    cartridge banks with side effects are decoded by read_byte_io() and
+ *    write_byte_io().
  *  - If a write occurs to addresses 0 or 1, new_config() is called to check
- *    whether the memory configuration has changed.
+ *    whether the memory configuration has changed. The page tables are
+ *    rebuilt by update_page_tables() when it has, or when the cartridge
+ *    switches banks or its EXROM/GAME lines.
  *  - The possible interrupt sources are:
  *      INT_VICIRQ: I flag is checked, jump to ($fffe)
  *      INT_CIAIRQ: I flag is checked, jump to ($fffe)
@@ -66,7 +71,7 @@
  */
 
 MOS6510::MOS6510(C64 *c64, uint8_t *Ram, uint8_t *Basic, uint8_t *Kernal, uint8_t *Char, uint8_t *Color)
- : the_c64(c64), ram(Ram), basic_rom(Basic), kernal_rom(Kernal), char_rom(Char), color_ram(Color)
+ : the_c64(c64), ram(Ram), basic_rom(Basic), kernal_rom(Kernal), char_rom(Char), color_ram(Color), dirty_pages(c64->DirtyPages)
 {
 	a = x = y = 0;
 	sp = 0xff;
@@ -90,6 +95,17 @@ MOS6510::MOS6510(C64 *c64, uint8_t *Ram, uint8_t *Basic, uint8_t *Kernal, uint8_
 	nmi_delay = 0;
 
 	tape_write = false;
+
+	basic_in = kernal_in = char_in = io_in = false;
+
+	// $0000..$7fff and $c000..$cfff are always RAM, the rest of the
+	// tables is set up by update_page_tables()
+	for (unsigned page = 0; page < 0x100; ++page) {
+		read_table[page] = ram + (page << 8);
+		write_table[page] = ram + (page << 8);
+	}
+	write_table[0xff] = nullptr;	// For FF00Trigger()
+	cart_map_gen = 0;
 }
 
 
@@ -240,6 +256,15 @@ void MOS6510::SetState(const MOS6510State *s)
 }
 
 
+/*
+ *  Discard all pre-decoded code (not used by Frodo SC)
+ */
+
+void MOS6510::InvalidateCode()
+{
+}
+
+
 /*
  *  Set tape sense line status
  */
@@ -263,6 +288,9 @@ void MOS6510::new_config()
 	pr_out = (pr_out & ~ddr) | (pr & ddr);
 	uint8_t port = pr | ~ddr;
 
+	bool old_basic_in = basic_in, old_kernal_in = kernal_in;
+	bool old_char_in = char_in, old_io_in = io_in;
+
 	basic_in = (port & 3) == 3;
 	kernal_in = port & 2;
 	if (the_cart->notGAME) {
@@ -272,6 +300,12 @@ void MOS6510::new_config()
 	}
 	io_in = (port & 3) && (port & 4);
 
+	if (basic_in != old_basic_in || kernal_in != old_kernal_in || char_in != old_char_in || io_in != old_io_in) {
+		update_page_tables();
+	} else {
+		check_cart_mapping();
+	}
+
 	bool tape_motor = (port & 0x20) == 0;
 	the_tape->SetMotor(tape_motor);
 
@@ -285,6 +319,73 @@ void MOS6510::new_config()
 }
 
 
+/*
+ *  Set memory for direct reads from page
+ */
+
+inline void MOS6510::map_read_page(unsigned page, const uint8_t * p)
+{
+	read_table[page] = p;
+}
+
+
+/*
+ *  Rebuild page tables for $8000..$ffff from the memory configuration
+ *  and the cartridge state
+ */
+
+void MOS6510::update_page_tables()
+{
+	cart_map_gen = the_cart->mapGeneration;
+
+	// Cartridge ROML or RAM
+	const uint8_t * roml = ram + 0x8000;
+	if (! the_cart->notEXROM) {
+		roml = the_cart->MapROML(ram + 0x8000, basic_in);
+	}
+
+	// Cartridge ROMH or RAM or BASIC ROM
+	const uint8_t * romh;
+	if (the_cart->notEXROM || the_cart->notGAME) {
+		romh = basic_in ? basic_rom : ram + 0xa000;
+	} else {
+		romh = the_cart->MapROMH(ram + 0xa000, basic_rom, basic_in, kernal_in);
+	}
+
+	// I/O or char ROM or RAM
+	const uint8_t * io = nullptr;
+	if (! io_in) {
+		io = char_in ? char_rom : ram + 0xd000;
+	}
+
+	// Kernal ROM or RAM
+	const uint8_t * kernal = kernal_in ? kernal_rom : ram + 0xe000;
+
+	for (unsigned i = 0; i < 0x20; ++i) {
+		map_read_page(0x80 + i, roml ? roml + (i << 8) : nullptr);
+		map_read_page(0xa0 + i, romh ? romh + (i << 8) : nullptr);
+		map_read_page(0xe0 + i, kernal + (i << 8));
+	}
+	for (unsigned i = 0; i < 0x10; ++i) {
+		map_read_page(0xd0 + i, io ? io + (i << 8) : nullptr);
+		write_table[0xd0 + i] = io_in ? nullptr : ram + 0xd000 + (i << 8);
+	}
+}
+
+
+/*
+ *  Cartridge may have switched banks or changed its EXROM/GAME lines,
+ *  rebuild page tables if it did
+ */
+
+inline void MOS6510::check_cart_mapping()
+{
+	if (the_cart->mapGeneration != cart_map_gen) {
+		update_page_tables();
+	}
+}
+
+
 /*
  *  Read a byte from I/O / ROM space
  */
@@ -330,10 +431,18 @@ inline uint8_t MOS6510::read_byte_io(uint16_t adr)
 						return the_cia1->ReadRegister(adr & 0x0f);
 					case 0xd:	// CIA 2
 						return the_cia2->ReadRegister(adr & 0x0f);
-					case 0xe:	// Cartridge I/O 1 (or open)
-						return the_cart->ReadIO1(adr & 0xff, the_vic->LastVICByte);
-					case 0xf:	// Cartridge I/O 2 (or open)
-						return the_cart->ReadIO2(adr & 0xff, the_vic->LastVICByte);
+					case 0xe: {	// Cartridge I/O 1 (or open)
+						uint8_t byte = the_cart->ReadIO1(adr & 0xff, the_vic->LastVICByte);
+						check_cart_mapping();
+						return byte;
+					}
+					case 0xf: {	// Cartridge I/O 2 (or open)
+						uint8_t byte = the_cart->ReadIO2(adr & 0xff, the_vic->LastVICByte);
+						check_cart_mapping();
+						return byte;
+					}
+					default:	// Can't happen
+						return 0;
 				}
 			} else if (char_in) {
 				return char_rom[adr & 0x0fff];
@@ -359,20 +468,21 @@ inline uint8_t MOS6510::read_byte_io(uint16_t adr)
 
 uint8_t MOS6510::read_byte(uint16_t adr)
 {
-	if (adr < 0x8000) {
-		if (adr >= 2) {
-			return ram[adr];
-		} else if (adr == 0) {
-			return ddr;
+	if (adr >= 2) {
+		const uint8_t * p = read_table[adr >> 8];
+		if (p) {
+			return p[adr & 0xff];
 		} else {
-			uint8_t byte = (pr | ~ddr) & (pr_out | pr_in);
-			if (!(ddr & 0x20)) {
-				byte &= 0xdf;
-			}
-			return byte;
+			return read_byte_io(adr);
 		}
+	} else if (adr == 0) {
+		return ddr;
 	} else {
-		return read_byte_io(adr);
+		uint8_t byte = (pr | ~ddr) & (pr_out | pr_in);
+		if (!(ddr & 0x20)) {
+			byte &= 0xdf;
+		}
+		return byte;
 	}
 }
 
@@ -395,6 +505,7 @@ inline void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 {
 	if (adr >= 0xe000) {
 		ram[adr] = byte;
+		dirty_pages[adr >> 8] = 1;
 		if (adr == 0xff00) {
 			the_cart->FF00Trigger();
 		}
@@ -412,7 +523,7 @@ inline void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 				the_sid->WriteRegister(adr & 0x1f, byte);
 				return;
 			case 0x7:
-				if (ThePrefs.TestBench && adr == 0xd7ff) {
+				if (the_c64->GetPrefs().TestBench && adr == 0xd7ff) {
 					the_c64->RequestQuit(byte);
 				} else {
 					the_sid->WriteRegister(adr & 0x1f, byte);
@@ -423,6 +534,7 @@ inline void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 			case 0xa:
 			case 0xb:
 				color_ram[adr & 0x03ff] = byte & 0x0f;
+				dirty_pages[FIRST_COLOR_PAGE + ((adr >> 8) & 0x03)] = 1;
 				return;
 			case 0xc:	// CIA 1
 				the_cia1->WriteRegister(adr & 0x0f, byte);
@@ -432,13 +544,16 @@ inline void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 				return;
 			case 0xe:	// Cartridge I/O 1 (or open)
 				the_cart->WriteIO1(adr & 0xff, byte);
+				check_cart_mapping();
 				return;
 			case 0xf:	// Cartridge I/O 2 (or open)
 				the_cart->WriteIO2(adr & 0xff, byte);
+				check_cart_mapping();
 				return;
 		}
 	} else {
 		ram[adr] = byte;
+		dirty_pages[adr >> 8] = 1;
 	}
 }
 
@@ -449,20 +564,24 @@ inline void MOS6510::write_byte_io(uint16_t adr, uint8_t byte)
 
 void MOS6510::write_byte(uint16_t adr, uint8_t byte)
 {
-	if (adr < 0xd000) {
-		if (adr >= 2) {
-			ram[adr] = byte;
-		} else if (adr == 0) {
+	if (adr >= 2) {
+		uint8_t * p = write_table[adr >> 8];
+		if (p) {
+			p[adr & 0xff] = byte;
+			dirty_pages[adr >> 8] = 1;
+		} else {
+			write_byte_io(adr, byte);
+		}
+	} else {
+		dirty_pages[0] = 1;
+		if (adr == 0) {
 			ddr = byte;
 			ram[0] = the_vic->LastVICByte;
-			new_config();
 		} else {
 			pr = byte;
 			ram[1] = the_vic->LastVICByte;
-			new_config();
 		}
-	} else {
-		write_byte_io(adr, byte);
+		new_config();
 	}
 }
 
@@ -481,12 +600,14 @@ uint8_t MOS6510::ExtReadByte(uint16_t adr)
 	kernal_in = ExtConfig & 2;
 	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	update_page_tables();
 
 	// Read byte
 	uint8_t byte = read_byte(adr);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	update_page_tables();
 
 	return byte;
 }
@@ -506,12 +627,14 @@ void MOS6510::ExtWriteByte(uint16_t adr, uint8_t byte)
 	kernal_in = ExtConfig & 2;
 	char_in = (ExtConfig & 3) && ~(ExtConfig & 4);
 	io_in = (ExtConfig & 3) && (ExtConfig & 4);
+	update_page_tables();
 
 	// Write byte
 	write_byte(adr, byte);
 
 	// Restore old configuration
 	basic_in = bi; kernal_in = ki; char_in = ci; io_in = ii;
+	update_page_tables();
 }
 
 
@@ -670,7 +793,7 @@ void MOS6510::EmulateCycle()
 #include "CPU_emulcycle.h"
 
 		// Extension opcode
-		case O_EXT:
+		STATE(O_EXT):
 			if ((pc < 0xa000) || (pc >= 0xc000 && pc < 0xe000)) {
 				illegal_op(pc - 1);
 				break;
@@ -678,21 +801,25 @@ void MOS6510::EmulateCycle()
 			switch (read_byte(pc++)) {
 				case 0x00:
 					ram[0x90] |= the_iec->Out(ram[0x95], ram[0xa3] & 0x80);
+					dirty_pages[0] = 1;
 					c_flag = false;
 					pc = 0xedac;
 					Last;
 				case 0x01:
 					ram[0x90] |= the_iec->OutATN(ram[0x95]);
+					dirty_pages[0] = 1;
 					c_flag = false;
 					pc = 0xedac;
 					Last;
 				case 0x02:
 					ram[0x90] |= the_iec->OutSec(ram[0x95]);
+					dirty_pages[0] = 1;
 					c_flag = false;
 					pc = 0xedac;
 					Last;
 				case 0x03:
 					ram[0x90] |= the_iec->In(a);
+					dirty_pages[0] = 1;
 					set_nz(a);
 					c_flag = false;
 					pc = 0xedac;
@@ -717,13 +844,28 @@ void MOS6510::EmulateCycle()
 					the_c64->AutoStartOp();
 					x = 0;	// patch replaces LDX #0
 					Last;
+				case 0x11:	// Read tape block (replaces JSR $FCBD)
+					if (x == 0x0e && the_c64->TapeReadBlockOp()) {
+						// Block loaded, continue like the tape interrupt
+						// routine does after the last byte: CLI at $F8BD,
+						// then JSR $FC93 to restore the IRQ vector
+						i_flag = false;
+						write_byte(sp-- | 0x100, 0xf8);
+						write_byte(sp-- | 0x100, 0xbd);
+						pc = 0xfc93;
+					} else {
+						write_byte(sp-- | 0x100, 0xf8);
+						write_byte(sp-- | 0x100, 0xa3);
+						pc = 0xfcbd;
+					}
+					Last;
 				default:
 					illegal_op(pc - 1);
 					break;
 			}
 			break;
 
-		default:
+		STATE_ILLEGAL:
 			illegal_op(pc - 1);
 			break;
 	}
@@ -87,13 +87,87 @@
 
 /*
  *  EmulCycle() function
+ *
+ *  The states are dispatched either by a switch statement, or (if
+ *  CPU_COMPUTED_GOTO is defined) by computed gotos through a table of
+ *  label addresses (GCC/Clang "labels as values" extension)
  */
 
+#ifdef CPU_COMPUTED_GOTO
+
+#ifndef __GNUC__
+#error "CPU_COMPUTED_GOTO requires GCC or Clang"
+#endif
+
+// All states handled by EmulateCycle() (a state missing here causes an
+// "unused label" warning)
+#define STATE_LABELS(X) \
+	X(O_FETCH) X(O_IRQ) X(0x000a) X(0x000b) X(0x000c) X(0x000d) X(0x000e) \
+	X(O_NMI) X(0x0012) X(0x0013) X(0x0014) X(0x0015) X(0x0016) X(O_BRK) \
+	X(O_BRK1) X(O_BRK2) X(O_BRK3) X(O_BRK4) X(O_BRK5) X(A_ZERO) X(A_ZEROX) \
+	X(A_ZEROX1) X(A_ZEROY) X(A_ZEROY1) X(A_ABS) X(A_ABS1) X(A_ABSX) X(A_ABSX1) \
+	X(A_ABSX2) X(A_ABSX3) X(A_ABSY) X(A_ABSY1) X(A_ABSY2) X(A_ABSY3) X(A_INDX) \
+	X(A_INDX1) X(A_INDX2) X(A_INDX3) X(A_INDY) X(A_INDY1) X(A_INDY2) \
+	X(A_INDY3) X(A_INDY4) X(AE_ABSX) X(AE_ABSX1) X(AE_ABSX2) X(AE_ABSY) \
+	X(AE_ABSY1) X(AE_ABSY2) X(AE_INDY) X(AE_INDY1) X(AE_INDY2) X(AE_INDY3) \
+	X(M_ZERO) X(M_ZEROX) X(M_ZEROX1) X(M_ZEROY) X(M_ZEROY1) X(M_ABS) X(M_ABS1) \
+	X(M_ABSX) X(M_ABSX1) X(M_ABSX2) X(M_ABSX3) X(M_ABSY) X(M_ABSY1) X(M_ABSY2) \
+	X(M_ABSY3) X(M_INDX) X(M_INDX1) X(M_INDX2) X(M_INDX3) X(M_INDY) X(M_INDY1) \
+	X(M_INDY2) X(M_INDY3) X(M_INDY4) X(RMW_DO_IT) X(RMW_DO_IT1) X(O_LDA) \
+	X(O_LDA_I) X(O_LDX) X(O_LDX_I) X(O_LDY) X(O_LDY_I) X(O_STA) X(O_STX) \
+	X(O_STY) X(O_TAX) X(O_TXA) X(O_TAY) X(O_TYA) X(O_TSX) X(O_TXS) X(O_ADC) \
+	X(O_ADC_I) X(O_SBC) X(O_SBC_I) X(O_INX) X(O_DEX) X(O_INY) X(O_DEY) \
+	X(O_INC) X(O_DEC) X(O_AND) X(O_AND_I) X(O_ORA) X(O_ORA_I) X(O_EOR) \
+	X(O_EOR_I) X(O_CMP) X(O_CMP_I) X(O_CPX) X(O_CPX_I) X(O_CPY) X(O_CPY_I) \
+	X(O_BIT) X(O_ASL) X(O_ASL_A) X(O_LSR) X(O_LSR_A) X(O_ROL) X(O_ROL_A) \
+	X(O_ROR) X(O_ROR_A) X(O_PHA) X(O_PHA1) X(O_PLA) X(O_PLA1) X(O_PLA2) \
+	X(O_PHP) X(O_PHP1) X(O_PLP) X(O_PLP1) X(O_PLP2) X(O_JMP) X(O_JMP1) \
+	X(O_JMP_I) X(O_JMP_I1) X(O_JSR) X(O_JSR1) X(O_JSR2) X(O_JSR3) X(O_JSR4) \
+	X(O_RTS) X(O_RTS1) X(O_RTS2) X(O_RTS3) X(O_RTS4) X(O_RTI) X(O_RTI1) \
+	X(O_RTI2) X(O_RTI3) X(O_RTI4) X(O_BCS) X(O_BCC) X(O_BEQ) X(O_BNE) X(O_BVS) \
+	X(O_BVC) X(O_BMI) X(O_BPL) X(O_BRANCH_NP) X(O_BRANCH_BP) X(O_BRANCH_BP1) \
+	X(O_BRANCH_FP) X(O_BRANCH_FP1) X(O_SEC) X(O_CLC) X(O_SED) X(O_CLD) \
+	X(O_SEI) X(O_CLI) X(O_CLV) X(O_NOP) X(O_NOP_I) X(O_NOP_A) X(O_LAX) \
+	X(O_SAX) X(O_SLO) X(O_RLA) X(O_SRE) X(O_RRA) X(O_DCP) X(O_ISB) X(O_ANC_I) \
+	X(O_ASR_I) X(O_ARR_I) X(O_ANE_I) X(O_LXA_I) X(O_SBX_I) X(O_LAS) X(O_SHS) \
+	X(O_SHY) X(O_SHX) X(O_SHA) X(O_EXT)
+
+#define STATE(s) state_##s
+#define STATE_ILLEGAL state_illegal
+
+	// Build table of label addresses on first call (label addresses are
+	// only available inside this function, so a statement expression is
+	// used to get the thread-safe initialization of a local static)
+	static_assert(O_EXT < 256);
+	struct DispatchTable { const void * label[256]; };
+	static const DispatchTable dispatch = ({
+		DispatchTable t;
+		for (auto & label : t.label) {
+			label = &&state_illegal;
+		}
+#define SET_LABEL(s) t.label[s] = &&state_##s;
+		STATE_LABELS(SET_LABEL)
+#undef SET_LABEL
+		t;
+	});
+
+	// The switch statement only provides the target for "break"
+	switch (0) {
+	default:
+		goto *dispatch.label[state];
+
+#else
+
+#define STATE(s) case s
+#define STATE_ILLEGAL default
+
 	switch (state) {
 
+#endif
+
 
 		// Opcode fetch
-		case O_FETCH:
+		STATE(O_FETCH):
 			if (RESET_PENDING) {
 				Reset();
 				break;
@@ -111,15 +185,15 @@
 
 
 		// IRQ
-		case O_IRQ:
+		STATE(O_IRQ):
 			read_idle(pc);
 			state = 0x000a;
 			break;
-		case 0x000a:
+		STATE(0x000a):
 			write_byte(sp-- | 0x100, pc >> 8);
 			state = 0x000b;
 			break;
-		case 0x000b:
+		STATE(0x000b):
 			write_byte(sp-- | 0x100, pc);
 			if (nmi_triggered) {	// Recognize NMI
 				nmi_pending = true;
@@ -127,7 +201,7 @@
 			}
 			state = 0x000c;
 			break;
-		case 0x000c:
+		STATE(0x000c):
 			irq_pending = false;
 			push_flags(false);
 			i_flag = true;
@@ -138,11 +212,11 @@
 				state = 0x000d;
 			}
 			break;
-		case 0x000d:
+		STATE(0x000d):
 			read_to(0xfffe, pc);
 			state = 0x000e;
 			break;
-		case 0x000e:
+		STATE(0x000e):
 			read_to(0xffff, data);
 			pc |= data << 8;
 			state = O_FETCH;
@@ -150,29 +224,29 @@
 
 
 		// NMI
-		case O_NMI:
+		STATE(O_NMI):
 			read_idle(pc);
 			state = 0x0012;
 			break;
-		case 0x0012:
+		STATE(0x0012):
 			write_byte(sp-- | 0x100, pc >> 8);
 			state = 0x0013;
 			break;
-		case 0x0013:
+		STATE(0x0013):
 			write_byte(sp-- | 0x100, pc);
 			state = 0x0014;
 			break;
-		case 0x0014:
+		STATE(0x0014):
 			irq_pending = nmi_pending = false;
 			push_flags(false);
 			i_flag = true;
 			state = 0x0015;
 			break;
-		case 0x0015:
+		STATE(0x0015):
 			read_to(0xfffa, pc);
 			state = 0x0016;
 			break;
-		case 0x0016:
+		STATE(0x0016):
 			read_to(0xfffb, data);
 			pc |= data << 8;
 			state = O_FETCH;
@@ -180,15 +254,15 @@
 
 
 		// BRK
-		case O_BRK:
+		STATE(O_BRK):
 			read_idle(pc++);
 			state = O_BRK1;
 			break;
-		case O_BRK1:
+		STATE(O_BRK1):
 			write_byte(sp-- | 0x100, pc >> 8);
 			state = O_BRK2;
 			break;
-		case O_BRK2:
+		STATE(O_BRK2):
 			write_byte(sp-- | 0x100, pc);
 			if (nmi_triggered) {	// Recognize NMI
 				nmi_pending = true;
@@ -196,7 +270,7 @@
 			}
 			state = O_BRK3;
 			break;
-		case O_BRK3:
+		STATE(O_BRK3):
 			irq_pending = false;
 			push_flags(true);
 			i_flag = true;
@@ -207,11 +281,11 @@
 				state = O_BRK4;
 			}
 			break;
-		case O_BRK4:
+		STATE(O_BRK4):
 			read_to(0xfffe, pc);
 			state = O_BRK5;
 			break;
-		case O_BRK5:
+		STATE(O_BRK5):
 			read_to(0xffff, data);
 			pc |= data << 8;
 			state = O_FETCH;
@@ -219,42 +293,42 @@
 
 
 		// Addressing modes: Fetch effective address, no extra cycles (-> ar)
-		case A_ZERO:
+		STATE(A_ZERO):
 			read_to(pc++, ar);
 			Execute;
 
-		case A_ZEROX:
+		STATE(A_ZEROX):
 			read_to(pc++, ar);
 			state = A_ZEROX1;
 			break;
-		case A_ZEROX1:
+		STATE(A_ZEROX1):
 			read_idle(ar);
 			ar = (ar + x) & 0xff;
 			Execute;
 
-		case A_ZEROY:
+		STATE(A_ZEROY):
 			read_to(pc++, ar);
 			state = A_ZEROY1;
 			break;
-		case A_ZEROY1:
+		STATE(A_ZEROY1):
 			read_idle(ar);
 			ar = (ar + y) & 0xff;
 			Execute;
 
-		case A_ABS:
+		STATE(A_ABS):
 			read_to(pc++, ar);
 			state = A_ABS1;
 			break;
-		case A_ABS1:
+		STATE(A_ABS1):
 			read_to(pc++, data);
 			ar = ar | (data << 8);
 			Execute;
 
-		case A_ABSX:
+		STATE(A_ABSX):
 			read_to(pc++, ar);
 			state = A_ABSX1;
 			break;
-		case A_ABSX1:
+		STATE(A_ABSX1):
 			read_to(pc++, ar2);	// Note: Some undocumented opcodes rely on the value of ar2
 			if (ar + x < 0x100) {
 				state = A_ABSX2;
@@ -263,7 +337,7 @@
 			}
 			ar = ((ar + x) & 0xff) | (ar2 << 8);
 			break;
-		case A_ABSX2:	// No page crossed
+		STATE(A_ABSX2):	// No page crossed
 #ifndef IS_CPU_1541
 			if (BALow) {
 				ar2 = 0xfe;		// SHA/SHS/SHX/SHY during DMA
@@ -271,7 +345,7 @@
 #endif
 			read_idle(ar);
 			Execute;
-		case A_ABSX3:	// Page crossed
+		STATE(A_ABSX3):	// Page crossed
 #ifndef IS_CPU_1541
 			if (BALow) {
 				ar2 = 0xfe;		// SHA/SHS/SHX/SHY during DMA
@@ -281,11 +355,11 @@
 			ar += 0x100;
 			Execute;
 
-		case A_ABSY:
+		STATE(A_ABSY):
 			read_to(pc++, ar);
 			state = A_ABSY1;
 			break;
-		case A_ABSY1:
+		STATE(A_ABSY1):
 			read_to(pc++, ar2);	// Note: Some undocumented opcodes rely on the value of ar2
 			if (ar + y < 0x100) {
 				state = A_ABSY2;
@@ -294,7 +368,7 @@
 			}
 			ar = ((ar + y) & 0xff) | (ar2 << 8);
 			break;
-		case A_ABSY2:	// No page crossed
+		STATE(A_ABSY2):	// No page crossed
 #ifndef IS_CPU_1541
 			if (BALow) {
 				ar2 = 0xfe;		// SHA/SHS/SHX/SHY during DMA
@@ -302,7 +376,7 @@
 #endif
 			read_idle(ar);
 			Execute;
-		case A_ABSY3:	// Page crossed
+		STATE(A_ABSY3):	// Page crossed
 #ifndef IS_CPU_1541
 			if (BALow) {
 				ar2 = 0xfe;		// SHA/SHS/SHX/SHY during DMA
@@ -312,33 +386,33 @@
 			ar += 0x100;
 			Execute;
 
-		case A_INDX:
+		STATE(A_INDX):
 			read_to(pc++, ar2);
 			state = A_INDX1;
 			break;
-		case A_INDX1:
+		STATE(A_INDX1):
 			read_idle(ar2);
 			ar2 = (ar2 + x) & 0xff;
 			state = A_INDX2;
 			break;
-		case A_INDX2:
+		STATE(A_INDX2):
 			read_to(ar2, ar);
 			state = A_INDX3;
 			break;
-		case A_INDX3:
+		STATE(A_INDX3):
 			read_to((ar2 + 1) & 0xff, data);
 			ar = ar | (data << 8);
 			Execute;
 
-		case A_INDY:
+		STATE(A_INDY):
 			read_to(pc++, ar2);
 			state = A_INDY1;
 			break;
-		case A_INDY1:
+		STATE(A_INDY1):
 			read_to(ar2, ar);
 			state = A_INDY2;
 			break;
-		case A_INDY2:
+		STATE(A_INDY2):
 			read_to((ar2 + 1) & 0xff, ar2);	// Note: Some undocumented opcodes rely on the value of ar2
 			if (ar + y < 0x100) {
 				state = A_INDY3;
@@ -347,7 +421,7 @@
 			}
 			ar = ((ar + y) & 0xff) | (ar2 << 8);
 			break;
-		case A_INDY3:	// No page crossed
+		STATE(A_INDY3):	// No page crossed
 #ifndef IS_CPU_1541
 			if (BALow) {
 				ar2 = 0xfe;		// SHA during DMA
@@ -355,7 +429,7 @@
 #endif
 			read_idle(ar);
 			Execute;
-		case A_INDY4:	// Page crossed
+		STATE(A_INDY4):	// Page crossed
 #ifndef IS_CPU_1541
 			if (BALow) {
 				ar2 = 0xfe;		// SHA during DMA
@@ -367,11 +441,11 @@
 
 
 		// Addressing modes: Fetch effective address, extra cycle on page crossing (-> ar)
-		case AE_ABSX:
+		STATE(AE_ABSX):
 			read_to(pc++, ar);
 			state = AE_ABSX1;
 			break;
-		case AE_ABSX1:
+		STATE(AE_ABSX1):
 			read_to(pc++, data);
 			if (ar + x < 0x100) {
 				ar = ((ar + x) & 0xff) | (data << 8);
@@ -381,16 +455,16 @@
 				state = AE_ABSX2;
 			}
 			break;
-		case AE_ABSX2:	// Page crossed
+		STATE(AE_ABSX2):	// Page crossed
 			read_idle(ar);
 			ar += 0x100;
 			Execute;
 
-		case AE_ABSY:
+		STATE(AE_ABSY):
 			read_to(pc++, ar);
 			state = AE_ABSY1;
 			break;
-		case AE_ABSY1:
+		STATE(AE_ABSY1):
 			read_to(pc++, data);
 			if (ar + y < 0x100) {
 				ar = ((ar + y) & 0xff) | (data << 8);
@@ -400,20 +474,20 @@
 				state = AE_ABSY2;
 			}
 			break;
-		case AE_ABSY2:	// Page crossed
+		STATE(AE_ABSY2):	// Page crossed
 			read_idle(ar);
 			ar += 0x100;
 			Execute;
 
-		case AE_INDY:
+		STATE(AE_INDY):
 			read_to(pc++, ar2);
 			state = AE_INDY1;
 			break;
-		case AE_INDY1:
+		STATE(AE_INDY1):
 			read_to(ar2, ar);
 			state = AE_INDY2;
 			break;
-		case AE_INDY2:
+		STATE(AE_INDY2):
 			read_to((ar2 + 1) & 0xff, data);
 			if (ar + y < 0x100) {
 				ar = ((ar + y) & 0xff) | (data << 8);
@@ -423,49 +497,49 @@
 				state = AE_INDY3;
 			}
 			break;
-		case AE_INDY3:	// Page crossed
+		STATE(AE_INDY3):	// Page crossed
 			read_idle(ar);
 			ar += 0x100;
 			Execute;
 
 
 		// Addressing modes: Read operand, write it back, no extra cycles (-> ar, rdbuf)
-		case M_ZERO:
+		STATE(M_ZERO):
 			read_to(pc++, ar);
 			DoRMW;
 
-		case M_ZEROX:
+		STATE(M_ZEROX):
 			read_to(pc++, ar);
 			state = M_ZEROX1;
 			break;
-		case M_ZEROX1:
+		STATE(M_ZEROX1):
 			read_idle(ar);
 			ar = (ar + x) & 0xff;
 			DoRMW;
 
-		case M_ZEROY:
+		STATE(M_ZEROY):
 			read_to(pc++, ar);
 			state = M_ZEROY1;
 			break;
-		case M_ZEROY1:
+		STATE(M_ZEROY1):
 			read_idle(ar);
 			ar = (ar + y) & 0xff;
 			DoRMW;
 
-		case M_ABS:
+		STATE(M_ABS):
 			read_to(pc++, ar);
 			state = M_ABS1;
 			break;
-		case M_ABS1:
+		STATE(M_ABS1):
 			read_to(pc++, data);
 			ar = ar | (data << 8);
 			DoRMW;
 
-		case M_ABSX:
+		STATE(M_ABSX):
 			read_to(pc++, ar);
 			state = M_ABSX1;
 			break;
-		case M_ABSX1:
+		STATE(M_ABSX1):
 			read_to(pc++, data);
 			if (ar + x < 0x100) {
 				state = M_ABSX2;
@@ -474,19 +548,19 @@
 			}
 			ar = ((ar + x) & 0xff) | (data << 8);
 			break;
-		case M_ABSX2:	// No page crossed
+		STATE(M_ABSX2):	// No page crossed
 			read_idle(ar);
 			DoRMW;
-		case M_ABSX3:	// Page crossed
+		STATE(M_ABSX3):	// Page crossed
 			read_idle(ar);
 			ar += 0x100;
 			DoRMW;
 
-		case M_ABSY:
+		STATE(M_ABSY):
 			read_to(pc++, ar);
 			state = M_ABSY1;
 			break;
-		case M_ABSY1:
+		STATE(M_ABSY1):
 			read_to(pc++, data);
 			if (ar + y < 0x100) {
 				state = M_ABSY2;
@@ -495,41 +569,41 @@
 			}
 			ar = ((ar + y) & 0xff) | (data << 8);
 			break;
-		case M_ABSY2:	// No page crossed
+		STATE(M_ABSY2):	// No page crossed
 			read_idle(ar);
 			DoRMW;
-		case M_ABSY3:	// Page crossed
+		STATE(M_ABSY3):	// Page crossed
 			read_idle(ar);
 			ar += 0x100;
 			DoRMW;
 
-		case M_INDX:
+		STATE(M_INDX):
 			read_to(pc++, ar2);
 			state = M_INDX1;
 			break;
-		case M_INDX1:
+		STATE(M_INDX1):
 			read_idle(ar2);
 			ar2 = (ar2 + x) & 0xff;
 			state = M_INDX2;
 			break;
-		case M_INDX2:
+		STATE(M_INDX2):
 			read_to(ar2, ar);
 			state = M_INDX3;
 			break;
-		case M_INDX3:
+		STATE(M_INDX3):
 			read_to((ar2 + 1) & 0xff, data);
 			ar = ar | (data << 8);
 			DoRMW;
 
-		case M_INDY:
+		STATE(M_INDY):
 			read_to(pc++, ar2);
 			state = M_INDY1;
 			break;
-		case M_INDY1:
+		STATE(M_INDY1):
 			read_to(ar2, ar);
 			state = M_INDY2;
 			break;
-		case M_INDY2:
+		STATE(M_INDY2):
 			read_to((ar2 + 1) & 0xff, data);
 			if (ar + y < 0x100) {
 				state = M_INDY3;
@@ -538,205 +612,205 @@
 			}
 			ar = ((ar + y) & 0xff) | (data << 8);
 			break;
-		case M_INDY3:	// No page crossed
+		STATE(M_INDY3):	// No page crossed
 			read_idle(ar);
 			DoRMW;
-		case M_INDY4:	// Page crossed
+		STATE(M_INDY4):	// Page crossed
 			read_idle(ar);
 			ar += 0x100;
 			DoRMW;
 
-		case RMW_DO_IT:
+		STATE(RMW_DO_IT):
 			read_to(ar, rdbuf);
 			state = RMW_DO_IT1;
 			break;
-		case RMW_DO_IT1:
+		STATE(RMW_DO_IT1):
 			write_byte(ar, rdbuf);
 			Execute;
 
 
 		// Load group
-		case O_LDA:
+		STATE(O_LDA):
 			read_to(ar, data);
 			set_nz(a = data);
 			Last;
-		case O_LDA_I:
+		STATE(O_LDA_I):
 			read_to(pc++, data);
 			set_nz(a = data);
 			Last;
 
-		case O_LDX:
+		STATE(O_LDX):
 			read_to(ar, data);
 			set_nz(x = data);
 			Last;
-		case O_LDX_I:
+		STATE(O_LDX_I):
 			read_to(pc++, data);
 			set_nz(x = data);
 			Last;
 
-		case O_LDY:
+		STATE(O_LDY):
 			read_to(ar, data);
 			set_nz(y = data);
 			Last;
-		case O_LDY_I:
+		STATE(O_LDY_I):
 			read_to(pc++, data);
 			set_nz(y = data);
 			Last;
 
 
 		// Store group
-		case O_STA:
+		STATE(O_STA):
 			write_byte(ar, a);
 			Last;
 
-		case O_STX:
+		STATE(O_STX):
 			write_byte(ar, x);
 			Last;
 
-		case O_STY:
+		STATE(O_STY):
 			write_byte(ar, y);
 			Last;
 
 
 		// Transfer group
-		case O_TAX:
+		STATE(O_TAX):
 			read_idle(pc);
 			set_nz(x = a);
 			Last;
 
-		case O_TXA:
+		STATE(O_TXA):
 			read_idle(pc);
 			set_nz(a = x);
 			Last;
 
-		case O_TAY:
+		STATE(O_TAY):
 			read_idle(pc);
 			set_nz(y = a);
 			Last;
 
-		case O_TYA:
+		STATE(O_TYA):
 			read_idle(pc);
 			set_nz(a = y);
 			Last;
 
-		case O_TSX:
+		STATE(O_TSX):
 			read_idle(pc);
 			set_nz(x = sp);
 			Last;
 
-		case O_TXS:
+		STATE(O_TXS):
 			read_idle(pc);
 			sp = x;
 			Last;
 
 
 		// Arithmetic group
-		case O_ADC:
+		STATE(O_ADC):
 			read_to(ar, data);
 			do_adc(data);
 			Last;
-		case O_ADC_I:
+		STATE(O_ADC_I):
 			read_to(pc++, data);
 			do_adc(data);
 			Last;
 
-		case O_SBC:
+		STATE(O_SBC):
 			read_to(ar, data);
 			do_sbc(data);
 			Last;
-		case O_SBC_I:
+		STATE(O_SBC_I):
 			read_to(pc++, data);
 			do_sbc(data);
 			Last;
 
 
 		// Increment/decrement group
-		case O_INX:
+		STATE(O_INX):
 			read_idle(pc);
 			set_nz(++x);
 			Last;
 
-		case O_DEX:
+		STATE(O_DEX):
 			read_idle(pc);
 			set_nz(--x);
 			Last;
 
-		case O_INY:
+		STATE(O_INY):
 			read_idle(pc);
 			set_nz(++y);
 			Last;
 
-		case O_DEY:
+		STATE(O_DEY):
 			read_idle(pc);
 			set_nz(--y);
 			Last;
 
-		case O_INC:
+		STATE(O_INC):
 			write_byte(ar, set_nz(rdbuf + 1));
 			Last;
 
-		case O_DEC:
+		STATE(O_DEC):
 			write_byte(ar, set_nz(rdbuf - 1));
 			Last;
 
 
 		// Logic group
-		case O_AND:
+		STATE(O_AND):
 			read_to(ar, data);
 			set_nz(a &= data);
 			Last;
-		case O_AND_I:
+		STATE(O_AND_I):
 			read_to(pc++, data);
 			set_nz(a &= data);
 			Last;
 
-		case O_ORA:
+		STATE(O_ORA):
 			read_to(ar, data);
 			set_nz(a |= data);
 			Last;
-		case O_ORA_I:
+		STATE(O_ORA_I):
 			read_to(pc++, data);
 			set_nz(a |= data);
 			Last;
 
-		case O_EOR:
+		STATE(O_EOR):
 			read_to(ar, data);
 			set_nz(a ^= data);
 			Last;
-		case O_EOR_I:
+		STATE(O_EOR_I):
 			read_to(pc++, data);
 			set_nz(a ^= data);
 			Last;
 
 		// Compare group
-		case O_CMP:
+		STATE(O_CMP):
 			read_to(ar, data);
 			set_nz(ar = a - data);
 			c_flag = ar < 0x100;
 			Last;
-		case O_CMP_I:
+		STATE(O_CMP_I):
 			read_to(pc++, data);
 			set_nz(ar = a - data);
 			c_flag = ar < 0x100;
 			Last;
 
-		case O_CPX:
+		STATE(O_CPX):
 			read_to(ar, data);
 			set_nz(ar = x - data);
 			c_flag = ar < 0x100;
 			Last;
-		case O_CPX_I:
+		STATE(O_CPX_I):
 			read_to(pc++, data);
 			set_nz(ar = x - data);
 			c_flag = ar < 0x100;
 			Last;
 
-		case O_CPY:
+		STATE(O_CPY):
 			read_to(ar, data);
 			set_nz(ar = y - data);
 			c_flag = ar < 0x100;
 			Last;
-		case O_CPY_I:
+		STATE(O_CPY_I):
 			read_to(pc++, data);
 			set_nz(ar = y - data);
 			c_flag = ar < 0x100;
@@ -744,7 +818,7 @@
 
 
 		// Bit-test group
-		case O_BIT:
+		STATE(O_BIT):
 			read_to(ar, data);
 			z_flag = a & data;
 			n_flag = data;
@@ -753,42 +827,42 @@
 
 
 		// Shift/rotate group
-		case O_ASL:
+		STATE(O_ASL):
 			c_flag = rdbuf & 0x80;
 			write_byte(ar, set_nz(rdbuf << 1));
 			Last;
-		case O_ASL_A:
+		STATE(O_ASL_A):
 			read_idle(pc);
 			c_flag = a & 0x80;
 			set_nz(a <<= 1);
 			Last;
 
-		case O_LSR:
+		STATE(O_LSR):
 			c_flag = rdbuf & 0x01;
 			write_byte(ar, set_nz(rdbuf >> 1));
 			Last;
-		case O_LSR_A:
+		STATE(O_LSR_A):
 			read_idle(pc);
 			c_flag = a & 0x01;
 			set_nz(a >>= 1);
 			Last;
 
-		case O_ROL:
+		STATE(O_ROL):
 			write_byte(ar, set_nz(c_flag ? (rdbuf << 1) | 0x01 : rdbuf << 1));
 			c_flag = rdbuf & 0x80;
 			Last;
-		case O_ROL_A:
+		STATE(O_ROL_A):
 			read_idle(pc);
 			data = a & 0x80;
 			set_nz(a = c_flag ? (a << 1) | 0x01 : a << 1);
 			c_flag = data;
 			Last;
 
-		case O_ROR:
+		STATE(O_ROR):
 			write_byte(ar, set_nz(c_flag ? (rdbuf >> 1) | 0x80 : rdbuf >> 1));
 			c_flag = rdbuf & 0x01;
 			Last;
-		case O_ROR_A:
+		STATE(O_ROR_A):
 			read_idle(pc);
 			data = a & 0x01;
 			set_nz(a = (c_flag ? (a >> 1) | 0x80 : a >> 1));
@@ -797,44 +871,44 @@
 
 
 		// Stack group
-		case O_PHA:
+		STATE(O_PHA):
 			read_idle(pc);
 			state = O_PHA1;
 			break;
-		case O_PHA1:
+		STATE(O_PHA1):
 			write_byte(sp-- | 0x100, a);
 			Last;
 
-		case O_PLA:
+		STATE(O_PLA):
 			read_idle(pc);
 			state = O_PLA1;
 			break;
-		case O_PLA1:
+		STATE(O_PLA1):
 			read_idle(sp++ | 0x100);
 			state = O_PLA2;
 			break;
-		case O_PLA2:
+		STATE(O_PLA2):
 			read_to(sp | 0x100, data);
 			set_nz(a = data);
 			Last;
 
-		case O_PHP:
+		STATE(O_PHP):
 			read_idle(pc);
 			state = O_PHP1;
 			break;
-		case O_PHP1:
+		STATE(O_PHP1):
 			push_flags(true);
 			Last;
 
-		case O_PLP:
+		STATE(O_PLP):
 			read_idle(pc);
 			state = O_PLP1;
 			break;
-		case O_PLP1:
+		STATE(O_PLP1):
 			read_idle(sp++ | 0x100);
 			state = O_PLP2;
 			break;
-		case O_PLP2:
+		STATE(O_PLP2):
 			check_interrupts();	// Flag change is internally delayed, check interrupts first
 			pop_flags();
 			state = O_FETCH;
@@ -842,159 +916,159 @@
 
 
 		// Jump/branch group
-		case O_JMP:
+		STATE(O_JMP):
 			read_to(pc++, ar);
 			state = O_JMP1;
 			break;
-		case O_JMP1:
+		STATE(O_JMP1):
 			read_to(pc, data);
 			pc = (data << 8) | ar;
 			Last;
 
-		case O_JMP_I:
+		STATE(O_JMP_I):
 			read_to(ar, pc);
 			state = O_JMP_I1;
 			break;
-		case O_JMP_I1:
+		STATE(O_JMP_I1):
 			read_to(((ar + 1) & 0xff) | (ar & 0xff00), data);
 			pc |= data << 8;
 			Last;
 
-		case O_JSR:
+		STATE(O_JSR):
 			read_to(pc++, ar);
 			state = O_JSR1;
 			break;
-		case O_JSR1:
+		STATE(O_JSR1):
 			read_idle(sp | 0x100);
 			state = O_JSR2;
 			break;
-		case O_JSR2:
+		STATE(O_JSR2):
 			write_byte(sp-- | 0x100, pc >> 8);
 			state = O_JSR3;
 			break;
-		case O_JSR3:
+		STATE(O_JSR3):
 			write_byte(sp-- | 0x100, pc);
 			state = O_JSR4;
 			break;
-		case O_JSR4:
+		STATE(O_JSR4):
 			read_to(pc++, data);
 			pc = ar | (data << 8);
 			Last;
 
-		case O_RTS:
+		STATE(O_RTS):
 			read_idle(pc);
 			state = O_RTS1;
 			break;
-		case O_RTS1:
+		STATE(O_RTS1):
 			read_idle(sp++ | 0x100);
 			state = O_RTS2;
 			break;
-		case O_RTS2:
+		STATE(O_RTS2):
 			read_to(sp++ | 0x100, pc);
 			state = O_RTS3;
 			break;
-		case O_RTS3:
+		STATE(O_RTS3):
 			read_to(sp | 0x100, data);
 			pc |= data << 8;
 			state = O_RTS4;
 			break;
-		case O_RTS4:
+		STATE(O_RTS4):
 			read_idle(pc++);
 			Last;
 
-		case O_RTI:
+		STATE(O_RTI):
 			read_idle(pc);
 			state = O_RTI1;
 			break;
-		case O_RTI1:
+		STATE(O_RTI1):
 			read_idle(sp++ | 0x100);
 			state = O_RTI2;
 			break;
-		case O_RTI2:
+		STATE(O_RTI2):
 			pop_flags();
 			sp++;
 			state = O_RTI3;
 			break;
-		case O_RTI3:
+		STATE(O_RTI3):
 			read_to(sp++ | 0x100, pc);
 			state = O_RTI4;
 			break;
-		case O_RTI4:
+		STATE(O_RTI4):
 			read_to(sp | 0x100, data);
 			pc |= data << 8;
 			Last;
 
-		case O_BCS:
+		STATE(O_BCS):
 			Branch(c_flag);
 
-		case O_BCC:
+		STATE(O_BCC):
 			Branch(!c_flag);
 
-		case O_BEQ:
+		STATE(O_BEQ):
 			Branch(!z_flag);
 
-		case O_BNE:
+		STATE(O_BNE):
 			Branch(z_flag);
 
-		case O_BVS:
+		STATE(O_BVS):
 			CHECK_SO;	// Handle SO (GCR byte ready) input on 1541
 			Branch(v_flag);
 
-		case O_BVC:
+		STATE(O_BVC):
 			CHECK_SO;	// Handle SO (GCR byte ready) input on 1541
 			Branch(!v_flag);
 
-		case O_BMI:
+		STATE(O_BMI):
 			Branch(n_flag & 0x80);
 
-		case O_BPL:
+		STATE(O_BPL):
 			Branch(!(n_flag & 0x80));
 
-		case O_BRANCH_NP:		// No page crossed
+		STATE(O_BRANCH_NP):		// No page crossed
 			read_idle(pc);
 			pc = ar;
 			state = O_FETCH;	// No interrupt check
 			break;
-		case O_BRANCH_BP:		// Page crossed, branch backwards
+		STATE(O_BRANCH_BP):		// Page crossed, branch backwards
 			read_idle(pc);
 			pc = ar;
 			state = O_BRANCH_BP1;
 			break;
-		case O_BRANCH_BP1:
+		STATE(O_BRANCH_BP1):
 			read_idle(pc + 0x100);
 			Last;
-		case O_BRANCH_FP:		// Page crossed, branch forwards
+		STATE(O_BRANCH_FP):		// Page crossed, branch forwards
 			read_idle(pc);
 			pc = ar;
 			state = O_BRANCH_FP1;
 			break;
-		case O_BRANCH_FP1:
+		STATE(O_BRANCH_FP1):
 			read_idle(pc - 0x100);
 			Last;
 
 
 		// Flag group
-		case O_SEC:
+		STATE(O_SEC):
 			read_idle(pc);
 			c_flag = true;
 			Last;
 
-		case O_CLC:
+		STATE(O_CLC):
 			read_idle(pc);
 			c_flag = false;
 			Last;
 
-		case O_SED:
+		STATE(O_SED):
 			read_idle(pc);
 			d_flag = true;
 			Last;
 
-		case O_CLD:
+		STATE(O_CLD):
 			read_idle(pc);
 			d_flag = false;
 			Last;
 
-		case O_SEI:
+		STATE(O_SEI):
 #ifndef IS_CPU_1541
 			if (BALow && irq_delay) {
 				i_flag = true;	// Waiting for BA cancels the flag change delay
@@ -1006,7 +1080,7 @@
 			state = O_FETCH;
 			break;
 
-		case O_CLI:
+		STATE(O_CLI):
 #ifndef IS_CPU_1541
 			if (BALow) {
 				i_flag = false;	// Waiting for BA cancels the flag change delay
@@ -1018,14 +1092,14 @@
 			state = O_FETCH;
 			break;
 
-		case O_CLV:
+		STATE(O_CLV):
 			read_idle(pc);
 			v_flag = false;
 			Last;
 
 
 		// NOP group
-		case O_NOP:
+		STATE(O_NOP):
 			read_idle(pc);
 			Last;
 
@@ -1035,30 +1109,30 @@
  */
 
 		// NOP group
-		case O_NOP_I:
+		STATE(O_NOP_I):
 			read_idle(pc++);
 			Last;
 
-		case O_NOP_A:
+		STATE(O_NOP_A):
 			read_idle(ar);
 			Last;
 
 
 		// Load A/X group
-		case O_LAX:
+		STATE(O_LAX):
 			read_to(ar, data);
 			set_nz(a = x = data);
 			Last;
 
 
 		// Store A/X group
-		case O_SAX:
+		STATE(O_SAX):
 			write_byte(ar, a & x);
 			Last;
 
 
 		// ASL/ORA group
-		case O_SLO:
+		STATE(O_SLO):
 			c_flag = rdbuf & 0x80;
 			rdbuf <<= 1;
 			write_byte(ar, rdbuf);
@@ -1067,7 +1141,7 @@
 
 
 		// ROL/AND group
-		case O_RLA:
+		STATE(O_RLA):
 			tmp = rdbuf & 0x80;
 			rdbuf = c_flag ? (rdbuf << 1) | 0x01 : rdbuf << 1;
 			c_flag = tmp;
@@ -1077,7 +1151,7 @@
 
 
 		// LSR/EOR group
-		case O_SRE:
+		STATE(O_SRE):
 			c_flag = rdbuf & 0x01;
 			rdbuf >>= 1;
 			write_byte(ar, rdbuf);
@@ -1086,7 +1160,7 @@
 
 
 		// ROR/ADC group
-		case O_RRA:
+		STATE(O_RRA):
 			tmp = rdbuf & 0x01;
 			rdbuf = c_flag ? (rdbuf >> 1) | 0x80 : rdbuf >> 1;
 			c_flag = tmp;
@@ -1096,7 +1170,7 @@
 
 
 		// DEC/CMP group
-		case O_DCP:
+		STATE(O_DCP):
 			write_byte(ar, --rdbuf);
 			set_nz(ar = a - rdbuf);
 			c_flag = ar < 0x100;
@@ -1104,27 +1178,27 @@
 
 
 		// INC/SBC group
-		case O_ISB:
+		STATE(O_ISB):
 			write_byte(ar, ++rdbuf);
 			do_sbc(rdbuf);
 			Last;
 
 
 		// Complex functions
-		case O_ANC_I:
+		STATE(O_ANC_I):
 			read_to(pc++, data);
 			set_nz(a &= data);
 			c_flag = n_flag & 0x80;
 			Last;
 
-		case O_ASR_I:
+		STATE(O_ASR_I):
 			read_to(pc++, data);
 			a &= data;
 			c_flag = a & 0x01;
 			set_nz(a >>= 1);
 			Last;
 
-		case O_ARR_I:
+		STATE(O_ARR_I):
 			read_to(pc++, data);
 			data &= a;
 			a = (c_flag ? (data >> 1) | 0x80 : data >> 1);
@@ -1145,49 +1219,49 @@
 			}
 			Last;
 
-		case O_ANE_I:
+		STATE(O_ANE_I):
 			read_to(pc++, data);
 			set_nz(a = (a | 0xee) & x & data);
 			Last;
 
-		case O_LXA_I:
+		STATE(O_LXA_I):
 			read_to(pc++, data);
 			set_nz(a = x = (a | 0xee) & data);
 			Last;
 
-		case O_SBX_I:
+		STATE(O_SBX_I):
 			read_to(pc++, data);
 			set_nz(x = ar = (x & a) - data);
 			c_flag = ar < 0x100;
 			Last;
 
-		case O_LAS:
+		STATE(O_LAS):
 			read_to(ar, data);
 			set_nz(a = x = sp = data & sp);
 			Last;
 
-		case O_SHS:		// ar2 contains the high byte of the operand address
+		STATE(O_SHS):		// ar2 contains the high byte of the operand address
 			if ((ar & 0xff) < y) {	// Page crossed?
 				ar &= ((a & x) << 8) | 0xff;
 			}
 			write_byte(ar, (ar2 + 1) & (sp = a & x));
 			Last;
 
-		case O_SHY:		// ar2 contains the high byte of the operand address
+		STATE(O_SHY):		// ar2 contains the high byte of the operand address
 			if ((ar & 0xff) < x) {	// Page crossed?
 				ar &= (y << 8) | 0xff;
 			}
 			write_byte(ar, y & (ar2 + 1));
 			Last;
 
-		case O_SHX:		// ar2 contains the high byte of the operand address
+		STATE(O_SHX):		// ar2 contains the high byte of the operand address
 			if ((ar & 0xff) < y) {	// Page crossed?
 				ar &= (x << 8) | 0xff;
 			}
 			write_byte(ar, x & (ar2 + 1));
 			Last;
 
-		case O_SHA:		// ar2 contains the high byte of the operand address
+		STATE(O_SHA):		// ar2 contains the high byte of the operand address
 			if ((ar & 0xff) < y) {	// Page crossed?
 				ar &= ((a & x) << 8) | 0xff;
 			}
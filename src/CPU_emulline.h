@@ -26,7 +26,11 @@
  */
 
 // Read immediate operand
+#if CPU_BLOCK_CACHE && !defined(IS_CPU_1541)
+#define read_byte_imm() (pc++, (uint8_t)op_operand)
+#else
 #define read_byte_imm() read_byte(pc++)
+#endif
 
 // Read zeropage operand address
 #define read_adr_zero() ((uint16_t)read_byte_imm())
@@ -38,7 +42,11 @@
 #define read_adr_zero_y() ((read_byte_imm() + y) & 0xff)
 
 // Read absolute operand address
+#if CPU_BLOCK_CACHE && !defined(IS_CPU_1541)
+#define read_adr_abs() (tmp_adr = op_operand, pc+=2, tmp_adr)
+#else
 #define read_adr_abs() (tmp_adr = read_word(pc), pc+=2, tmp_adr)
+#endif
 
 // Read absolute x-indexed operand address
 #define read_adr_abs_x() (read_adr_abs() + x)
@@ -102,7 +110,7 @@
 #define pop_byte() ram[(++sp) | 0x0100]
 
 // Push a byte onto the stack
-#define push_byte(byte) (ram[((sp--) & 0xff) | 0x0100] = (byte))
+#define push_byte(byte) (dirty_pages[1] = 1, ram[((sp--) & 0xff) | 0x0100] = (byte))
 
 // Pop processor flags from the stack
 #define pop_flags() \
@@ -188,7 +196,20 @@ handle_int:
 	while ((cycles_left -= last_cycles) >= 0) {
 #endif
 
+#if CPU_BLOCK_CACHE && !defined(IS_CPU_1541)
+		// Fetch pre-decoded instruction, look up new block if the current
+		// one was left or its page was modified
+		if (op == op_end || pc != op_pc || page_gen[pc >> 8] != op_gen) {
+			op = fetch_block(pc, op_end, op_gen);
+		}
+		op_pc = pc + op->length;
+		op_operand = op->operand;
+		pc++;
+
+		switch ((op++)->opcode) {
+#else
 		switch (read_byte_imm()) {
+#endif
 
 
 		// Load group
@@ -848,7 +869,8 @@ handle_int:
 #define Branch(flag) \
 	if (flag) { \
 		uint16_t old_pc = pc; \
-		pc += (int8_t)read_byte(pc) + 1; \
+		tmp = read_byte_imm(); \
+		pc += (int8_t)tmp; \
 		if ((pc ^ old_pc) & 0xff00) { \
 			ENDOP(4); \
 		} else { \
@@ -52,6 +52,11 @@ uint8_t Cartridge8K::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
 	return notLoram ? rom[adr] : ram_byte;
 }
 
+const uint8_t * Cartridge8K::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom : ram;
+}
+
 
 // 16K ROM cartridge (EXROM = 0, GAME = 0)
 Cartridge16K::Cartridge16K() : ROMCartridge(1, 0x4000)
@@ -70,6 +75,16 @@ uint8_t Cartridge16K::ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byt
 	return notHiram ? rom[adr + 0x2000] : ram_byte;
 }
 
+const uint8_t * Cartridge16K::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom : ram;
+}
+
+const uint8_t * Cartridge16K::MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+{
+	return notHiram ? rom + 0x2000 : ram;
+}
+
 
 // Simons' BASIC cartridge (switchable 8K/16K ROM cartridge)
 CartridgeSimonsBasic::CartridgeSimonsBasic() : ROMCartridge(1, 0x4000)
@@ -81,6 +96,7 @@ CartridgeSimonsBasic::CartridgeSimonsBasic() : ROMCartridge(1, 0x4000)
 void CartridgeSimonsBasic::Reset()
 {
 	notGAME = true;
+	++mapGeneration;
 }
 
 uint8_t CartridgeSimonsBasic::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -93,15 +109,27 @@ uint8_t CartridgeSimonsBasic::ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t b
 	return notHiram ? rom[adr + 0x2000] : ram_byte;
 }
 
+const uint8_t * CartridgeSimonsBasic::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom : ram;
+}
+
+const uint8_t * CartridgeSimonsBasic::MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+{
+	return notHiram ? rom + 0x2000 : ram;
+}
+
 uint8_t CartridgeSimonsBasic::ReadIO1(uint16_t adr, uint8_t bus_byte)
 {
 	notGAME = true;		// 8K mode
+	++mapGeneration;
 	return bus_byte;
 }
 
 void CartridgeSimonsBasic::WriteIO1(uint16_t adr, uint8_t byte)
 {
 	notGAME = false;	// 16K mode
+	++mapGeneration;
 }
 
 
@@ -115,6 +143,7 @@ CartridgeOcean::CartridgeOcean(bool not_game) : ROMCartridge(64, 0x2000)
 void CartridgeOcean::Reset()
 {
 	bank = 0;
+	++mapGeneration;
 }
 
 uint8_t CartridgeOcean::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -127,9 +156,20 @@ uint8_t CartridgeOcean::ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_b
 	return notHiram ? rom[adr + bank * bankSize] : ram_byte;
 }
 
+const uint8_t * CartridgeOcean::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
+const uint8_t * CartridgeOcean::MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+{
+	return notHiram ? rom + bank * bankSize : ram;
+}
+
 void CartridgeOcean::WriteIO1(uint16_t adr, uint8_t byte)
 {
 	bank = byte & 0x3f;
+	++mapGeneration;
 }
 
 
@@ -144,6 +184,7 @@ void CartridgeFunPlay::Reset()
 	notEXROM = false;
 
 	bank = 0;
+	++mapGeneration;
 }
 
 uint8_t CartridgeFunPlay::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -151,10 +192,16 @@ uint8_t CartridgeFunPlay::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram
 	return notLoram ? rom[adr + bank * bankSize] : ram_byte;
 }
 
+const uint8_t * CartridgeFunPlay::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
 void CartridgeFunPlay::WriteIO1(uint16_t adr, uint8_t byte)
 {
 	bank = byte & 0x39;
 	notEXROM = (byte & 0xc6) == 0x86;
+	++mapGeneration;
 }
 
 
@@ -171,6 +218,7 @@ void CartridgeSuperGames::Reset()
 	notGAME = false;
 
 	bank = 0;
+	++mapGeneration;
 	disableIO2 = false;
 }
 
@@ -184,11 +232,22 @@ uint8_t CartridgeSuperGames::ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t ba
 	return notHiram ? rom[adr + bank * bankSize + 0x2000] : ram_byte;
 }
 
+const uint8_t * CartridgeSuperGames::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
+const uint8_t * CartridgeSuperGames::MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+{
+	return notHiram ? rom + bank * bankSize + 0x2000 : ram;
+}
+
 void CartridgeSuperGames::WriteIO2(uint16_t adr, uint8_t byte)
 {
 	if (! disableIO2) {
 		bank = byte & 0x03;
 		notEXROM = notGAME = byte & 0x04;
+		++mapGeneration;
 		disableIO2 = byte & 0x08;
 	}
 }
@@ -203,6 +262,7 @@ CartridgeC64GS::CartridgeC64GS() : ROMCartridge(64, 0x2000)
 void CartridgeC64GS::Reset()
 {
 	bank = 0;
+	++mapGeneration;
 }
 
 uint8_t CartridgeC64GS::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -210,15 +270,22 @@ uint8_t CartridgeC64GS::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
 	return notLoram ? rom[adr + bank * bankSize] : ram_byte;
 }
 
+const uint8_t * CartridgeC64GS::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
 uint8_t CartridgeC64GS::ReadIO1(uint16_t adr, uint8_t bus_byte)
 {
 	bank = adr & 0x3f;
+	++mapGeneration;
 	return bus_byte;
 }
 
 void CartridgeC64GS::WriteIO1(uint16_t adr, uint8_t byte)
 {
 	bank = adr & 0x3f;
+	++mapGeneration;
 }
 
 
@@ -231,6 +298,7 @@ CartridgeDinamic::CartridgeDinamic() : ROMCartridge(16, 0x2000)
 void CartridgeDinamic::Reset()
 {
 	bank = 0;
+	++mapGeneration;
 }
 
 uint8_t CartridgeDinamic::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -238,9 +306,15 @@ uint8_t CartridgeDinamic::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram
 	return notLoram ? rom[adr + bank * bankSize] : ram_byte;
 }
 
+const uint8_t * CartridgeDinamic::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
 uint8_t CartridgeDinamic::ReadIO1(uint16_t adr, uint8_t bus_byte)
 {
 	bank = adr & 0x0f;
+	++mapGeneration;
 	return bus_byte;
 }
 
@@ -277,6 +351,17 @@ uint8_t CartridgeZaxxon::ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_
 	return notHiram ? rom[adr + bank * bankSize + 0x2000] : ram_byte;
 }
 
+// ROML reads switch the ROMH bank, so neither area can be read directly
+const uint8_t * CartridgeZaxxon::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? nullptr : ram;
+}
+
+const uint8_t * CartridgeZaxxon::MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+{
+	return notHiram ? nullptr : ram;
+}
+
 
 // Magic Desk / Marina64 cartridge (banked 8K ROM cartridge)
 CartridgeMagicDesk::CartridgeMagicDesk() : ROMCartridge(128, 0x2000)
@@ -289,6 +374,7 @@ void CartridgeMagicDesk::Reset()
 	notEXROM = false;
 
 	bank = 0;
+	++mapGeneration;
 }
 
 uint8_t CartridgeMagicDesk::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -296,10 +382,16 @@ uint8_t CartridgeMagicDesk::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLor
 	return notLoram ? rom[adr + bank * bankSize] : ram_byte;
 }
 
+const uint8_t * CartridgeMagicDesk::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
 void CartridgeMagicDesk::WriteIO1(uint16_t adr, uint8_t byte)
 {
 	bank = byte & 0x7f;
 	notEXROM = byte & 0x80;
+	++mapGeneration;
 }
 
 
@@ -313,6 +405,7 @@ CartridgeComal80::CartridgeComal80() : ROMCartridge(4, 0x4000)
 void CartridgeComal80::Reset()
 {
 	bank = 0;
+	++mapGeneration;
 }
 
 uint8_t CartridgeComal80::ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram)
@@ -325,9 +418,20 @@ uint8_t CartridgeComal80::ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic
 	return notHiram ? rom[adr + bank * bankSize + 0x2000] : ram_byte;
 }
 
+const uint8_t * CartridgeComal80::MapROML(const uint8_t * ram, bool notLoram)
+{
+	return notLoram ? rom + bank * bankSize : ram;
+}
+
+const uint8_t * CartridgeComal80::MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+{
+	return notHiram ? rom + bank * bankSize + 0x2000 : ram;
+}
+
 void CartridgeComal80::WriteIO1(uint16_t adr, uint8_t byte)
 {
 	bank = byte & 0x03;
+	++mapGeneration;
 }
 
 
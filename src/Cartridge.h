@@ -48,6 +48,20 @@ public:
 		return notLoram ? basic_byte : ram_byte;
 	}
 
+	// Get pointer to the 8K visible at $8000..$9fff for direct reads by the
+	// CPU (nullptr = reads must go through ReadROML())
+	virtual const uint8_t * MapROML(const uint8_t * ram, bool notLoram)
+	{
+		return ram;
+	}
+
+	// Get pointer to the 8K visible at $a000..$bfff for direct reads by the
+	// CPU (nullptr = reads must go through ReadROMH())
+	virtual const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram)
+	{
+		return notLoram ? basic : ram;
+	}
+
 	// Default for I/O 1 and 2 is open bus
 	virtual uint8_t ReadIO1(uint16_t adr, uint8_t bus_byte) { return bus_byte; }
 	virtual void WriteIO1(uint16_t adr, uint8_t byte) { }
@@ -59,6 +73,9 @@ public:
 	// Memory mapping control lines
 	bool notEXROM = true;
 	bool notGAME = true;
+
+	// Incremented when the mapping lines or the selected ROM bank change
+	unsigned mapGeneration = 0;
 };
 
 
@@ -92,6 +109,7 @@ public:
 	Cartridge8K();
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
 };
 
 
@@ -102,6 +120,8 @@ public:
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
 	uint8_t ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byte, bool notLoram, bool notHiram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
+	const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram) override;
 };
 
 
@@ -114,6 +134,8 @@ public:
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
 	uint8_t ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byte, bool notLoram, bool notHiram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
+	const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram) override;
 
 	uint8_t ReadIO1(uint16_t adr, uint8_t bus_byte) override;
 	void WriteIO1(uint16_t adr, uint8_t byte) override;
@@ -132,6 +154,8 @@ public:
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
 	uint8_t ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byte, bool notLoram, bool notHiram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
+	const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram) override;
 
 	void WriteIO1(uint16_t adr, uint8_t byte) override;
 
@@ -148,6 +172,7 @@ public:
 	void Reset() override;
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
 
 	void WriteIO1(uint16_t adr, uint8_t byte) override;
 
@@ -165,6 +190,8 @@ public:
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
 	uint8_t ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byte, bool notLoram, bool notHiram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
+	const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram) override;
 
 	void WriteIO2(uint16_t adr, uint8_t byte) override;
 
@@ -182,6 +209,7 @@ public:
 	void Reset() override;
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
 
 	uint8_t ReadIO1(uint16_t adr, uint8_t bus_byte) override;
 	void WriteIO1(uint16_t adr, uint8_t byte) override;
@@ -199,6 +227,7 @@ public:
 	void Reset() override;
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
 
 	uint8_t ReadIO1(uint16_t adr, uint8_t bus_byte) override;
 
@@ -216,6 +245,8 @@ public:
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
 	uint8_t ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byte, bool notLoram, bool notHiram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
+	const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram) override;
 
 protected:
 	unsigned bank = 0;	// Selected ROMH bank
@@ -230,6 +261,7 @@ public:
 	void Reset() override;
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
 
 	void WriteIO1(uint16_t adr, uint8_t byte) override;
 
@@ -247,6 +279,8 @@ public:
 
 	uint8_t ReadROML(uint16_t adr, uint8_t ram_byte, bool notLoram) override;
 	uint8_t ReadROMH(uint16_t adr, uint8_t ram_byte, uint8_t basic_byte, bool notLoram, bool notHiram) override;
+	const uint8_t * MapROML(const uint8_t * ram, bool notLoram) override;
+	const uint8_t * MapROMH(const uint8_t * ram, const uint8_t * basic, bool notLoram, bool notHiram) override;
 
 	void WriteIO1(uint16_t adr, uint8_t byte) override;
 
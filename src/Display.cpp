@@ -31,11 +31,20 @@
 
 #include <filesystem>
 #include <format>
+#include <utility>
 namespace fs = std::filesystem;
 namespace chrono = std::chrono;
 
 #include <stdlib.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SSSE3_CONVERSION 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON_CONVERSION 1
+#endif
+
 
 // Drive LED display states
 enum {
@@ -53,6 +62,10 @@ constexpr uint32_t PULSE_ms = 138;
 // Notification timeout
 constexpr int NOTIFICATION_TIMEOUT_ms = 4000;
 
+// Maximum number of unchanged lines between changed ones that are converted
+// anyway, to reduce the number of texture updates
+constexpr unsigned TEXTURE_UPDATE_GAP = 8;
+
 // Drive LED image
 static const char * led_image[8] = {
     "  XXX   ",
@@ -122,54 +135,141 @@ enum {
 
 
 /*
- *  Display constructor
+ *  Convert line of VIC pixels to native ARGB (portable version)
  */
 
-Display::Display(C64 * c64) : the_c64(c64)
+static void convert_line_generic(uint32_t * out, const uint8_t * in, unsigned num, const uint32_t * palette, const uint8_t [4][16])
 {
-	speedometer_string[0] = '\0';
+	for (unsigned x = 0; x < num; ++x) {
+		out[x] = palette[in[x]];
+	}
+}
 
-	// Create window and renderer
-	uint32_t flags = (ThePrefs.DisplayType == DISPTYPE_SCREEN) ? SDL_WINDOW_FULLSCREEN_DESKTOP : SDL_WINDOW_RESIZABLE;
 
-	if (ThePrefs.TestBench) {
-		flags |= SDL_WINDOW_HIDDEN;	// Hide window in regression test mode
-	}
+#if defined(HAVE_SSSE3_CONVERSION)
+/*
+ *  Convert line of VIC pixels to native ARGB (SSSE3 version)
+ *
+ *  Each byte of the output pixels is looked up with a byte shuffle,
+ *  which only works for the 16 C64 colors. Blocks containing other
+ *  values (UI elements) use the palette instead.
+ */
 
-	int result = SDL_CreateWindowAndRenderer(
-		DISPLAY_X * ThePrefs.ScalingNumerator / ThePrefs.ScalingDenominator,
-		DISPLAY_Y * ThePrefs.ScalingNumerator / ThePrefs.ScalingDenominator,
-		flags, &the_window, &the_renderer
-	);
-	if (result < 0) {
-		error_and_quit(std::format("Couldn't initialize video output ({})\n", SDL_GetError()));
+__attribute__((target("ssse3")))
+static void convert_line_ssse3(uint32_t * out, const uint8_t * in, unsigned num, const uint32_t * palette, const uint8_t lut[4][16])
+{
+	const __m128i lut0 = _mm_load_si128((const __m128i *) lut[0]);
+	const __m128i lut1 = _mm_load_si128((const __m128i *) lut[1]);
+	const __m128i lut2 = _mm_load_si128((const __m128i *) lut[2]);
+	const __m128i lut3 = _mm_load_si128((const __m128i *) lut[3]);
+	const __m128i high_nibble = _mm_set1_epi8((char) 0xf0);
+	const __m128i zero = _mm_setzero_si128();
+
+	unsigned x = 0;
+	for (; x + 16 <= num; x += 16) {
+		__m128i idx = _mm_loadu_si128((const __m128i *) (in + x));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(idx, high_nibble), zero)) != 0xffff) {
+			convert_line_generic(out + x, in + x, 16, palette, lut);
+			continue;
+		}
+
+		__m128i b0 = _mm_shuffle_epi8(lut0, idx);
+		__m128i b1 = _mm_shuffle_epi8(lut1, idx);
+		__m128i b2 = _mm_shuffle_epi8(lut2, idx);
+		__m128i b3 = _mm_shuffle_epi8(lut3, idx);
+
+		__m128i b01_lo = _mm_unpacklo_epi8(b0, b1);
+		__m128i b01_hi = _mm_unpackhi_epi8(b0, b1);
+		__m128i b23_lo = _mm_unpacklo_epi8(b2, b3);
+		__m128i b23_hi = _mm_unpackhi_epi8(b2, b3);
+
+		_mm_storeu_si128((__m128i *) (out + x +  0), _mm_unpacklo_epi16(b01_lo, b23_lo));
+		_mm_storeu_si128((__m128i *) (out + x +  4), _mm_unpackhi_epi16(b01_lo, b23_lo));
+		_mm_storeu_si128((__m128i *) (out + x +  8), _mm_unpacklo_epi16(b01_hi, b23_hi));
+		_mm_storeu_si128((__m128i *) (out + x + 12), _mm_unpackhi_epi16(b01_hi, b23_hi));
 	}
 
-	SDL_SetWindowTitle(the_window, VERSION_STRING);
-	SDL_SetWindowPosition(the_window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
-	SDL_SetWindowMinimumSize(the_window, DISPLAY_X, DISPLAY_Y);
-	SDL_RenderSetLogicalSize(the_renderer, DISPLAY_X, DISPLAY_Y);
+	convert_line_generic(out + x, in + x, num - x, palette, lut);
+}
+#endif
 
-	// Clear screen to black
-	SDL_SetRenderDrawColor(the_renderer, 0, 0, 0, 255);
-	SDL_RenderClear(the_renderer);
 
-	// Create 32-bit display texture
-	the_texture = SDL_CreateTexture(the_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_X, DISPLAY_Y);
-	if (! the_texture) {
-		error_and_quit(std::format("Couldn't create SDL texture ({})\n", SDL_GetError()));
+#if defined(HAVE_NEON_CONVERSION)
+/*
+ *  Convert line of VIC pixels to native ARGB (NEON version, see above)
+ */
+
+static void convert_line_neon(uint32_t * out, const uint8_t * in, unsigned num, const uint32_t * palette, const uint8_t lut[4][16])
+{
+	const uint8x16_t lut0 = vld1q_u8(lut[0]);
+	const uint8x16_t lut1 = vld1q_u8(lut[1]);
+	const uint8x16_t lut2 = vld1q_u8(lut[2]);
+	const uint8x16_t lut3 = vld1q_u8(lut[3]);
+
+	unsigned x = 0;
+	for (; x + 16 <= num; x += 16) {
+		uint8x16_t idx = vld1q_u8(in + x);
+
+		if (vmaxvq_u8(idx) >= 16) {
+			convert_line_generic(out + x, in + x, 16, palette, lut);
+			continue;
+		}
+
+		uint8x16x4_t pixels;
+		pixels.val[0] = vqtbl1q_u8(lut0, idx);
+		pixels.val[1] = vqtbl1q_u8(lut1, idx);
+		pixels.val[2] = vqtbl1q_u8(lut2, idx);
+		pixels.val[3] = vqtbl1q_u8(lut3, idx);
+		vst4q_u8((uint8_t *) (out + x), pixels);
 	}
 
-	// Create 8-bit indexed pixel buffer for VIC to draw into
+	convert_line_generic(out + x, in + x, num - x, palette, lut);
+}
+#endif
+
+
+/*
+ *  Display constructor
+ */
+
+Display::Display(C64 * c64) : the_c64(c64)
+{
+	speedometer_string[0] = '\0';
+
+	// Create 8-bit indexed pixel buffers for VIC to draw into
+	// (the conversion thread uses all three)
 	vic_pixels = new uint8_t[DISPLAY_X * DISPLAY_Y];
+	ready_pixels = new uint8_t[DISPLAY_X * DISPLAY_Y];
+	convert_pixels = new uint8_t[DISPLAY_X * DISPLAY_Y];
 	memset(vic_pixels, 0, DISPLAY_X * DISPLAY_Y);
+	memset(ready_pixels, 0, DISPLAY_X * DISPLAY_Y);
+	memset(convert_pixels, 0, DISPLAY_X * DISPLAY_Y);
+
+	// Copy of the last converted frame, for finding changed lines, and
+	// buffers for the converted frame
+	texture_pixels = new uint8_t[DISPLAY_X * DISPLAY_Y];
+	argb_pixels = new uint32_t[DISPLAY_X * DISPLAY_Y];
+	upload_pixels = new uint32_t[DISPLAY_X * DISPLAY_Y];
+	memset(line_changed, 0, sizeof(line_changed));
+	memset(upload_pending, 0, sizeof(upload_pending));
 
 	// Init color palette for pixel buffer
-	init_colors(ThePrefs.Palette);
+	init_colors(the_c64->GetPrefs().Palette);
+
+	// Select pixel conversion function
+#if defined(HAVE_SSSE3_CONVERSION)
+	convert_line = __builtin_cpu_supports("ssse3") ? convert_line_ssse3 : convert_line_generic;
+#elif defined(HAVE_NEON_CONVERSION)
+	convert_line = convert_line_neon;
+#else
+	convert_line = convert_line_generic;
+#endif
 
-	// Hide mouse pointer in fullscreen mode
-	if (ThePrefs.DisplayType == DISPTYPE_SCREEN) {
-		SDL_ShowCursor(SDL_DISABLE);
+	// Headless mode only needs the pixel buffer
+	headless = the_c64->GetPrefs().Headless;
+	if (! headless) {
+		open_window();
 	}
 
 	// LEDs off
@@ -200,13 +300,15 @@ Display::Display(C64 * c64) : the_c64(c64)
 	}
 
 	// Start timer for LED error flashing
-	pulse_timer = SDL_AddTimer(PULSE_ms, pulse_handler_static, this);
-	if (pulse_timer == 0) {
-		error_and_quit(std::format("Couldn't create SDL pulse timer ({})\n", SDL_GetError()));
+	if (! headless) {
+		pulse_timer = SDL_AddTimer(PULSE_ms, pulse_handler_static, this);
+		if (pulse_timer == 0) {
+			error_and_quit(std::format("Couldn't create SDL pulse timer ({})\n", SDL_GetError()));
+		}
 	}
 
 	// Get controller button mapping
-	button_mapping = ThePrefs.SelectedButtonMapping();
+	button_mapping = the_c64->GetPrefs().SelectedButtonMapping();
 
 	// Clear notifications
 	for (unsigned i = 0; i < NUM_NOTIFICATIONS; ++i) {
@@ -215,12 +317,103 @@ Display::Display(C64 * c64) : the_c64(c64)
 	next_note = 0;
 
 	// Show greeting
-	if (! ThePrefs.AutoStart) {
+	if (! the_c64->GetPrefs().AutoStart) {
 		ShowNotification("Welcome to Frodo, press F10 for settings");
 	}
 }
 
 
+/*
+ *  Open window and create renderer and texture
+ */
+
+void Display::open_window()
+{
+	// Create window
+	uint32_t flags = (the_c64->GetPrefs().DisplayType == DISPTYPE_SCREEN) ? SDL_WINDOW_FULLSCREEN_DESKTOP : SDL_WINDOW_RESIZABLE;
+
+	if (the_c64->GetPrefs().TestBench) {
+		flags |= SDL_WINDOW_HIDDEN;	// Hide window in regression test mode
+	}
+
+	the_window = SDL_CreateWindow(VERSION_STRING,
+		SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+		DISPLAY_X * the_c64->GetPrefs().ScalingNumerator / the_c64->GetPrefs().ScalingDenominator,
+		DISPLAY_Y * the_c64->GetPrefs().ScalingNumerator / the_c64->GetPrefs().ScalingDenominator,
+		flags
+	);
+	if (! the_window) {
+		error_and_quit(std::format("Couldn't initialize video output ({})\n", SDL_GetError()));
+	}
+
+	SDL_SetWindowMinimumSize(the_window, DISPLAY_X, DISPLAY_Y);
+
+	// Create renderer (the SDL render functions must only be called from
+	// the thread which owns the window)
+	std::string error;
+	if (! open_renderer(error)) {
+		error_and_quit(error);
+	}
+
+	// Convert frames in a separate thread if desired. The screenshot of
+	// regression tests needs the final frame in the VIC buffer, so they
+	// always convert synchronously.
+	threaded_conversion = the_c64->GetPrefs().RenderThread && !the_c64->GetPrefs().TestBench;
+	if (threaded_conversion) {
+		convert_thread = std::thread(&Display::convert_thread_func, this);
+	}
+
+	// Hide mouse pointer in fullscreen mode
+	if (the_c64->GetPrefs().DisplayType == DISPTYPE_SCREEN) {
+		SDL_ShowCursor(SDL_DISABLE);
+	}
+}
+
+
+/*
+ *  Create renderer and texture, returns false on error
+ */
+
+bool Display::open_renderer(std::string & ret_error_msg)
+{
+	the_renderer = SDL_CreateRenderer(the_window, -1, 0);
+	if (! the_renderer) {
+		ret_error_msg = std::format("Couldn't initialize video output ({})\n", SDL_GetError());
+		return false;
+	}
+
+	SDL_RenderSetLogicalSize(the_renderer, DISPLAY_X, DISPLAY_Y);
+
+	// Clear screen to black
+	SDL_SetRenderDrawColor(the_renderer, 0, 0, 0, 255);
+	SDL_RenderClear(the_renderer);
+
+	// Create 32-bit display texture
+	the_texture = SDL_CreateTexture(the_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, DISPLAY_X, DISPLAY_Y);
+	if (! the_texture) {
+		ret_error_msg = std::format("Couldn't create SDL texture ({})\n", SDL_GetError());
+		return false;
+	}
+	texture_valid = false;
+
+	return true;
+}
+
+
+/*
+ *  Destroy renderer and texture
+ */
+
+void Display::close_renderer()
+{
+	if (the_renderer) {
+		SDL_DestroyRenderer(the_renderer);	// Also destroys texture
+		the_renderer = nullptr;
+		the_texture = nullptr;
+	}
+}
+
+
 /*
  *  Display destructor
  */
@@ -231,11 +424,23 @@ Display::~Display()
 		SDL_RemoveTimer(pulse_timer);
 	}
 
+	if (convert_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(convert_mutex);
+			convert_quit = true;
+		}
+		convert_cond.notify_one();
+		convert_thread.join();
+	}
+	close_renderer();
+
 	delete[] vic_pixels;
+	delete[] ready_pixels;
+	delete[] convert_pixels;
+	delete[] texture_pixels;
+	delete[] argb_pixels;
+	delete[] upload_pixels;
 
-	if (the_renderer) {
-		SDL_DestroyRenderer(the_renderer);
-	}
 	if (the_window) {
 		SDL_DestroyWindow(the_window);
 	}
@@ -260,7 +465,7 @@ void Display::error_and_quit(const std::string & msg) const
 
 void Display::Pause()
 {
-	if (ThePrefs.DisplayType == DISPTYPE_SCREEN) {
+	if (! headless && the_c64->GetPrefs().DisplayType == DISPTYPE_SCREEN) {
 		toggle_fullscreen(false);
 	}
 }
@@ -272,7 +477,7 @@ void Display::Pause()
 
 void Display::Resume()
 {
-	if (ThePrefs.DisplayType == DISPTYPE_SCREEN) {
+	if (! headless && the_c64->GetPrefs().DisplayType == DISPTYPE_SCREEN) {
 		toggle_fullscreen(true);
 	}
 }
@@ -284,7 +489,8 @@ void Display::Resume()
 
 void Display::NewPrefs(const Prefs *prefs)
 {
-	if (prefs->Palette != ThePrefs.Palette) {
+	if (prefs->Palette != the_c64->GetPrefs().Palette) {
+		std::lock_guard<std::mutex> lock(convert_mutex);
 		init_colors(prefs->Palette);
 	}
 
@@ -362,17 +568,15 @@ void Display::pulse_handler()
 
 void Display::SetSpeedometer(int speed)
 {
-	static int delay = 0;
-
-	if (delay >= 20) {
-		delay = 0;
+	if (speedometer_delay >= 20) {
+		speedometer_delay = 0;
 		if (speed == 100) {
 			speedometer_string[0] = '\0';  // hide if speed = 100%
 		} else {
 			snprintf(speedometer_string, sizeof(speedometer_string), "%d%%", speed);
 		}
 	} else {
-		delay++;
+		speedometer_delay++;
 	}
 }
 
@@ -402,7 +606,7 @@ void Display::draw_overlays()
 		i = (i + 1) % NUM_NOTIFICATIONS;
 	} while (i != next_note);
 
-	if (ThePrefs.ShowLEDs) {
+	if (the_c64->GetPrefs().ShowLEDs) {
 
 		// Draw speedometer
 		draw_string(5, DISPLAY_Y - 8, speedometer_string, shadow_gray);
@@ -503,37 +707,183 @@ void Display::draw_overlays()
 
 void Display::Update()
 {
+	if (headless)
+		return;
+
 	// Draw user interface elements (but keep regression test screenshot clean)
-	if (ThePrefs.TestScreenshotPath.empty()) {
+	if (the_c64->GetPrefs().TestScreenshotPath.empty()) {
 		draw_overlays();
 	}
 
-	// Convert 8-bit pixel buffer to 32-bit texture
-	uint32_t * texture_buffer;
-	int texture_pitch;
+	bool changed;
+	if (threaded_conversion) {
+
+		// Hand the completed frame over to the conversion thread (replacing
+		// a previous one it hasn't picked up yet), let the VIC draw the
+		// next frame into the spare buffer, and upload the lines converted
+		// since the last call
+		{
+			std::lock_guard<std::mutex> lock(convert_mutex);
+			std::swap(vic_pixels, ready_pixels);
+			frame_ready = true;
+
+			changed = upload_lines(upload_pixels, upload_pending);
+		}
+		convert_cond.notify_one();
+
+	} else {
+		fetch_palette();
+		convert_frame(vic_pixels);
+		changed = upload_lines(argb_pixels, line_changed);
+	}
+
+	// Unchanged frames are not presented again
+	if (changed || redraw_needed) {
+		redraw_needed = false;
+		present_frame();
+	}
+}
+
 
-	SDL_LockTexture(the_texture, nullptr, (void **) &texture_buffer, &texture_pitch);
+/*
+ *  Convert changed lines of 8-bit pixel buffer to 32-bit ARGB and flag
+ *  them in line_changed[], returns false if the frame is identical to the
+ *  last converted one
+ */
 
-	uint8_t  * inPixel  = vic_pixels;
-	uint32_t * outPixel = texture_buffer;
+bool Display::convert_frame(const uint8_t * pixels)
+{
+	bool changed = false;
 
 	for (unsigned y = 0; y < DISPLAY_Y; ++y) {
-		for (unsigned x = 0; x < DISPLAY_X; ++x) {
-			outPixel[x] = palette[inPixel[x]];
+		const uint8_t * in = pixels + y * DISPLAY_X;
+		uint8_t * copy = texture_pixels + y * DISPLAY_X;
+
+		line_changed[y] = !texture_valid || memcmp(in, copy, DISPLAY_X) != 0;
+		if (line_changed[y]) {
+			convert_line(argb_pixels + y * DISPLAY_X, in, DISPLAY_X, convert_palette, convert_palette_lut);
+			memcpy(copy, in, DISPLAY_X);
+			changed = true;
+		}
+	}
+
+	texture_valid = true;
+	return changed;
+}
+
+
+/*
+ *  Take over a changed palette for the frame conversion (convert_mutex
+ *  must be held when converting in a separate thread)
+ */
+
+void Display::fetch_palette()
+{
+	if (palette_changed) {
+		memcpy(convert_palette, palette, sizeof(convert_palette));
+		memcpy(convert_palette_lut, palette_lut, sizeof(convert_palette_lut));
+		palette_changed = false;
+		texture_valid = false;
+	}
+}
+
+
+/*
+ *  Copy lines flagged in pending[] from ARGB buffer to texture and clear
+ *  the flags, returns false if there were no pending lines. Unflagged lines
+ *  of the buffer must match the texture, as they may be copied as well to
+ *  reduce the number of texture updates.
+ */
+
+bool Display::upload_lines(const uint32_t * argb, bool * pending)
+{
+	bool uploaded = false;
+	unsigned y = 0;
+
+	while (y < DISPLAY_Y) {
+		if (! pending[y]) {
+			++y;
+			continue;
+		}
+
+		// Extend span over small gaps between pending lines
+		unsigned first = y, last = y + 1;
+		for (y = last; y < DISPLAY_Y && y - last <= TEXTURE_UPDATE_GAP; ++y) {
+			if (pending[y]) {
+				last = y + 1;
+			}
 		}
-		inPixel  += DISPLAY_X;
-		outPixel += texture_pitch / sizeof(uint32_t);
+
+		uint32_t * texture_buffer;
+		int texture_pitch;
+
+		SDL_Rect rect = {0, int(first), DISPLAY_X, int(last - first)};
+		SDL_LockTexture(the_texture, &rect, (void **) &texture_buffer, &texture_pitch);
+
+		for (unsigned i = first; i < last; ++i) {
+			memcpy(texture_buffer, argb + i * DISPLAY_X, DISPLAY_X * sizeof(uint32_t));
+			texture_buffer += texture_pitch / sizeof(uint32_t);
+			pending[i] = false;
+		}
+
+		SDL_UnlockTexture(the_texture);
+
+		y = last;
+		uploaded = true;
 	}
 
-	SDL_UnlockTexture(the_texture);
+	return uploaded;
+}
+
 
-	// Update display
+/*
+ *  Show texture in window
+ */
+
+void Display::present_frame()
+{
 	SDL_RenderClear(the_renderer);
 	SDL_RenderCopy(the_renderer, the_texture, nullptr, nullptr);
 	SDL_RenderPresent(the_renderer);
 }
 
 
+/*
+ *  Conversion thread: Convert frames handed over by Update() to ARGB, and
+ *  pass the changed lines back for uploading to the texture, until the
+ *  display is destroyed
+ */
+
+void Display::convert_thread_func()
+{
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(convert_mutex);
+			convert_cond.wait(lock, [this]{ return frame_ready || convert_quit; });
+			if (convert_quit)
+				break;
+
+			std::swap(convert_pixels, ready_pixels);
+			frame_ready = false;
+
+			// The palette may be changed by the emulation thread
+			fetch_palette();
+		}
+
+		// Conversion happens here, without blocking emulation
+		if (convert_frame(convert_pixels)) {
+			std::lock_guard<std::mutex> lock(convert_mutex);
+			for (unsigned y = 0; y < DISPLAY_Y; ++y) {
+				if (line_changed[y]) {
+					memcpy(upload_pixels + y * DISPLAY_X, argb_pixels + y * DISPLAY_X, DISPLAY_X * sizeof(uint32_t));
+					upload_pending[y] = true;
+				}
+			}
+		}
+	}
+}
+
+
 /*
  *  Draw string into pixel buffer using the C64 lower-case ROM font
  */
@@ -789,11 +1139,14 @@ void Display::PollKeyboard(uint8_t *key_matrix, uint8_t *rev_matrix, uint8_t *jo
 						break;
 
 					case SDL_SCANCODE_KP_ENTER:	// Enter on keypad: Toggle fullscreen
-						if (ThePrefs.DisplayType == DISPTYPE_WINDOW) {
-							ThePrefs.DisplayType = DISPTYPE_SCREEN;
+						if (headless) {
+							break;
+						}
+						if (the_c64->GetPrefs().DisplayType == DISPTYPE_WINDOW) {
+							the_c64->SetDisplayType(DISPTYPE_SCREEN);
 							toggle_fullscreen(true);
 						} else {
-							ThePrefs.DisplayType = DISPTYPE_WINDOW;
+							the_c64->SetDisplayType(DISPTYPE_WINDOW);
 							toggle_fullscreen(false);
 						}
 						break;
@@ -861,7 +1214,7 @@ void Display::PollKeyboard(uint8_t *key_matrix, uint8_t *rev_matrix, uint8_t *jo
 
 					// Mount disk image file
 					if (type == FILE_DISK_IMAGE) {
-						the_c64->MountDrive8(ThePrefs.Emul1541Proc, filename);
+						the_c64->MountDrive8(the_c64->GetPrefs().Emul1541Proc, filename);
 						ShowNotification("Disk image file mounted in drive 8");
 					} else if (type == FILE_GCR_IMAGE) {
 						the_c64->MountDrive8(true, filename);
@@ -926,17 +1279,22 @@ void Display::PollKeyboard(uint8_t *key_matrix, uint8_t *rev_matrix, uint8_t *jo
 
 			// Controller attached/removed
 			case SDL_CONTROLLERDEVICEADDED:
-				if (! ThePrefs.TestBench) {
+				if (! the_c64->GetPrefs().TestBench) {
 					the_c64->JoystickAdded(event.cdevice.which);
 				}
 				break;
 
 			case SDL_CONTROLLERDEVICEREMOVED:
-				if (! ThePrefs.TestBench) {
+				if (! the_c64->GetPrefs().TestBench) {
 					the_c64->JoystickRemoved(event.cdevice.which);
 				}
 				break;
 
+			// Window needs to be redrawn
+			case SDL_WINDOWEVENT:
+				redraw_needed = true;
+				break;
+
 			// Quit Frodo
 			case SDL_QUIT:
 				the_c64->RequestQuit();
@@ -988,4 +1346,15 @@ void Display::init_colors(int palette_prefs)
 	palette[red]         = (0xf0 << 16) | (0x00 << 8) | (0x00 << 0);
 	palette[dark_red]    = (0x30 << 16) | (0x00 << 8) | (0x00 << 0);
 	palette[green]       = (0x00 << 16) | (0xc0 << 8) | (0x00 << 0);
+
+	// Texture must be converted again
+	palette_changed = true;
+
+	// Split C64 colors into bytes (in memory order) for SIMD lookup
+	for (unsigned i = 0; i < 16; ++i) {
+		const uint8_t * p = reinterpret_cast<const uint8_t *>(palette + i);
+		for (unsigned j = 0; j < 4; ++j) {
+			palette_lut[j][i] = p[j];
+		}
+	}
 }
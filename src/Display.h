@@ -26,7 +26,10 @@
 #include <SDL.h>
 
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 
 
 // Display dimensions
@@ -40,6 +43,9 @@ constexpr unsigned NOTIFICATION_LENGTH = 46;
 
 class C64;
 
+// Function for converting a line of VIC pixels to native ARGB
+using ConvertLineFunc = void (*)(uint32_t * out, const uint8_t * in, unsigned num, const uint32_t * palette, const uint8_t lut[4][16]);
+
 
 // Class for C64 graphics display
 class Display {
@@ -65,6 +71,15 @@ public:
 	bool NumLock();
 
 private:
+	void open_window();
+	bool open_renderer(std::string & ret_error_msg);
+	void close_renderer();
+
+	bool convert_frame(const uint8_t * pixels);
+	void fetch_palette();
+	bool upload_lines(const uint32_t * argb, bool * pending);
+	void present_frame();
+	void convert_thread_func();
 	void init_colors(int palette_prefs);
 
 	void error_and_quit(const std::string & msg) const;
@@ -79,6 +94,8 @@ private:
 
 	C64 * the_c64;						// Pointer to C64 object
 
+	bool headless;						// Flag: No video output, only VIC pixel buffer
+
 	int led_state[4];
 	SDL_TimerID pulse_timer = 0;		// Timer for LED error flashing
 
@@ -89,9 +106,31 @@ private:
 	SDL_Texture * the_texture = nullptr;
 
 	uint8_t * vic_pixels = nullptr;		// Buffer for VIC to draw into
+	uint8_t * ready_pixels = nullptr;	// Completed frame waiting for conversion thread (if frame_ready), or spare buffer
+	uint8_t * convert_pixels = nullptr;	// Frame being converted by conversion thread
+	uint8_t * texture_pixels = nullptr;	// Copy of the last converted frame
+	bool texture_valid = false;			// Flag: texture_pixels matches contents of argb_pixels
+	uint32_t * argb_pixels = nullptr;	// Last converted frame in native ARGB
+	bool line_changed[DISPLAY_Y];		// Flags: Line of argb_pixels was changed by last conversion
+	uint32_t * upload_pixels = nullptr;	// Frame converted by conversion thread, for uploading to the_texture
+	bool upload_pending[DISPLAY_Y];		// Flags: Line of upload_pixels is not in the_texture yet
 	uint32_t palette[256];				// Mapping of VIC color values to native ARGB
+	alignas(16) uint8_t palette_lut[4][16];	// Bytes of first 16 palette entries, for SIMD conversion
+	bool palette_changed = false;		// Flag: palette was changed, texture must be converted again
+	uint32_t convert_palette[256];		// Copy of palette used by the frame conversion
+	alignas(16) uint8_t convert_palette_lut[4][16];	// Copy of palette_lut used by the frame conversion
+	ConvertLineFunc convert_line;		// Pixel conversion function selected for host CPU
+
+	bool threaded_conversion = false;	// Flag: Frames are converted by conversion thread
+	std::thread convert_thread;			// Conversion thread
+	std::mutex convert_mutex;			// Protects frame handover, palette, upload_pixels, and convert_quit
+	std::condition_variable convert_cond;	// Signals new frame or quit request to conversion thread
+	bool frame_ready = false;			// Flag: ready_pixels holds a new frame
+	bool redraw_needed = false;			// Flag: Present next frame even if unchanged (window was exposed or resized)
+	bool convert_quit = false;			// Flag: Conversion thread shall quit
 
 	char speedometer_string[16];		// Speedometer text (screen code)
+	int speedometer_delay = 0;			// Frames since last speedometer text update
 
 	struct Notification {
 		char text[NOTIFICATION_LENGTH];	// Notification text in C64 screen code
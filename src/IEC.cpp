@@ -49,7 +49,6 @@
 #include "1541t64.h"
 #include "1541gcr.h"
 #include "C64.h"
-#include "main.h"
 #include "Prefs.h"
 #include "Tape.h"
 #include "Version.h"
@@ -112,9 +111,9 @@ IEC::IEC(C64 * c64) : the_c64(c64)
 		drive[i] = nullptr;	// Important because UpdateLEDs is called from the drive constructors (via set_error)
 	}
 
-	if (!ThePrefs.Emul1541Proc) {
+	if (!the_c64->GetPrefs().Emul1541Proc) {
 		for (unsigned i = 0; i < 4; ++i) {
-			drive[i] = create_drive(i + 8, ThePrefs.DrivePath[i]);
+			drive[i] = create_drive(i + 8, the_c64->GetPrefs().DrivePath[i]);
 		}
 	}
 
@@ -153,7 +152,7 @@ void IEC::Reset()
 
 /*
  *  Preferences have changed, prefs points to new preferences,
- *  ThePrefs still holds the previous ones. Check if drive settings
+ *  the C64 still holds the previous ones. Check if drive settings
  *  have changed.
  */
 
@@ -161,7 +160,7 @@ void IEC::NewPrefs(const Prefs *prefs)
 {
 	// Delete and recreate all changed drives
 	for (unsigned i = 0; i < 4; ++i) {
-		if (ThePrefs.DrivePath[i] != prefs->DrivePath[i] || ThePrefs.Emul1541Proc != prefs->Emul1541Proc) {
+		if (the_c64->GetPrefs().DrivePath[i] != prefs->DrivePath[i] || the_c64->GetPrefs().Emul1541Proc != prefs->Emul1541Proc) {
 			delete drive[i];
 			drive[i] = nullptr;	// Important because UpdateLEDs is called from drive constructors (via set_error())
 			if (!prefs->Emul1541Proc) {
@@ -170,7 +169,7 @@ void IEC::NewPrefs(const Prefs *prefs)
 		}
 	}
 
-	if (ThePrefs.Emul1541Proc != prefs->Emul1541Proc) {
+	if (the_c64->GetPrefs().Emul1541Proc != prefs->Emul1541Proc) {
 		UpdateLEDs();
 	}
 }
@@ -542,7 +541,7 @@ void Drive::parse_file_name(const uint8_t *src, int src_len, uint8_t *dest, int
 	while (*p != ',' && src_len-- > 0) {
 		if (convert_charset) {
 			char c = petscii2ascii(*p++);
-			if (ThePrefs.MapSlash) {
+			if (the_iec->GetC64()->GetPrefs().MapSlash) {
 				if (c == '/') {
 					c = '\\';
 				} else if (c == '\\') {
@@ -943,7 +942,7 @@ void Drive::unsupp_cmd()
 	}
 
 	std::string s = std::format("Unsupported drive command '{}'", command);
-	TheC64->ShowNotification(s);
+	the_iec->GetC64()->ShowNotification(s);
 }
 
 
@@ -148,6 +148,8 @@ public:
 	void NewPrefs(const Prefs *prefs);
 	void UpdateLEDs();
 
+	C64 * GetC64() const { return the_c64; }
+
 	uint8_t Out(uint8_t byte, bool eoi);
 	uint8_t OutATN(uint8_t byte);
 	uint8_t OutSec(uint8_t byte);
@@ -170,7 +172,7 @@ private:
 	uint8_t data_out(uint8_t byte, bool eoi);
 	uint8_t data_in(uint8_t &byte);
 
-	C64 * the_c64;	// Pointer to C64 object (for drive LEDs)
+	C64 * the_c64;	// Pointer to C64 object (for drive LEDs and preferences)
 
 	uint8_t name_buf[NAMEBUF_LENGTH];	// Buffer for file names and command strings
 	uint8_t *name_ptr;		// Pointer for reception of file name
@@ -236,7 +238,6 @@ protected:
 	uint8_t cmd_buf[64];	// Buffer for incoming command strings
 	int cmd_len;			// Length of received command
 
-private:
 	IEC *the_iec;			// Pointer to IEC object
 };
 
@@ -47,6 +47,7 @@ Prefs::Prefs()
 	FloppyCycles = 64;
 	ScalingNumerator = 4;
 	ScalingDenominator = 1;
+	RewindLength = 30;
 	TestMaxFrames = 0;
 
 	SIDType = SIDTYPE_DIGITAL_6581;
@@ -61,13 +62,17 @@ Prefs::Prefs()
 	TwinStick = false;
 	TapeRumble = false;
 	LimitSpeed = true;
+	AutoWarp = false;
 	FastReset = true;
+	FastTapeLoad = false;
 	CIAIRQHack = false;
 	MapSlash = true;
 	Emul1541Proc = true;
 	ShowLEDs = true;
+	RenderThread = true;
 	AutoStart = false;
 	TestBench = false;
+	Headless = false;
 }
 
 
@@ -85,6 +90,10 @@ void Prefs::Check()
 		ScalingDenominator = 1;
 	}
 
+	if (RewindLength < 0) {
+		RewindLength = 0;
+	}
+
 	if (TestMaxFrames < 0) {
 		TestMaxFrames = 0;
 	}
@@ -246,6 +255,9 @@ void Prefs::ParseItem(std::string item)
 	} else if (keyword == "TestScreenshot") {
 		TestScreenshotPath = value;
 
+	} else if (keyword == "AudioOutput") {
+		AudioOutputPath = value;
+
 	} else if (keyword == "SIDType") {
 		if (value == "DIGITAL") {
 			SIDType = SIDTYPE_DIGITAL_6581;
@@ -282,6 +294,8 @@ void Prefs::ParseItem(std::string item)
 		ScalingNumerator = atoi(value.c_str());
 	} else if (keyword == "ScalingDenominator") {
 		ScalingDenominator = atoi(value.c_str());
+	} else if (keyword == "RewindLength") {
+		RewindLength = atoi(value.c_str());
 	} else if (keyword == "TestMaxFrames") {
 		TestMaxFrames = atoi(value.c_str());
 
@@ -295,8 +309,12 @@ void Prefs::ParseItem(std::string item)
 		TapeRumble = (value == "true");
 	} else if (keyword == "LimitSpeed") {
 		LimitSpeed = (value == "true");
+	} else if (keyword == "AutoWarp") {
+		AutoWarp = (value == "true");
 	} else if (keyword == "FastReset") {
 		FastReset = (value == "true");
+	} else if (keyword == "FastTapeLoad") {
+		FastTapeLoad = (value == "true");
 	} else if (keyword == "CIAIRQHack") {
 		CIAIRQHack = (value == "true");
 	} else if (keyword == "MapSlash") {
@@ -305,10 +323,14 @@ void Prefs::ParseItem(std::string item)
 		Emul1541Proc = (value == "true");
 	} else if (keyword == "ShowLEDs") {
 		ShowLEDs = (value == "true");
+	} else if (keyword == "RenderThread") {
+		RenderThread = (value == "true");
 	} else if (keyword == "AutoStart") {
 		AutoStart = (value == "true");
 	} else if (keyword == "TestBench") {
 		TestBench = (value == "true");
+	} else if (keyword == "Headless") {
+		Headless = (value == "true");
 
 	} else {
 		fprintf(stderr, "WARNING: Ignoring unknown settings item '%s'\n", keyword.c_str());
@@ -371,6 +393,7 @@ bool Prefs::Save(fs::path prefs_path)
 	file << "Joystick2Port = " << Joystick2Port << std::endl;
 	file << "ScalingNumerator = " << ScalingNumerator << std::endl;
 	file << "ScalingDenominator = " << ScalingDenominator << std::endl;
+	file << "RewindLength = " << RewindLength << std::endl;
 
 	for (const auto & [name, mapping] : ButtonMapDefs) {
 		file << "ButtonMapDef = " << name;
@@ -394,11 +417,14 @@ bool Prefs::Save(fs::path prefs_path)
 	file << "TwinStick = " << TwinStick << std::endl;
 	file << "TapeRumble = " << TapeRumble << std::endl;
 	file << "LimitSpeed = " << LimitSpeed << std::endl;
+	file << "AutoWarp = " << AutoWarp << std::endl;
 	file << "FastReset = " << FastReset << std::endl;
+	file << "FastTapeLoad = " << FastTapeLoad << std::endl;
 	file << "CIAIRQHack = " << CIAIRQHack << std::endl;
 	file << "MapSlash = " << MapSlash << std::endl;
 	file << "Emul1541Proc = " << Emul1541Proc << std::endl;
 	file << "ShowLEDs = " << ShowLEDs << std::endl;
+	file << "RenderThread = " << RenderThread << std::endl;
 
 	return true;
 }
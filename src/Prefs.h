@@ -103,6 +103,7 @@ public:
 	int Joystick2Port;			// Port that joystick 2 is connected to
 	int ScalingNumerator;		// Window scaling numerator
 	int ScalingDenominator;		// Window scaling denominator
+	int RewindLength;			// Length of rewind buffer in seconds (0 = rewinding disabled)
 	int TestMaxFrames;			// Maximum number of frames to run in test-bench mode (not saved to preferences file)
 
 	bool SpriteCollisions;		// Sprite collision detection is on
@@ -110,13 +111,17 @@ public:
 	bool TwinStick;				// Twin-stick control
 	bool TapeRumble;			// Tape motor controller rumble
 	bool LimitSpeed;			// Limit speed to 100%
+	bool AutoWarp;				// Run at full speed during disk and tape access
 	bool FastReset;				// Skip RAM test on reset
+	bool FastTapeLoad;			// Load standard Kernal tape blocks instantly
 	bool CIAIRQHack;			// Write to CIA ICR clears IRQ
 	bool MapSlash;				// Map '/' in C64 filenames
 	bool Emul1541Proc;			// Enable processor-level 1541 emulation
 	bool ShowLEDs;				// Show status bar
+	bool RenderThread;			// Convert display frames in separate thread
 	bool AutoStart;				// Auto-start from drive 8 after reset (not saved to preferences file)
 	bool TestBench;				// Enable features for automatic regression tests (not saved to preferences file)
+	bool Headless;				// Run without video and audio output (not saved to preferences file)
 
 	std::string LoadProgram;	// BASIC program file to load in conjunction with AutoStart (not saved to preferences file)
 
@@ -129,6 +134,7 @@ public:
 	std::string CartridgePath;	// Path for cartridge image file
 
 	std::string TestScreenshotPath;	// Path for screenshot to be saved on exit in test-bench mode (not saved to preferences file)
+	std::string AudioOutputPath;	// Path of WAV or raw file to render sound to instead of audio device (not saved to preferences file)
 };
 
 
@@ -22,12 +22,14 @@
 
 #include "SID.h"
 #include "C64.h"
-#include "main.h"
 #include "VIC.h"
 #include "Prefs.h"
 
 #include <SDL_audio.h>
+#include <SDL_endian.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <complex>
 #include <numbers>
@@ -63,15 +65,21 @@ enum {
  *  Constructor
  */
 
-MOS6581::MOS6581()
+MOS6581::MOS6581(C64 * c64) : the_c64(c64)
 {
 	the_renderer = nullptr;
 	for (unsigned i = 0; i < 32; ++i) {
 		regs[i] = 0;
 	}
 
+	// Open offline sound output file
+	const std::string & output_path = the_c64->GetPrefs().AudioOutputPath;
+	if (! output_path.empty()) {
+		open_output_file(output_path.c_str());
+	}
+
 	// Open the renderer
-	open_close_renderer(SIDTYPE_NONE, ThePrefs.SIDType);
+	open_close_renderer(SIDTYPE_NONE, the_c64->GetPrefs().SIDType);
 }
 
 
@@ -82,7 +90,9 @@ MOS6581::MOS6581()
 MOS6581::~MOS6581()
 {
 	// Close the renderer
-	open_close_renderer(ThePrefs.SIDType, SIDTYPE_NONE);
+	open_close_renderer(the_c64->GetPrefs().SIDType, SIDTYPE_NONE);
+
+	close_output_file();
 }
 
 
@@ -100,7 +110,7 @@ void MOS6581::Reset()
 	last_sid_seq = 0;
 
 	// Set waveform tables
-	set_wave_tables(ThePrefs.SIDType);
+	set_wave_tables(the_c64->GetPrefs().SIDType);
 
 	fake_v3_update_cycle = 0;
 	fake_v3_count = 0x555555;
@@ -122,7 +132,7 @@ void MOS6581::NewPrefs(const Prefs *prefs)
 {
 	set_wave_tables(prefs->SIDType);
 
-	open_close_renderer(ThePrefs.SIDType, prefs->SIDType);
+	open_close_renderer(the_c64->GetPrefs().SIDType, prefs->SIDType);
 	if (the_renderer != nullptr) {
 		the_renderer->NewPrefs(prefs);
 	}
@@ -190,12 +200,12 @@ uint8_t MOS6581::v3_random()
 
 void MOS6581::update_osc3()
 {
-	uint32_t now = TheC64->CycleCounter();
+	uint32_t now = the_c64->CycleCounter();
 
 	uint8_t v3_ctrl = regs[0x12];	// Voice 3 control register
 	if (v3_ctrl & 8) {				// Test bit
 		fake_v3_count = 0;
-		if (ThePrefs.SIDType == SIDTYPE_DIGITAL_8580) {
+		if (the_c64->GetPrefs().SIDType == SIDTYPE_DIGITAL_8580) {
 			--now;	// For SID type detection
 		}
 	} else {
@@ -243,7 +253,7 @@ uint8_t MOS6581::read_osc3()
 			}
 		case WAVE_TRISAW: {
 			uint8_t r =TriSawTable[count >> 12] >> 8;
-			if (ThePrefs.SIDType == SIDTYPE_DIGITAL_6581) {
+			if (the_c64->GetPrefs().SIDType == SIDTYPE_DIGITAL_6581) {
 				fake_v3_count &= 0x7fffff | ((uint32_t) r << 16);	// Counter MSB may get cleared
 			}
 			return r;
@@ -264,7 +274,7 @@ uint8_t MOS6581::read_osc3()
 			} else {
 				r = 0x00;
 			}
-			if (ThePrefs.SIDType == SIDTYPE_DIGITAL_6581) {
+			if (the_c64->GetPrefs().SIDType == SIDTYPE_DIGITAL_6581) {
 				fake_v3_count &= 0x7fffff | ((uint32_t) r << 16);	// Counter MSB may get cleared
 			}
 			return r;
@@ -277,7 +287,7 @@ uint8_t MOS6581::read_osc3()
 			} else {
 				r = 0x00;
 			}
-			if (ThePrefs.SIDType == SIDTYPE_DIGITAL_6581) {
+			if (the_c64->GetPrefs().SIDType == SIDTYPE_DIGITAL_6581) {
 				fake_v3_count &= 0x7fffff | ((uint32_t) r << 16);	// Counter MSB may get cleared
 			}
 			return r;
@@ -429,7 +439,60 @@ constexpr uint32_t SID_FREQ = 1022727;		// SID frequency in Hz (NTSC)
 #else
 constexpr uint32_t SID_FREQ = 985248;		// SID frequency in Hz (PAL)
 #endif
-constexpr size_t SAMPLE_BUF_SIZE = TOTAL_RASTERS * 2;	// Size of buffer for sampled voice (double buffered)
+
+constexpr unsigned EVENT_BUF_SIZE = 4096;	// Size of register write event buffer (must be a power of 2)
+constexpr uint8_t EVENT_RESET = 0xff;		// Register number for SID reset event
+
+constexpr uint32_t AUDIO_LATENCY_CYCLES = TOTAL_RASTERS * CYCLES_PER_LINE;	// Target delay of sound output behind emulation (one frame)
+constexpr int32_t AUDIO_MAX_LAG_CYCLES = AUDIO_LATENCY_CYCLES * 4;			// Resynchronize sound output if delay gets larger
+
+
+constexpr unsigned RENDER_BLOCK_SIZE = 64;	// Maximum number of samples calculated in one block
+constexpr unsigned RENDER_VEC_SIZE = 4;		// Number of samples per SIMD vector
+
+
+// SIMD vector types for block calculations (GCC/Clang vector extensions,
+// compiled to SSE2 or NEON instructions)
+using vec_u32 = uint32_t __attribute__((vector_size(RENDER_VEC_SIZE * sizeof(uint32_t))));
+using vec_i32 = int32_t __attribute__((vector_size(RENDER_VEC_SIZE * sizeof(int32_t))));
+
+static_assert(RENDER_VEC_SIZE == 4 && RENDER_BLOCK_SIZE % RENDER_VEC_SIZE == 0);
+
+template <typename V, typename T>
+static inline V load_vec(const T * p)
+{
+	V v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+template <typename V, typename T>
+static inline void store_vec(T * p, V v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+
+// Timestamped SID register write
+struct SIDEvent {
+	uint32_t cycle;		// C64 cycle counter value of write
+	uint8_t adr;		// Register number (or EVENT_RESET)
+	uint8_t byte;		// Written value
+};
+
+
+// Intermediate results for one block of samples (vector loops may
+// calculate up to RENDER_VEC_SIZE - 1 samples beyond the end of a block)
+struct RenderBlock {
+	int32_t mode_vol[RENDER_BLOCK_SIZE];			// MODE/VOL register for each sample
+	int32_t res_filt[RENDER_BLOCK_SIZE];			// RES/FILT register for each sample
+	uint32_t phase[3][RENDER_BLOCK_SIZE];			// Phase accumulators of voices
+	uint32_t mod_phase[RENDER_BLOCK_SIZE];			// Delayed phase accumulator of ring modulating voice
+	int32_t env[3][RENDER_BLOCK_SIZE];				// Envelope generator outputs
+	int32_t wave[3][RENDER_BLOCK_SIZE];				// Waveform generator outputs (signed)
+	int32_t sum_output[RENDER_BLOCK_SIZE];			// Mixed unfiltered voices
+	int32_t sum_input_filter[RENDER_BLOCK_SIZE];	// Mixed voices routed through filter
+};
 
 
 // Structure for one voice
@@ -466,7 +529,7 @@ struct DRVoice {
 // Renderer class
 class DigitalRenderer : public SIDRenderer {
 public:
-	DigitalRenderer(MOS6581 * sid);
+	DigitalRenderer(MOS6581 * sid, C64 * c64, int type);
 	virtual ~DigitalRenderer();
 
 	void Reset() override;
@@ -475,17 +538,37 @@ public:
 	void NewPrefs(const Prefs *prefs) override;
 	void Pause() override;
 	void Resume() override;
+	void EmulateFrame() override;
 
 private:
+	void push_event(uint8_t adr, uint8_t byte);
+	void reset_voices();
+	void write_register(uint8_t adr, uint8_t byte);
+	bool event_due(uint32_t cycle) const;
+	bool apply_events(uint32_t cycle, bool only_mixer);
+
 	filter_t prewarp_freq(filter_t freq) const;
 	void calc_wa_tables(int sid_type);
 
 	void calc_filter();
+	unsigned start_block(RenderBlock & b, unsigned max, uint32_t emu_now);
+	void calc_envelope(DRVoice * v, int32_t * env, unsigned n);
+	bool calc_phase(DRVoice * v, uint32_t * phase, int32_t * wave, unsigned n, bool is6581);
+	void calc_wave(DRVoice * v, const uint32_t * phase, const uint32_t * mod_phase, int32_t * wave, unsigned n);
+	void calc_voices_serial(RenderBlock & b, unsigned n, bool is6581);
+	void calc_voices(RenderBlock & b, unsigned n, bool is6581);
+	void mix_voices(RenderBlock & b, unsigned n);
+	bool filter_settled() const;
+	template <bool SMOOTH> void calc_filters(const RenderBlock & b, unsigned n, int32_t dc_offset, int16_t * buf);
 	void calc_buffer(int16_t *buf, long count);
 
-	bool ready;						// Flag: Renderer has initialized and is ready
+	uint8_t sid_random();
+
+	bool ready = false;				// Flag: Renderer has initialized and is ready
 
 	MOS6581 * the_sid;				// Pointer to SID object
+	C64 * the_c64;					// Pointer to C64 object
+	int sid_type;					// SID type (6581 or 8580)
 
 	uint8_t mode_vol;				// MODE/VOL register
 	uint8_t res_filt;				// RES/FILT register
@@ -531,13 +614,29 @@ private:
 	filter_t audio_out_lp1;
 	filter_t audio_out_hp;
 
-	uint8_t sample_mode_vol[SAMPLE_BUF_SIZE]; 	// Sampled MODE/VOL register (Impossible Mission, Ghostbusters, Arkanoid, ...)
-	uint8_t sample_res_filt[SAMPLE_BUF_SIZE];	// Sampled RES/FILT register (Space Taxi)
-	unsigned sample_in_ptr;			// Index in sample buffers for writing
+	uint32_t noise_seed = 1;		// Noise generator RNG seed value
+
+	// Register writes are passed from the emulation thread to the audio
+	// thread through a lock-free single-producer/single-consumer ring
+	// buffer, and replayed at the sample corresponding to their cycle
+	// (for sampled voices like in Impossible Mission, Ghostbusters, ...)
+	SIDEvent events[EVENT_BUF_SIZE];		// Ring buffer of register writes
+	std::atomic<unsigned> event_in = 0;		// Write index, only advanced by emulation thread
+	std::atomic<unsigned> event_out = 0;	// Read index, only advanced by audio thread
+	std::atomic<uint32_t> emu_cycle = 0;	// Cycle counter of emulation, updated every raster line
+
+	uint8_t regs[25];				// Last written register values (emulation thread)
+	bool events_lost = false;		// Flag: Ring buffer overflowed, resend all registers (emulation thread)
+
+	uint32_t audio_latency;			// Target delay of sound output behind emulation in cycles
+	uint32_t audio_cycle = 0;		// Cycle counter value corresponding to current output sample (audio thread)
+	uint32_t audio_cycle_frac = 0;	// Fractional part of audio_cycle (16 bits)
 
 	static void buffer_proc(void * userdata, uint8_t * buffer, int size);
 	SDL_AudioDeviceID device_id;	// SDL audio device ID
 	SDL_AudioSpec obtained;			// Obtained output format
+
+	bool file_output = false;		// Flag: Render to the SID's output file (instead of audio device)
 };
 
 
@@ -576,7 +675,7 @@ const uint8_t MOS6581::EGDRShift[256] = {
  *  Constructor
  */
 
-DigitalRenderer::DigitalRenderer(MOS6581 * sid) : the_sid(sid)
+DigitalRenderer::DigitalRenderer(MOS6581 * sid, C64 * c64, int type) : the_sid(sid), the_c64(c64), sid_type(type)
 {
 	// Link voices together
 	voice[0].mod_by = &voice[2];
@@ -587,7 +686,8 @@ DigitalRenderer::DigitalRenderer(MOS6581 * sid) : the_sid(sid)
 	voice[2].mod_to = &voice[0];
 
 	// Reset SID
-	Reset();
+	reset_voices();
+	memset(regs, 0, sizeof(regs));
 
 	SDL_AudioSpec desired;
 	SDL_zero(desired);
@@ -601,18 +701,32 @@ DigitalRenderer::DigitalRenderer(MOS6581 * sid) : the_sid(sid)
 	desired.callback = buffer_proc;
 	desired.userdata = this;
 
-	// Open output device
-	device_id = SDL_OpenAudioDevice(NULL, false, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
-	if (device_id == 0) {
-		fprintf(stderr, "WARNING: Cannot open audio: %s\n", SDL_GetError());
-		return;
+	if (! c64->GetPrefs().AudioOutputPath.empty()) {
+
+		// Render sound offline to file, driven by the emulation
+		device_id = 0;
+		obtained = desired;
+		if (! the_sid->AudioOutputOpen())
+			return;
+		file_output = true;
+		audio_latency = 0;
+
+	} else {
+
+		// Open output device
+		device_id = SDL_OpenAudioDevice(NULL, false, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+		if (device_id == 0) {
+			fprintf(stderr, "WARNING: Cannot open audio: %s\n", SDL_GetError());
+			return;
+		}
+		audio_latency = AUDIO_LATENCY_CYCLES;
 	}
 
 	// Calculate number of SID cycles per sample frame
 	sid_cycles_frac = uint32_t(float(SID_FREQ) / obtained.freq * 65536.0);
 
 	// Precompute filter cutoff frequency tables
-	calc_wa_tables(ThePrefs.SIDType);
+	calc_wa_tables(sid_type);
 
 	// AUDIO OUT of SID is connected to 16 kHz (R = 10 kΩ, C = 1 nF)
 	// low-pass and 16 Hz (R = 1 kΩ, C = 10 µF) high-pass RC filters
@@ -623,6 +737,10 @@ DigitalRenderer::DigitalRenderer(MOS6581 * sid) : the_sid(sid)
 	out_hp_g = 1.0 - wc_hp;				// Approximation of (1-sin(wc))/cos(wc) for small wc
 	out_hp_d = (1.0 + out_hp_g) / 2;
 
+	// Start sound output one frame behind the emulation
+	emu_cycle = the_c64->CycleCounter();
+	audio_cycle = emu_cycle - audio_latency;
+
 	// Start sound output
 	Resume();
 
@@ -644,10 +762,22 @@ DigitalRenderer::~DigitalRenderer()
 
 
 /*
- *  Reset emulation
+ *  Reset emulation (the reset is passed to the audio thread like a
+ *  register write)
  */
 
 void DigitalRenderer::Reset()
+{
+	memset(regs, 0, sizeof(regs));
+	push_event(EVENT_RESET, 0);
+}
+
+
+/*
+ *  Reset voices and filters (audio thread)
+ */
+
+void DigitalRenderer::reset_voices()
 {
 	mode_vol = 0;
 	res_filt = 0;
@@ -678,10 +808,6 @@ void DigitalRenderer::Reset()
 	hp_xn1 = hp_xn2 = hp_yn1 = hp_yn2 = 0.0;
 
 	audio_out_lp = audio_out_lp1 = audio_out_hp = 0.0;
-
-	sample_in_ptr = 0;
-	memset(sample_mode_vol, 0, SAMPLE_BUF_SIZE);
-	memset(sample_res_filt, 0, SAMPLE_BUF_SIZE);
 }
 
 
@@ -710,27 +836,110 @@ void DigitalRenderer::Resume()
 
 
 /*
- *  Sample current volume setting once per raster line (for sampled voice)
+ *  Publish emulation time to audio thread once per raster line
  */
 
 void DigitalRenderer::EmulateLine()
 {
-	// Record registers for sample playback
-	sample_mode_vol[sample_in_ptr] = mode_vol;
-	sample_res_filt[sample_in_ptr] = res_filt;
-	sample_in_ptr = (sample_in_ptr + 1) % SAMPLE_BUF_SIZE;
+	// Resend all registers after an overflow of the event buffer
+	// (e.g. while sound output was paused)
+	if (events_lost) {
+		unsigned used = event_in.load(std::memory_order_relaxed) - event_out.load(std::memory_order_acquire);
+		if (EVENT_BUF_SIZE - used >= sizeof(regs)) {
+			events_lost = false;
+			for (unsigned i = 0; i < sizeof(regs); ++i) {
+				push_event(i, regs[i]);
+			}
+		}
+	}
+
+	emu_cycle.store(the_c64->CycleCounter(), std::memory_order_release);
 }
 
 
 /*
- *  Write to register
+ *  Write to register (emulation thread)
  */
 
 void DigitalRenderer::WriteRegister(uint16_t adr, uint8_t byte)
 {
-	if (!ready)
+	if (!ready || adr >= sizeof(regs))
 		return;
 
+	regs[adr] = byte;
+	push_event(adr, byte);
+}
+
+
+/*
+ *  Add timestamped register write to event buffer (emulation thread)
+ */
+
+void DigitalRenderer::push_event(uint8_t adr, uint8_t byte)
+{
+	unsigned in = event_in.load(std::memory_order_relaxed);
+	if (in - event_out.load(std::memory_order_acquire) >= EVENT_BUF_SIZE) {
+		events_lost = true;
+		return;
+	}
+
+	events[in % EVENT_BUF_SIZE] = { the_c64->CycleCounter(), adr, byte };
+	event_in.store(in + 1, std::memory_order_release);
+}
+
+
+/*
+ *  Check whether a register write is due at the given cycle (audio thread)
+ */
+
+inline bool DigitalRenderer::event_due(uint32_t cycle) const
+{
+	unsigned out = event_out.load(std::memory_order_relaxed);
+	return out != event_in.load(std::memory_order_acquire) && int32_t(events[out % EVENT_BUF_SIZE].cycle - cycle) <= 0;
+}
+
+
+/*
+ *  Apply all register writes which are due at the given cycle (audio
+ *  thread). If only_mixer is true, stop at the first write which is not
+ *  to the filter and volume registers and return false.
+ */
+
+bool DigitalRenderer::apply_events(uint32_t cycle, bool only_mixer)
+{
+	unsigned out = event_out.load(std::memory_order_relaxed);
+	unsigned in = event_in.load(std::memory_order_acquire);
+	bool all_applied = true;
+
+	while (out != in) {
+		const SIDEvent & e = events[out % EVENT_BUF_SIZE];
+		if (int32_t(e.cycle - cycle) > 0)
+			break;
+
+		if (only_mixer && (e.adr < 21 || e.adr == EVENT_RESET)) {
+			all_applied = false;
+			break;
+		}
+
+		if (e.adr == EVENT_RESET) {
+			reset_voices();
+		} else {
+			write_register(e.adr, e.byte);
+		}
+		++out;
+	}
+
+	event_out.store(out, std::memory_order_release);
+	return all_applied;
+}
+
+
+/*
+ *  Write to register (audio thread)
+ */
+
+void DigitalRenderer::write_register(uint8_t adr, uint8_t byte)
+{
 	unsigned v = adr / 7;	// Voice number
 
 	switch (adr) {
@@ -820,7 +1029,16 @@ void DigitalRenderer::WriteRegister(uint16_t adr, uint8_t byte)
 void DigitalRenderer::NewPrefs(const Prefs *prefs)
 {
 	// Recompute filter cutoff frequency tables
-	calc_wa_tables(prefs->SIDType);
+	if (device_id) {
+		SDL_LockAudioDevice(device_id);
+	}
+
+	sid_type = prefs->SIDType;
+	calc_wa_tables(sid_type);
+
+	if (device_id) {
+		SDL_UnlockAudioDevice(device_id);
+	}
 }
 
 
@@ -990,70 +1208,242 @@ void DigitalRenderer::calc_filter()
  *  Random number generator for noise waveform
  */
 
-static uint8_t sid_random()
+uint8_t DigitalRenderer::sid_random()
 {
-	static uint32_t seed = 1;
-	seed = seed * 1103515245 + 12345;
-	return seed >> 16;
+	noise_seed = noise_seed * 1103515245 + 12345;
+	return noise_seed >> 16;
 }
 
 
 /*
- *  Fill one audio buffer with calculated SID sound
+ *  Advance sound output time by one sample, but not beyond the emulation
  */
 
-void DigitalRenderer::calc_buffer(int16_t *buf, long count)
+static inline void advance_audio_time(uint32_t & cycle, uint32_t & frac, uint32_t sid_cycles_frac, uint32_t limit)
 {
-	bool is6581 = (ThePrefs.SIDType == SIDTYPE_DIGITAL_6581);
+	if (int32_t(limit - cycle) > 0) {
+		frac += sid_cycles_frac;
+		cycle += frac >> 16;
+		frac &= 0xffff;
+	}
+}
 
-	// Index in sample buffer for reading, 16.16 fixed
-	uint32_t sample_count = (sample_in_ptr + SAMPLE_BUF_SIZE/2) << 16;
 
-	// Output DC offset
-	const int32_t dc_offset = (ThePrefs.SIDType == SIDTYPE_DIGITAL_6581) ? 0x800000 : 0x100000;
+/*
+ *  Start new block of samples: Advance sound output time and apply due
+ *  register writes. The block extends up to the next write to a voice
+ *  register, so the voices can be calculated over the whole block with
+ *  constant settings. Writes to the filter and volume registers (sampled
+ *  voice) are applied within the block, and recorded per sample.
+ *  Returns number of samples in block.
+ */
 
-	count >>= 1;	// 16 bit mono output, count is in bytes
-	while (count--) {
+unsigned DigitalRenderer::start_block(RenderBlock & b, unsigned max, uint32_t emu_now)
+{
+	advance_audio_time(audio_cycle, audio_cycle_frac, sid_cycles_frac, emu_now);
+	apply_events(audio_cycle, false);
 
-		// Get current master volume and RES/FILT setting from sample buffers
-		const uint8_t mode_vol = sample_mode_vol[(sample_count >> 16) % SAMPLE_BUF_SIZE];
-		const uint8_t master_volume = mode_vol & 0xf;
-		const uint8_t res_filt = sample_res_filt[(sample_count >> 16) % SAMPLE_BUF_SIZE];
-		sample_count += ((TOTAL_RASTERS * SCREEN_FREQ) << 16) / obtained.freq;
+	b.mode_vol[0] = mode_vol;
+	b.res_filt[0] = res_filt;
 
-		int32_t sum_output = 0;
-		int32_t sum_input_filter = 0;
-		int32_t sum_output_filter = 0;
+	unsigned n;
+	for (n = 1; n < max; ++n) {
+		uint32_t cycle = audio_cycle, frac = audio_cycle_frac;
+		advance_audio_time(cycle, frac, sid_cycles_frac, emu_now);
+		if (event_due(cycle) && ! apply_events(cycle, true))
+			break;
+
+		audio_cycle = cycle;
+		audio_cycle_frac = frac;
+		b.mode_vol[n] = mode_vol;
+		b.res_filt[n] = res_filt;
+	}
+
+	return n;
+}
+
+
+/*
+ *  Calculate envelope generator output of one voice over a block
+ */
+
+void DigitalRenderer::calc_envelope(DRVoice * v, int32_t * env, unsigned n)
+{
+	// Constant level
+	if ((v->eg_state == EG_DECAY_SUSTAIN && v->eg_level == v->s_level) || (v->eg_state == EG_RELEASE && v->eg_level == 0)) {
+		std::fill_n(env, n, v->eg_level >> 16);
+		return;
+	}
+
+	for (unsigned i = 0; i < n; ++i) {
+		switch (v->eg_state) {
+			case EG_ATTACK:
+				v->eg_level += v->a_add;
+				if (v->eg_level > 0xffffff) {
+					v->eg_level = 0xffffff;
+					v->eg_state = EG_DECAY_SUSTAIN;
+				}
+				break;
+			case EG_DECAY_SUSTAIN:
+				v->eg_level -= v->d_sub >> MOS6581::EGDRShift[v->eg_level >> 16];
+				if (v->eg_level < v->s_level) {
+					v->eg_level = v->s_level;
+				}
+				break;
+			case EG_RELEASE:
+				v->eg_level -= v->r_sub >> MOS6581::EGDRShift[v->eg_level >> 16];
+				if (v->eg_level < 0) {
+					v->eg_level = 0;
+				}
+				break;
+		}
+		env[i] = v->eg_level >> 16;
+	}
+}
+
+
+/*
+ *  Advance phase accumulator of one voice over a block. Waveforms which
+ *  feed back into the accumulator (noise, and combined waveforms of the
+ *  6581) are calculated here, too, and true is returned in this case.
+ */
+
+bool DigitalRenderer::calc_phase(DRVoice * v, uint32_t * phase, int32_t * wave, unsigned n, bool is6581)
+{
+	uint32_t count = v->count;
+	const uint32_t add = v->test ? 0 : v->add;
+
+	switch (v->wave) {
+		case WAVE_NOISE:
+			for (unsigned i = 0; i < n; ++i) {
+				count = (count + add) & 0xffffff;
+				if (count > 0x100000) {
+					v->noise = sid_random() << 8;
+					count &= 0xfffff;
+				}
+				wave[i] = int32_t(v->noise) - 0x8000;
+				phase[i] = count;
+			}
+			v->count = count;
+			return true;
+
+		case WAVE_TRISAW:
+		case WAVE_SAWRECT:
+		case WAVE_TRISAWRECT:
+			if (is6581) {
+				const uint16_t * table = v->wave == WAVE_TRISAW ? the_sid->TriSawTable : (v->wave == WAVE_SAWRECT ? the_sid->SawRectTable : the_sid->TriSawRectTable);
+				const bool pulse = v->wave != WAVE_TRISAW;
+				for (unsigned i = 0; i < n; ++i) {
+					count = (count + add) & 0xffffff;
+					uint16_t output = 0;
+					if (! pulse || v->test || (count >> 12) >= v->pw) {
+						output = table[count >> 12];
+					}
+					count &= 0x7fffff | (output << 8);	// Counter MSB may get cleared
+					wave[i] = int32_t(output) - 0x8000;
+					phase[i] = count;
+				}
+				v->count = count;
+				return true;
+			}
+			break;
+	}
+
+	// Accumulator is independent of waveform
+	const vec_u32 step = vec_u32{1, 2, 3, 4} * add;
+	for (unsigned i = 0; i < n; i += RENDER_VEC_SIZE) {
+		store_vec(phase + i, (count + i * add + step) & 0xffffff);
+	}
+	v->count = phase[n - 1];
+	return false;
+}
+
+
+/*
+ *  Calculate waveform generator output of one voice over a block from
+ *  its phase accumulator values (and those of the ring modulating voice)
+ */
+
+void DigitalRenderer::calc_wave(DRVoice * v, const uint32_t * phase, const uint32_t * mod_phase, int32_t * wave, unsigned n)
+{
+	const uint32_t pw = v->test ? 0 : v->pw;	// Test bit forces pulse output high
+	const uint32_t ring_mask = v->ring ? 0x800000 : 0;
+
+	switch (v->wave) {
+		case WAVE_TRI:
+			for (unsigned i = 0; i < n; i += RENDER_VEC_SIZE) {
+				vec_u32 count = load_vec<vec_u32>(phase + i);
+				vec_u32 ctrl = count ^ (load_vec<vec_u32>(mod_phase + i) & ring_mask);
+				vec_u32 invert = ((ctrl >> 23) & 1) * 0xffff;
+				vec_u32 output = ((count >> 7) ^ invert) & 0xffff;
+				store_vec(wave + i, (vec_i32) output - 0x8000);
+			}
+			break;
+
+		case WAVE_SAW:
+			for (unsigned i = 0; i < n; i += RENDER_VEC_SIZE) {
+				vec_u32 output = load_vec<vec_u32>(phase + i) >> 8;
+				store_vec(wave + i, (vec_i32) output - 0x8000);
+			}
+			break;
+
+		case WAVE_RECT:
+			for (unsigned i = 0; i < n; i += RENDER_VEC_SIZE) {
+				vec_u32 output = (vec_u32) ((load_vec<vec_u32>(phase + i) >> 12) >= pw) & 0xffff;
+				store_vec(wave + i, (vec_i32) output - 0x8000);
+			}
+			break;
+
+		// Combined waveforms need table lookups
+		case WAVE_TRIRECT:
+			for (unsigned i = 0; i < n; ++i) {
+				uint32_t ctrl = phase[i] ^ (~mod_phase[i] & ring_mask);
+				uint16_t output = (phase[i] >> 12) >= pw ? the_sid->TriRectTable[ctrl >> 12] : 0;
+				wave[i] = int32_t(output) - 0x8000;
+			}
+			break;
+
+		case WAVE_TRISAW:
+			for (unsigned i = 0; i < n; ++i) {
+				wave[i] = int32_t(the_sid->TriSawTable[phase[i] >> 12]) - 0x8000;
+			}
+			break;
+
+		case WAVE_SAWRECT:
+			for (unsigned i = 0; i < n; ++i) {
+				uint16_t output = (phase[i] >> 12) >= pw ? the_sid->SawRectTable[phase[i] >> 12] : 0;
+				wave[i] = int32_t(output) - 0x8000;
+			}
+			break;
 
-		// Loop for all three voices
+		case WAVE_TRISAWRECT:
+			for (unsigned i = 0; i < n; ++i) {
+				uint16_t output = (phase[i] >> 12) >= pw ? the_sid->TriSawRectTable[phase[i] >> 12] : 0;
+				wave[i] = int32_t(output) - 0x8000;
+			}
+			break;
+
+		default:
+			std::fill_n(wave, n, 0);
+			break;
+	}
+}
+
+
+/*
+ *  Calculate envelope and waveform generators of all voices sample by
+ *  sample (needed for hard sync, and to keep the order of noise random
+ *  numbers if more than one voice plays noise)
+ */
+
+void DigitalRenderer::calc_voices_serial(RenderBlock & b, unsigned n, bool is6581)
+{
+	for (unsigned i = 0; i < n; ++i) {
 		for (unsigned j = 0; j < 3; ++j) {
 			DRVoice *v = &voice[j];
 
 			// Envelope generator
-			uint16_t envelope;
-
-			switch (v->eg_state) {
-				case EG_ATTACK:
-					v->eg_level += v->a_add;
-					if (v->eg_level > 0xffffff) {
-						v->eg_level = 0xffffff;
-						v->eg_state = EG_DECAY_SUSTAIN;
-					}
-					break;
-				case EG_DECAY_SUSTAIN:
-					v->eg_level -= v->d_sub >> MOS6581::EGDRShift[v->eg_level >> 16];
-					if (v->eg_level < v->s_level) {
-						v->eg_level = v->s_level;
-					}
-					break;
-				case EG_RELEASE:
-					v->eg_level -= v->r_sub >> MOS6581::EGDRShift[v->eg_level >> 16];
-					if (v->eg_level < 0) {
-						v->eg_level = 0;
-					}
-					break;
-			}
-			envelope = v->eg_level >> 16;
+			calc_envelope(v, &b.env[j][i], 1);
 
 			// Waveform generator
 			uint16_t output;
@@ -1141,60 +1531,179 @@ void DigitalRenderer::calc_buffer(int16_t *buf, long count)
 					break;
 			}
 
-			// Route voice through filter if selected
-			if (res_filt & (1 << j)) {
-				sum_input_filter += (int16_t)(output ^ 0x8000) * envelope;
-			} else if (j != 2 || (mode_vol & 0x80) == 0) {	// Voice 3 mute
-				sum_output += (int16_t)(output ^ 0x8000) * envelope;
-			}
+			b.wave[j][i] = int32_t(output) - 0x8000;
 		}
+	}
+}
+
+
+/*
+ *  Calculate envelope and waveform generators of all voices over a block
+ */
+
+void DigitalRenderer::calc_voices(RenderBlock & b, unsigned n, bool is6581)
+{
+	unsigned num_noise = 0;
+	bool sync = false;
+	for (unsigned j = 0; j < 3; ++j) {
+		num_noise += voice[j].wave == WAVE_NOISE;
+		sync |= voice[j].sync;
+	}
+
+	if (sync || num_noise > 1) {
+		calc_voices_serial(b, n, is6581);
+		return;
+	}
+
+	// Without hard sync, the accumulators are independent of each other
+	uint32_t prev_count[3];
+	bool have_wave[3];
+	for (unsigned j = 0; j < 3; ++j) {
+		prev_count[j] = voice[j].count;
+		calc_envelope(&voice[j], b.env[j], n);
+		have_wave[j] = calc_phase(&voice[j], b.phase[j], b.wave[j], n, is6581);
+	}
+
+	for (unsigned j = 0; j < 3; ++j) {
+		if (have_wave[j])
+			continue;
+
+		// The ring modulating voice is calculated after this one in
+		// sample-by-sample order, so the previous accumulator value
+		// of voice 3 modulates voice 1
+		unsigned m = voice[j].mod_by - voice;
+		const uint32_t * mod_phase = b.phase[m];
+		if (m > j) {
+			b.mod_phase[0] = prev_count[m];
+			std::copy_n(b.phase[m], n - 1, b.mod_phase + 1);
+			mod_phase = b.mod_phase;
+		}
+
+		calc_wave(&voice[j], b.phase[j], mod_phase, b.wave[j], n);
+	}
+}
+
+
+/*
+ *  Mix voices over a block, route them through filter if selected
+ */
+
+void DigitalRenderer::mix_voices(RenderBlock & b, unsigned n)
+{
+	for (unsigned i = 0; i < n; i += RENDER_VEC_SIZE) {
+		const vec_i32 res_filt = load_vec<vec_i32>(b.res_filt + i);
+		const vec_i32 mute_3 = (load_vec<vec_i32>(b.mode_vol + i) & 0x80) != 0;	// Voice 3 mute
+
+		vec_i32 sum_output = {};
+		vec_i32 sum_input_filter = {};
+
+		for (unsigned j = 0; j < 3; ++j) {
+			vec_i32 sample = load_vec<vec_i32>(b.wave[j] + i) * load_vec<vec_i32>(b.env[j] + i);
+			vec_i32 filter = (res_filt & (1 << j)) != 0;
+			vec_i32 mute = j == 2 ? mute_3 : vec_i32{};
+			sum_input_filter += sample & filter;
+			sum_output += sample & ~(filter | mute);
+		}
+
+		store_vec(b.sum_output + i, sum_output);
+		store_vec(b.sum_input_filter + i, sum_input_filter);
+	}
+}
+
+
+/*
+ *  Check whether smoothing of filter parameter transitions has reached a
+ *  fixed point, so it has no effect on the smoothed coefficients
+ */
+
+bool DigitalRenderer::filter_settled() const
+{
+	auto settled = [](filter_t eff, filter_t target) { return eff * 0.8 + target * 0.2 == eff; };
+
+	return settled(lp_d0_eff, lp_d0) && settled(lp_g1_eff, lp_g1) && settled(lp_g2_eff, lp_g2)
+	    && settled(bp_d0_eff, bp_d0) && settled(bp_g1_eff, bp_g1) && settled(bp_g2_eff, bp_g2)
+	    && settled(hp_d0_eff, hp_d0) && settled(hp_g1_eff, hp_g1) && settled(hp_g2_eff, hp_g2);
+}
+
+
+/*
+ *  Run mixed voices of a block through filters and write them to the
+ *  output buffer (the filter states are kept in local variables during
+ *  the block; with SMOOTH = false the smoothed coefficients are constant)
+ */
+
+template <bool SMOOTH>
+void DigitalRenderer::calc_filters(const RenderBlock & b, unsigned n, int32_t dc_offset, int16_t * buf)
+{
+	filter_t lp_d0_e = lp_d0_eff, lp_g1_e = lp_g1_eff, lp_g2_e = lp_g2_eff;
+	filter_t bp_d0_e = bp_d0_eff, bp_g1_e = bp_g1_eff, bp_g2_e = bp_g2_eff;
+	filter_t hp_d0_e = hp_d0_eff, hp_g1_e = hp_g1_eff, hp_g2_e = hp_g2_eff;
+
+	filter_t lp_x1 = lp_xn1, lp_x2 = lp_xn2, lp_y1 = lp_yn1, lp_y2 = lp_yn2;
+	filter_t bp_x1 = bp_xn1, bp_x2 = bp_xn2, bp_y1 = bp_yn1, bp_y2 = bp_yn2;
+	filter_t hp_x1 = hp_xn1, hp_x2 = hp_xn2, hp_y1 = hp_yn1, hp_y2 = hp_yn2;
+
+	filter_t out_lp = audio_out_lp, out_lp1 = audio_out_lp1, out_hp = audio_out_hp;
+
+	for (unsigned i = 0; i < n; ++i) {
+		const int32_t mode_vol = b.mode_vol[i];
+		const int32_t master_volume = mode_vol & 0xf;
+
+		const filter_t input_filter = b.sum_input_filter[i];
+		int32_t sum_output_filter = 0;
 
 		// SID-internal low-pass filter
-		lp_d0_eff = lp_d0_eff * 0.8 + lp_d0 * 0.2;	// Smooth out filter parameter transitions
-		lp_g1_eff = lp_g1_eff * 0.8 + lp_g1 * 0.2;
-		lp_g2_eff = lp_g2_eff * 0.8 + lp_g2 * 0.2;
+		if constexpr (SMOOTH) {
+			lp_d0_e = lp_d0_e * 0.8 + lp_d0 * 0.2;	// Smooth out filter parameter transitions
+			lp_g1_e = lp_g1_e * 0.8 + lp_g1 * 0.2;
+			lp_g2_e = lp_g2_e * 0.8 + lp_g2 * 0.2;
+		}
 
-		filter_t lp_xn = filter_t(sum_input_filter) * lp_d0_eff;
-		filter_t lp_yn = lp_xn + 2.0 * lp_xn1 + lp_xn2 - lp_g1_eff * lp_yn1 - lp_g2_eff * lp_yn2;
-		lp_yn2 = lp_yn1; lp_yn1 = lp_yn; lp_xn2 = lp_xn1; lp_xn1 = lp_xn;
+		filter_t lp_xn = input_filter * lp_d0_e;
+		filter_t lp_yn = lp_xn + 2.0 * lp_x1 + lp_x2 - lp_g1_e * lp_y1 - lp_g2_e * lp_y2;
+		lp_y2 = lp_y1; lp_y1 = lp_yn; lp_x2 = lp_x1; lp_x1 = lp_xn;
 
 		if (mode_vol & 0x10) {
 			sum_output_filter += (int32_t) lp_yn;
 		}
 
 		// SID-internal band-pass filter
-		bp_d0_eff = bp_d0_eff * 0.8 + bp_d0 * 0.2;
-		bp_g1_eff = bp_g1_eff * 0.8 + bp_g1 * 0.2;
-		bp_g2_eff = bp_g2_eff * 0.8 + bp_g2 * 0.2;
+		if constexpr (SMOOTH) {
+			bp_d0_e = bp_d0_e * 0.8 + bp_d0 * 0.2;
+			bp_g1_e = bp_g1_e * 0.8 + bp_g1 * 0.2;
+			bp_g2_e = bp_g2_e * 0.8 + bp_g2 * 0.2;
+		}
 
-		filter_t bp_xn = filter_t(sum_input_filter) * bp_d0_eff;
-		filter_t bp_yn = bp_xn - bp_xn2 - bp_g1_eff * bp_yn1 - bp_g2_eff * bp_yn2;
-		bp_yn2 = bp_yn1; bp_yn1 = bp_yn; bp_xn2 = bp_xn1; bp_xn1 = bp_xn;
+		filter_t bp_xn = input_filter * bp_d0_e;
+		filter_t bp_yn = bp_xn - bp_x2 - bp_g1_e * bp_y1 - bp_g2_e * bp_y2;
+		bp_y2 = bp_y1; bp_y1 = bp_yn; bp_x2 = bp_x1; bp_x1 = bp_xn;
 
 		if (mode_vol & 0x20) {
 			sum_output_filter += (int32_t) bp_yn;
 		}
 
 		// SID-internal high-pass filter
-		hp_d0_eff = hp_d0_eff * 0.8 + hp_d0 * 0.2;
-		hp_g1_eff = hp_g1_eff * 0.8 + hp_g1 * 0.2;
-		hp_g2_eff = hp_g2_eff * 0.8 + hp_g2 * 0.2;
+		if constexpr (SMOOTH) {
+			hp_d0_e = hp_d0_e * 0.8 + hp_d0 * 0.2;
+			hp_g1_e = hp_g1_e * 0.8 + hp_g1 * 0.2;
+			hp_g2_e = hp_g2_e * 0.8 + hp_g2 * 0.2;
+		}
 
-		filter_t hp_xn = filter_t(sum_input_filter) * hp_d0_eff;
-		filter_t hp_yn = hp_xn - 2.0 * hp_xn1 + hp_xn2 - hp_g1_eff * hp_yn1 - hp_g2_eff * hp_yn2;
-		hp_yn2 = hp_yn1; hp_yn1 = hp_yn; hp_xn2 = hp_xn1; hp_xn1 = hp_xn;
+		filter_t hp_xn = input_filter * hp_d0_e;
+		filter_t hp_yn = hp_xn - 2.0 * hp_x1 + hp_x2 - hp_g1_e * hp_y1 - hp_g2_e * hp_y2;
+		hp_y2 = hp_y1; hp_y1 = hp_yn; hp_x2 = hp_x1; hp_x1 = hp_xn;
 
 		if (mode_vol & 0x40) {
 			sum_output_filter += (int32_t) hp_yn;
 		}
 
 		// External filters on AUDIO OUT
-		int32_t ext_output = (sum_output + sum_output_filter + dc_offset) * master_volume;
+		int32_t ext_output = (b.sum_output[i] + sum_output_filter + dc_offset) * master_volume;
 		filter_t audio_out = 0.75 * filter_t(ext_output) / (1 << 14);
-		audio_out_lp = out_lp_g * audio_out_lp + (1 - out_lp_g) * audio_out;
-		audio_out_hp = out_hp_g * audio_out_hp + out_hp_d * (audio_out_lp - audio_out_lp1);
-		audio_out_lp1 = audio_out_lp;
-		ext_output = (int32_t) audio_out_hp;
+		out_lp = out_lp_g * out_lp + (1 - out_lp_g) * audio_out;
+		out_hp = out_hp_g * out_hp + out_hp_d * (out_lp - out_lp1);
+		out_lp1 = out_lp;
+		ext_output = (int32_t) out_hp;
 
 		// Write to buffer
 		if (ext_output > 0x7fff) {	// Using filters can cause minor clipping
@@ -1204,6 +1713,121 @@ void DigitalRenderer::calc_buffer(int16_t *buf, long count)
 		}
 		*buf++ = ext_output;
 	}
+
+	lp_d0_eff = lp_d0_e; lp_g1_eff = lp_g1_e; lp_g2_eff = lp_g2_e;
+	bp_d0_eff = bp_d0_e; bp_g1_eff = bp_g1_e; bp_g2_eff = bp_g2_e;
+	hp_d0_eff = hp_d0_e; hp_g1_eff = hp_g1_e; hp_g2_eff = hp_g2_e;
+
+	lp_xn1 = lp_x1; lp_xn2 = lp_x2; lp_yn1 = lp_y1; lp_yn2 = lp_y2;
+	bp_xn1 = bp_x1; bp_xn2 = bp_x2; bp_yn1 = bp_y1; bp_yn2 = bp_y2;
+	hp_xn1 = hp_x1; hp_xn2 = hp_x2; hp_yn1 = hp_y1; hp_yn2 = hp_y2;
+
+	audio_out_lp = out_lp; audio_out_lp1 = out_lp1; audio_out_hp = out_hp;
+
+	// Flush decayed filter states to zero to avoid slow arithmetic with
+	// denormal numbers (the remainders are far below the resolution of
+	// any output sample)
+	auto decayed = [](std::initializer_list<filter_t> l) {
+		return std::all_of(l.begin(), l.end(), [](filter_t x) { return std::abs(x) < 1.0E-20; });
+	};
+
+	if (decayed({lp_xn1, lp_xn2, lp_yn1, lp_yn2, bp_xn1, bp_xn2, bp_yn1, bp_yn2, hp_xn1, hp_xn2, hp_yn1, hp_yn2})) {
+		lp_xn1 = lp_xn2 = lp_yn1 = lp_yn2 = 0.0;
+		bp_xn1 = bp_xn2 = bp_yn1 = bp_yn2 = 0.0;
+		hp_xn1 = hp_xn2 = hp_yn1 = hp_yn2 = 0.0;
+	}
+	if (decayed({audio_out_lp, audio_out_lp1, audio_out_hp})) {
+		audio_out_lp = audio_out_lp1 = audio_out_hp = 0.0;
+	}
+}
+
+
+/*
+ *  Fill one audio buffer with calculated SID sound
+ */
+
+void DigitalRenderer::calc_buffer(int16_t *buf, long count)
+{
+	bool is6581 = (sid_type == SIDTYPE_DIGITAL_6581);
+
+	// Output DC offset
+	const int32_t dc_offset = is6581 ? 0x800000 : 0x100000;
+
+	// Resynchronize with emulation if the sound output lags too far
+	// behind (fast-forward, paused output) or is ahead (rewind)
+	const uint32_t emu_now = emu_cycle.load(std::memory_order_acquire);
+	int32_t lag = int32_t(emu_now - audio_cycle);
+	if (lag > AUDIO_MAX_LAG_CYCLES || lag < -int32_t(audio_latency)) {
+		audio_cycle = emu_now - audio_latency;
+	}
+
+	RenderBlock b = {};
+
+	count >>= 1;	// 16 bit mono output, count is in bytes
+	while (count > 0) {
+
+		// Calculate voices up to the next change of their settings
+		unsigned n = start_block(b, std::min<long>(count, RENDER_BLOCK_SIZE), emu_now);
+		calc_voices(b, n, is6581);
+		mix_voices(b, n);
+
+		// Filter and output
+		if (filter_settled()) {
+			calc_filters<false>(b, n, dc_offset, buf);
+		} else {
+			calc_filters<true>(b, n, dc_offset, buf);
+		}
+
+		buf += n;
+		count -= n;
+	}
+}
+
+
+/*
+ *  Render sound of the last frame to output file when rendering offline
+ *  (called by the emulation once per frame)
+ */
+
+void DigitalRenderer::EmulateFrame()
+{
+	if (! file_output)
+		return;
+
+	// Number of samples needed to catch up with the emulation
+	const uint32_t emu_now = the_c64->CycleCounter();
+	emu_cycle.store(emu_now, std::memory_order_release);
+
+	int32_t lag = int32_t(emu_now - audio_cycle);
+	if (lag == 0)
+		return;
+
+	// Resynchronize after rewinding, loading a snapshot, or a jump longer
+	// than the lag limit (calc_buffer() is only called from here, so it
+	// never resynchronizes by itself)
+	if (lag < 0 || lag > AUDIO_MAX_LAG_CYCLES) {
+		audio_cycle = emu_now;
+		audio_cycle_frac = 0;
+		return;
+	}
+
+	uint64_t lag_frac = (uint64_t(lag) << 16) - audio_cycle_frac;
+	unsigned count = (lag_frac + sid_cycles_frac - 1) / sid_cycles_frac;
+
+	calc_filter();
+
+	int16_t buf[1024];
+	while (count > 0) {
+		unsigned n = std::min<unsigned>(count, std::size(buf));
+		calc_buffer(buf, n * 2);
+
+		for (unsigned i = 0; i < n; ++i) {
+			buf[i] = SDL_SwapLE16(buf[i]);
+		}
+		the_sid->WriteAudioOutput(buf, n);
+
+		count -= n;
+	}
 }
 
 
@@ -1239,12 +1863,19 @@ void MOS6581::open_close_renderer(int old_type, int new_type)
 	if (old_type == new_type || is_digital(old_type) == is_digital(new_type))
 		return;
 
-	// Delete the old renderer
+	// Delete the old renderer, after writing out its pending offline
+	// sound output
+	if (the_renderer != nullptr) {
+		the_renderer->EmulateFrame();
+	}
 	delete the_renderer;
 
-	// Create new renderer
-	if (new_type == SIDTYPE_DIGITAL_6581 || new_type == SIDTYPE_DIGITAL_8580) {
-		the_renderer = new DigitalRenderer(this);
+	// Create new renderer (no audio output in headless mode, unless
+	// rendering to a file)
+	if (the_c64->GetPrefs().Headless && the_c64->GetPrefs().AudioOutputPath.empty()) {
+		the_renderer = nullptr;
+	} else if (new_type == SIDTYPE_DIGITAL_6581 || new_type == SIDTYPE_DIGITAL_8580) {
+		the_renderer = new DigitalRenderer(this, the_c64, new_type);
 #ifdef __linux__
 	} else if (new_type == SIDTYPE_SIDCARD) {
 		the_renderer = new CatweaselRenderer;
@@ -1260,3 +1891,82 @@ void MOS6581::open_close_renderer(int old_type, int new_type)
 		}
 	}
 }
+
+
+/*
+ *  Open file for offline sound output, write WAV header if the file
+ *  name ends in ".wav"
+ */
+
+static void write_le16(FILE * f, uint16_t v)
+{
+	fputc(v & 0xff, f);
+	fputc(v >> 8, f);
+}
+
+static void write_le32(FILE * f, uint32_t v)
+{
+	write_le16(f, v & 0xffff);
+	write_le16(f, v >> 16);
+}
+
+void MOS6581::open_output_file(const char * path)
+{
+	output_file = fopen(path, "wb");
+	if (output_file == nullptr) {
+		fprintf(stderr, "WARNING: Cannot open audio output file '%s'\n", path);
+		return;
+	}
+
+	size_t len = strlen(path);
+	output_wav = len >= 4 && SDL_strcasecmp(path + len - 4, ".wav") == 0;
+	if (output_wav) {
+
+		// Sizes are filled in by close_output_file()
+		fwrite("RIFF", 1, 4, output_file);
+		write_le32(output_file, 0);
+		fwrite("WAVEfmt ", 1, 8, output_file);
+		write_le32(output_file, 16);					// Format chunk size
+		write_le16(output_file, 1);						// PCM
+		write_le16(output_file, 1);						// Mono
+		write_le32(output_file, SAMPLE_FREQ);			// Sample rate
+		write_le32(output_file, SAMPLE_FREQ * 2);		// Byte rate
+		write_le16(output_file, 2);						// Block align
+		write_le16(output_file, 16);					// Bits per sample
+		fwrite("data", 1, 4, output_file);
+		write_le32(output_file, 0);
+	}
+}
+
+
+/*
+ *  Close offline sound output file, complete WAV header
+ */
+
+void MOS6581::close_output_file()
+{
+	if (output_file == nullptr)
+		return;
+
+	if (output_wav) {
+		uint32_t data_size = output_samples * 2;
+		fseek(output_file, 4, SEEK_SET);
+		write_le32(output_file, 36 + data_size);
+		fseek(output_file, 40, SEEK_SET);
+		write_le32(output_file, data_size);
+	}
+
+	fclose(output_file);
+	output_file = nullptr;
+}
+
+
+/*
+ *  Append samples to offline sound output file
+ */
+
+void MOS6581::WriteAudioOutput(const int16_t * buf, unsigned num_samples)
+{
+	fwrite(buf, 2, num_samples, output_file);
+	output_samples += num_samples;
+}
@@ -21,9 +21,11 @@
 #ifndef SID_H
 #define SID_H
 
+#include <stdio.h>
 #include <stdlib.h>
 
 
+class C64;
 class SIDRenderer;
 class Prefs;
 struct MOS6581State;
@@ -31,7 +33,7 @@ struct MOS6581State;
 // Class for administrative functions
 class MOS6581 {
 public:
-	MOS6581();
+	MOS6581(C64 * c64);
 	~MOS6581();
 
 	void Reset();
@@ -43,6 +45,10 @@ public:
 	void GetState(MOS6581State * s) const;
 	void SetState(const MOS6581State * s);
 	void EmulateLine();
+	void EmulateFrame();
+
+	bool AudioOutputOpen() const { return output_file != nullptr; }
+	void WriteAudioOutput(const int16_t * buf, unsigned num_samples);
 
 	static const int16_t EGDivTable[16];	// Clock divisors for A/D/R settings
 	static const uint8_t EGDRShift[256];	// For exponential approximation of D/R
@@ -65,12 +71,15 @@ public:
 private:
 	void open_close_renderer(int old_type, int new_type);
 	void set_wave_tables(int sid_type);
+	void open_output_file(const char * path);
+	void close_output_file();
 
 	uint8_t v3_random();
 	void update_osc3();
 	uint8_t read_osc3();
 	uint8_t read_env3() const;
 
+	C64 * the_c64;				// Pointer to C64 object
 	SIDRenderer *the_renderer;	// Pointer to current renderer
 
 	uint8_t regs[32];			// Copies of the 25 write-only SID registers
@@ -88,6 +97,12 @@ private:
 	int fake_v3_eg_state;			// Fake voice 3 EG state
 
 	uint32_t v3_random_seed = 1;	// Fake voice 3 noise RNG seed value
+
+	// The offline sound output file is kept here, so that it survives
+	// the renderer being recreated when the SID type changes
+	FILE * output_file = nullptr;	// File for offline sound output (instead of audio device)
+	bool output_wav = false;		// Flag: Output file is in WAV format (otherwise raw PCM)
+	uint32_t output_samples = 0;	// Number of samples written to output file
 };
 
 
@@ -97,6 +112,7 @@ public:
 	virtual ~SIDRenderer() {}
 	virtual void Reset() = 0;
 	virtual void EmulateLine() = 0;
+	virtual void EmulateFrame() = 0;
 	virtual void WriteRegister(uint16_t adr, uint8_t byte) = 0;
 	virtual void NewPrefs(const Prefs * prefs) = 0;
 	virtual void Pause() = 0;
@@ -220,6 +236,18 @@ inline void MOS6581::EmulateLine()
 }
 
 
+/*
+ *  Called once per frame, for renderers driven by the emulation
+ */
+
+inline void MOS6581::EmulateFrame()
+{
+	if (the_renderer != nullptr) {
+		the_renderer->EmulateFrame();
+	}
+}
+
+
 /*
  *  Read from register
  */
@@ -46,6 +46,7 @@ public:
 
 	void Reset() override;
 	void EmulateLine() override {}
+	void EmulateFrame() override {}
 	void WriteRegister(uint16_t adr, uint8_t byte) override;
 	void NewPrefs(const Prefs *prefs) override {}
 	void Pause() override {}
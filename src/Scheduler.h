@@ -0,0 +1,121 @@
+/*
+ *  Scheduler.h - Cycle-based scheduling of chips which are idle most of
+ *                the time (Frodo SC)
+ *
+ *  Frodo Copyright (C) Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Notes:
+ * ------
+ *
+ *  - A chip registered with the scheduler is either active, in which case
+ *    its EmulateCycle() function is called in every cycle, or asleep until
+ *    a given value of the C64 cycle counter. The chip decides by itself
+ *    when to go to sleep (by calling Sleep()) and is woken up either when
+ *    the wakeup cycle is reached or when another part of the emulation
+ *    calls Activate() because something happened which the chip has to
+ *    react to.
+ *  - A sleeping chip must be able to catch up with the skipped cycles in a
+ *    single step, so the result is identical to calling EmulateCycle() in
+ *    every cycle.
+ *  - Cycle numbers wrap around, so they are always compared relative to
+ *    each other. Sleeping "forever" is limited to SLEEP_FOREVER cycles,
+ *    after which the chip is woken up and has to go to sleep again.
+ *  - With only a handful of chips a linear search for the next wakeup
+ *    cycle is faster than a heap.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+
+// Chips handled by the scheduler
+enum SchedulerEvent {
+	EVENT_CIA1,		// CIA 1 timers and interrupts
+	EVENT_CIA2,		// CIA 2 timers and interrupts
+	EVENT_TAPE,		// Next tape read pulse
+
+	NUM_EVENTS
+};
+
+
+// Longest time a chip can sleep without being woken up (about 18 minutes)
+constexpr uint32_t SLEEP_FOREVER = 0x40000000;
+
+
+// Cycle scheduler
+class Scheduler {
+public:
+	Scheduler() { Reset(); }
+
+	// Activate all chips
+	void Reset()
+	{
+		active = (1 << NUM_EVENTS) - 1;
+		for (unsigned e = 0; e < NUM_EVENTS; ++e) {
+			wakeup_cycle[e] = 0;
+		}
+		next_wakeup = 0;
+	}
+
+	// Emulate chip in every cycle from now on
+	void Activate(SchedulerEvent e) { active |= 1 << e; }
+
+	// Don't emulate chip until the given cycle is reached
+	void Sleep(SchedulerEvent e, uint32_t now, uint32_t cycle)
+	{
+		active &= ~(1 << e);
+		wakeup_cycle[e] = cycle;
+
+		// Find nearest wakeup cycle of all sleeping chips
+		next_wakeup = now + SLEEP_FOREVER;
+		for (unsigned i = 0; i < NUM_EVENTS; ++i) {
+			if (!(active & (1 << i)) && int32_t(wakeup_cycle[i] - next_wakeup) < 0) {
+				next_wakeup = wakeup_cycle[i];
+			}
+		}
+	}
+
+	// Check whether all chips are asleep in the given cycle
+	bool AllAsleep(uint32_t now) const
+	{
+		return active == 0 && int32_t(now - next_wakeup) < 0;
+	}
+
+	// Check whether chip has to be emulated in the given cycle
+	bool IsActive(SchedulerEvent e, uint32_t now)
+	{
+		if (active & (1 << e))
+			return true;
+
+		if (int32_t(now - wakeup_cycle[e]) >= 0) {
+			active |= 1 << e;	// Wakeup cycle reached
+			return true;
+		}
+
+		return false;
+	}
+
+private:
+	unsigned active;						// Bit mask of active chips
+	uint32_t wakeup_cycle[NUM_EVENTS];		// Wakeup cycles of sleeping chips
+	uint32_t next_wakeup;					// Nearest wakeup cycle of all sleeping chips
+};
+
+
+#endif // ndef SCHEDULER_H
@@ -21,10 +21,12 @@
 #include "sysdeps.h"
 
 #include "Tape.h"
+#include "C64.h"
 #include "CIA.h"
 #include "IEC.h"
 #include "Prefs.h"
 
+#include <algorithm>
 #include <filesystem>
 namespace fs = std::filesystem;
 
@@ -32,27 +34,49 @@ namespace fs = std::filesystem;
 // Size of TAP image header in bytes
 constexpr unsigned TAP_HEADER_SIZE = 20;
 
+// Amount of recorded pulse data collected before writing it to the image file
+constexpr size_t WRITE_BUFFER_SIZE = 4096;
+
+// Pulse length limits for decoding the standard Kernal tape format
+// (short/medium/long pulses are nominally 0x30/0x42/0x56 TAP units)
+constexpr int KERNAL_PULSE_MIN = 0x20 * 8;
+constexpr int KERNAL_SHORT_MAX = 0x39 * 8;
+constexpr int KERNAL_MEDIUM_MAX = 0x4c * 8;
+constexpr int KERNAL_PULSE_MAX = 0x70 * 8;
+
+// Minimum number of short pulses before a Kernal block
+constexpr unsigned KERNAL_MIN_PILOT = 16;
+
+// Special return values of Tape::get_kernal_byte()
+constexpr int KERNAL_END_OF_DATA = -1;
+constexpr int KERNAL_BAD_BYTE = -2;
+
 
 /*
  *  Constructor: Open tape image file
  */
 
-Tape::Tape(MOS6526 * cia) : the_cia(cia), the_file(nullptr)
+Tape::Tape(C64 * c64, MOS6526 * cia) : the_c64(c64), the_cia(cia), the_file(nullptr)
 {
 	header_size = data_size = 0;
 	current_pos = 0;
 	write_protected = true;
 	file_extended = false;
 
+	pulse_index = 0;
+	pulses_valid = true;
+	write_pos = 0;
+
 	motor_on = false;
 	button_state = TapeState::Stop;
 	drive_state = TapeState::Stop;
 
-	read_pulse_length = -1;
+	read_pulse_pending = false;
+	read_pulse_cycle = 0;
 	write_cycle = 0;
 	first_write_pulse = true;
 
-	open_image_file(ThePrefs.TapePath);
+	open_image_file(the_c64->GetPrefs().TapePath);
 	Rewind();
 }
 
@@ -85,7 +109,7 @@ void Tape::Reset()
 void Tape::NewPrefs(const Prefs * prefs)
 {
 	// Image file name changed?
-	if (ThePrefs.TapePath != prefs->TapePath) {
+	if (the_c64->GetPrefs().TapePath != prefs->TapePath) {
 
 		// Swap tape
 		close_image_file();
@@ -143,6 +167,11 @@ void Tape::set_drive_state()
 	} else {
 		drive_state = TapeState::Stop;
 	}
+
+	// Write out recorded data when recording stops
+	if (drive_state != TapeState::Record) {
+		flush_writes();
+	}
 }
 
 
@@ -153,13 +182,13 @@ void Tape::set_drive_state()
 void Tape::Rewind()
 {
 	if (the_file != nullptr) {
-		current_pos = header_size;
-		fseek(the_file, current_pos, SEEK_SET);
+		seek(header_size);
 	}
 
 	SetButtons(TapeState::Stop);	// Stop after rewind
 
-	read_pulse_length = -1;
+	read_pulse_pending = false;
+	sleep();
 }
 
 
@@ -170,13 +199,13 @@ void Tape::Rewind()
 void Tape::Forward()
 {
 	if (the_file != nullptr) {
-		current_pos = header_size + data_size;
-		fseek(the_file, current_pos, SEEK_SET);
+		seek(header_size + data_size);
 	}
 
 	SetButtons(TapeState::Stop);	// Stop after forwarding
 
-	read_pulse_length = -1;
+	read_pulse_pending = false;
+	sleep();
 }
 
 
@@ -246,6 +275,8 @@ void Tape::open_image_file(const std::string & filepath)
 	          | (header[16] <<  0);
 	write_protected = read_only;
 	file_extended = false;
+
+	decode_pulses();
 	return;
 
 error:
@@ -262,6 +293,8 @@ error:
 void Tape::close_image_file()
 {
 	if (the_file != nullptr) {
+		flush_writes();
+
 		if (file_extended) {
 
 			// Write new data size to header
@@ -280,6 +313,13 @@ void Tape::close_image_file()
 	current_pos = 0;
 	write_protected = true;
 	file_extended = false;
+
+	pulse_length.clear();
+	pulse_length.shrink_to_fit();
+	pulse_pos.clear();
+	pulse_pos.shrink_to_fit();
+	pulse_index = 0;
+	pulses_valid = true;
 }
 
 
@@ -312,75 +352,204 @@ bool CreateTapeImageFile(const std::string & path)
 
 
 /*
- *  Schedule next tape read pulse
+ *  Read pulse data of image file and decode it into a list of pulse lengths
  */
 
-void Tape::schedule_read_pulse()
+void Tape::decode_pulses()
+{
+	pulse_length.clear();
+	pulse_pos.clear();
+
+	// Read complete pulse data
+	fseek(the_file, 0, SEEK_END);
+	int64_t file_size = ftell(the_file);
+	size_t size = std::clamp<int64_t>(file_size - header_size, 0, data_size);
+
+	std::vector<uint8_t> data(size);
+	fseek(the_file, header_size, SEEK_SET);
+	size_t actual = fread(data.data(), 1, data.size(), the_file);
+	data.resize(actual);
+
+	// Decode pulses
+	pulse_length.reserve(actual);
+	pulse_pos.reserve(actual + 1);
+
+	size_t i = 0;
+	while (i < actual) {
+		uint32_t pos = i;
+		uint8_t byte = data[i++];
+
+		if (byte) {
+
+			// Regular short pulse
+			pulse_length.push_back(byte * 8);
+
+		} else if (tap_version == 1) {
+
+			// Long pulse
+			if (i + 3 > actual) {
+				i = pos;	// Incomplete pulse at end of file
+				break;
+			}
+			pulse_length.push_back((data[i + 2] << 16) | (data[i + 1] << 8) | data[i]);
+			i += 3;
+
+		} else {
+
+			// Overflow pulse
+			pulse_length.push_back(1024 * 8);
+		}
+
+		pulse_pos.push_back(header_size + pos);
+	}
+
+	pulse_pos.push_back(header_size + i);	// End of tape
+	pulses_valid = true;
+}
+
+
+/*
+ *  Make decoded pulses consistent with recorded data
+ */
+
+void Tape::update_pulses()
+{
+	flush_writes();
+
+	if (! pulses_valid) {
+		decode_pulses();
+		seek(current_pos);
+	}
+}
+
+
+/*
+ *  Set tape position in image file
+ */
+
+void Tape::seek(uint32_t pos)
+{
+	update_pulses();
+
+	current_pos = pos;
+
+	// Start reading at the first pulse at or after the given position
+	pulse_index = std::lower_bound(pulse_pos.begin(), pulse_pos.end() - 1, pos) - pulse_pos.begin();
+}
+
+
+/*
+ *  Write buffered pulse data to image file
+ */
+
+void Tape::flush_writes()
+{
+	if (write_buffer.empty())
+		return;
+
+	fseek(the_file, write_pos, SEEK_SET);
+	fwrite(write_buffer.data(), 1, write_buffer.size(), the_file);
+	write_buffer.clear();
+}
+
+
+/*
+ *  Get next pulse, returns length in cycles or -1 at end of tape
+ */
+
+int Tape::get_pulse()
+{
+	if (! pulses_valid) {
+		update_pulses();
+	}
+
+	if (pulse_index >= pulse_length.size())
+		return -1;
+
+	int length = pulse_length[pulse_index++];
+	current_pos = pulse_pos[pulse_index];
+	return length;
+}
+
+
+/*
+ *  Schedule next tape read pulse. If after_pulse is true, the function is
+ *  called at the end of a cycle in which the previous pulse was triggered,
+ *  otherwise it is called by the CPU or between cycles.
+ */
+
+void Tape::schedule_read_pulse(bool after_pulse)
 {
 	// Tape playing?
 	if (the_file == nullptr || drive_state != TapeState::Play) {
-		read_pulse_length = -1;
+		read_pulse_pending = false;
+		sleep();
 		return;
 	}
 
 	// Pulse pending?
-	if (read_pulse_length > 0) {
+	if (read_pulse_pending) {
 		return;
 	}
 
 	// Get next pulse from image file
-	int byte = getc(the_file);
-	if (byte == EOF) {
-eot:	SetButtons(TapeState::Stop);	// Stop at end of tape
+	int pulse_length = get_pulse();
+	if (pulse_length < 0) {
+		SetButtons(TapeState::Stop);	// Stop at end of tape
 		return;
 	}
-	++current_pos;
-
-	if (byte) {
 
-		// Regular short pulse
-		read_pulse_length += byte * 8;
+	// A pulse following a triggered pulse is counted from the next cycle.
+	// Otherwise, counting starts in the current cycle and the pulse is one
+	// cycle shorter. Zero-length pulses stop the pulse stream.
+	uint32_t now = the_c64->CycleCounter();
+	if (after_pulse) {
+		read_pulse_pending = pulse_length > 0;
+		read_pulse_cycle = now + pulse_length;
+	} else {
+		read_pulse_pending = pulse_length > 1;
+		read_pulse_cycle = now + pulse_length - 2;
+	}
+	sleep();
+}
 
-	} else if (tap_version == 1) {
 
-		// Long pulse
-		int lo = getc(the_file);
-		if (lo == EOF)
-			goto eot;
-		++current_pos;
+/*
+ *  Trigger CIA and get next pulse length
+ */
 
-		int mid = getc(the_file);
-		if (mid == EOF)
-			goto eot;
-		++current_pos;
+void Tape::trigger_read_pulse()
+{
+	the_cia->TriggerFlagLine();
+	schedule_read_pulse(true);
+}
 
-		int hi = getc(the_file);
-		if (hi == EOF)
-			goto eot;
-		++current_pos;
 
-		read_pulse_length += (hi << 16) | (mid << 8) | lo;
+/*
+ *  Check for tape pulse (called by the scheduler)
+ */
 
+void Tape::EmulateCycle()
+{
+	if (read_pulse_pending && the_c64->CycleCounter() == read_pulse_cycle) {
+		read_pulse_pending = false;
+		trigger_read_pulse();
 	} else {
-
-		// Overflow pulse
-		read_pulse_length += 1024 * 8;
-	}
-
-	if (read_pulse_length < 0) {
-		read_pulse_length = 0;
+		sleep();
 	}
 }
 
 
 /*
- *  Trigger CIA and get next pulse length
+ *  Suspend tape emulation until next scheduled read pulse
  */
 
-void Tape::trigger_read_pulse()
+void Tape::sleep()
 {
-	the_cia->TriggerFlagLine();
-	schedule_read_pulse();
+#ifdef FRODO_SC
+	uint32_t now = the_c64->CycleCounter();
+	the_c64->TheScheduler.Sleep(EVENT_TAPE, now, read_pulse_pending ? read_pulse_cycle : now + SLEEP_FOREVER);
+#endif
 }
 
 
@@ -410,37 +579,38 @@ void Tape::WritePulse(uint32_t cycle)
 		if (pulse_length < 8)
 			return;
 
+		if (write_buffer.empty()) {
+			write_pos = current_pos;
+		}
+
 		if (pulse_length <= 255 * 8) {
 
 			// Regular short pulse
-			if (putc(pulse_length / 8, the_file) == EOF)
-				return;
-			++current_pos;
+			write_buffer.push_back(pulse_length / 8);
 
 		} else {
 
 			// Long pulse
-			if (putc(0, the_file) == EOF)
-				return;
-			++current_pos;
+			write_buffer.push_back(0);
 
 			if (tap_version == 1) {
 				if (pulse_length > 0xffffff) {
 					pulse_length = 0xffffff;
 				}
 
-				if (putc((pulse_length >>  0) & 0xff, the_file) == EOF)
-					return;
-				++current_pos;
-				if (putc((pulse_length >>  8) & 0xff, the_file) == EOF)
-					return;
-				++current_pos;
-				if (putc((pulse_length >> 16) & 0xff, the_file) == EOF)
-					return;
-				++current_pos;
+				write_buffer.push_back((pulse_length >>  0) & 0xff);
+				write_buffer.push_back((pulse_length >>  8) & 0xff);
+				write_buffer.push_back((pulse_length >> 16) & 0xff);
 			}
 		}
 
+		current_pos = write_pos + write_buffer.size();
+		pulses_valid = false;
+
+		if (write_buffer.size() >= WRITE_BUFFER_SIZE) {
+			flush_writes();
+		}
+
 		if (current_pos > header_size + data_size) {
 			data_size = current_pos - header_size;
 			file_extended = true;
@@ -456,7 +626,11 @@ void Tape::WritePulse(uint32_t cycle)
 void Tape::GetState(TapeSaveState * s) const
 {
 	s->current_pos = current_pos;
-	s->read_pulse_length = read_pulse_length;
+	if (read_pulse_pending) {
+		s->read_pulse_length = read_pulse_cycle - the_c64->CycleCounter() + 1;
+	} else {
+		s->read_pulse_length = -1;
+	}
 	s->write_cycle = write_cycle;
 	s->first_write_pulse = first_write_pulse;
 	s->button_state = button_state;
@@ -477,12 +651,189 @@ void Tape::SetState(const TapeSaveState * s)
 		if (current_pos > header_size + data_size) {
 			current_pos = header_size + data_size;
 		}
-		fseek(the_file, current_pos, SEEK_SET);
+		seek(current_pos);
 
-		read_pulse_length = s->read_pulse_length;
+		read_pulse_pending = s->read_pulse_length > 0;
+		read_pulse_cycle = the_c64->CycleCounter() + s->read_pulse_length - 1;
 		write_cycle = s->write_cycle;
 		first_write_pulse = s->first_write_pulse;
 
 		SetButtons(s->button_state);
+		sleep();
+	}
+}
+
+
+/*
+ *  Decode the standard Kernal tape format:
+ *
+ *  Bits are stored as pairs of short and medium pulses (S-M = 0, M-S = 1).
+ *  Each byte starts with a L-M marker, followed by 8 data bits (LSB first)
+ *  and an odd parity bit. A block consists of a pilot tone of short pulses,
+ *  a countdown sequence ($89..$81 for the first copy, $09..$01 for the
+ *  repeated copy), the data bytes, a checksum (XOR of the data bytes), and
+ *  a L-S end-of-data marker. Every block is recorded twice.
+ */
+
+// Classify pulse: 0 = short, 1 = medium, 2 = long, -1 = invalid
+static int kernal_pulse_type(int length)
+{
+	if (length < KERNAL_PULSE_MIN || length > KERNAL_PULSE_MAX) {
+		return -1;
+	} else if (length <= KERNAL_SHORT_MAX) {
+		return 0;
+	} else if (length <= KERNAL_MEDIUM_MAX) {
+		return 1;
+	} else {
+		return 2;
+	}
+}
+
+// Read byte following a long marker pulse, returns byte value,
+// KERNAL_END_OF_DATA, or KERNAL_BAD_BYTE
+int Tape::get_kernal_byte()
+{
+	int marker = kernal_pulse_type(get_pulse());
+	if (marker == 0) {
+		return KERNAL_END_OF_DATA;
+	} else if (marker != 1) {
+		return KERNAL_BAD_BYTE;
+	}
+
+	unsigned byte = 0;
+	unsigned parity = 1;
+	for (unsigned i = 0; i < 9; ++i) {
+		int first = kernal_pulse_type(get_pulse());
+		int second = kernal_pulse_type(get_pulse());
+		unsigned bit;
+		if (first == 0 && second == 1) {
+			bit = 0;
+		} else if (first == 1 && second == 0) {
+			bit = 1;
+		} else {
+			return KERNAL_BAD_BYTE;
+		}
+
+		if (i < 8) {
+			byte |= bit << i;
+		}
+		parity ^= bit;
+	}
+
+	return parity == 0 ? byte : KERNAL_BAD_BYTE;
+}
+
+// Read block copy following a long marker pulse, returns false on error
+bool Tape::get_kernal_block(std::vector<uint8_t> & data, bool & repeated)
+{
+	// Countdown sequence
+	int first = get_kernal_byte();
+	if (first != 0x89 && first != 0x09)
+		return false;
+	repeated = first == 0x09;
+
+	for (int expected = first - 1; expected > (first & 0x80); --expected) {
+		if (kernal_pulse_type(get_pulse()) != 2 || get_kernal_byte() != expected)
+			return false;
+	}
+
+	// Data bytes and checksum
+	data.clear();
+	uint8_t checksum = 0;
+	while (true) {
+		if (kernal_pulse_type(get_pulse()) != 2)
+			return false;
+		int byte = get_kernal_byte();
+		if (byte == KERNAL_END_OF_DATA) {
+			break;
+		} else if (byte == KERNAL_BAD_BYTE) {
+			return false;
+		}
+		data.push_back(byte);
+		checksum ^= byte;
+	}
+
+	if (data.empty() || checksum != 0)
+		return false;
+
+	data.pop_back();	// Remove checksum
+	return true;
+}
+
+
+/*
+ *  Read next standard Kernal tape block from the current tape position,
+ *  skipping its repeated copy (for fast loading). Returns false if no valid
+ *  block was found, in which case the tape position remains unchanged.
+ */
+
+bool Tape::ReadKernalBlock(std::vector<uint8_t> & data)
+{
+	if (the_file == nullptr || button_state != TapeState::Play)
+		return false;
+
+	update_pulses();
+
+	size_t start_index = pulse_index;
+	bool found = false;
+	bool first_copy_found = false;
+	size_t end_index = start_index;
+
+	unsigned pilot = 0;
+	while (true) {
+		int type = kernal_pulse_type(get_pulse());
+		if (type == 0) {
+			++pilot;
+			continue;
+		}
+
+		if (type == 2 && pilot >= KERNAL_MIN_PILOT) {
+
+			// Possible start of block
+			std::vector<uint8_t> block;
+			bool repeated;
+			if (get_kernal_block(block, repeated)) {
+				if (first_copy_found) {
+
+					// Repeated copy of block already found
+					if (repeated) {
+						end_index = pulse_index;
+					}
+					break;
+
+				} else if (repeated) {
+
+					// First copy was damaged
+					data = block;
+					found = true;
+					end_index = pulse_index;
+					break;
+
+				} else {
+
+					// Look for repeated copy to skip it
+					data = block;
+					found = first_copy_found = true;
+					end_index = pulse_index;
+				}
+			} else if (first_copy_found) {
+				break;	// Repeated copy damaged or missing
+			}
+		} else if (type < 0 && first_copy_found) {
+			break;		// Gap after first copy
+		}
+
+		if (pulse_index >= pulse_length.size())
+			break;
+		pilot = 0;
 	}
+
+	// Position tape after block
+	if (! found) {
+		end_index = start_index;
+	}
+	pulse_index = end_index;
+	current_pos = pulse_pos[pulse_index];
+
+	return found;
 }
@@ -22,6 +22,7 @@
 #define TAPE_H
 
 #include <string>
+#include <vector>
 
 
 // Tape button/mechanism state
@@ -32,6 +33,7 @@ enum class TapeState {
 };
 
 
+class C64;
 class MOS6526;
 class Prefs;
 struct TapeSaveState;
@@ -40,7 +42,7 @@ struct TapeSaveState;
 // Datasette emulation
 class Tape {
 public:
-	Tape(MOS6526 * cia);
+	Tape(C64 * c64, MOS6526 * cia);
 	~Tape();
 
 	void Reset();
@@ -64,15 +66,28 @@ public:
 
 	void WritePulse(uint32_t cycle);
 
+	bool ReadKernalBlock(std::vector<uint8_t> & data);
+
 private:
 	void set_drive_state();
 
 	void open_image_file(const std::string & filepath);
 	void close_image_file();
 
-	void schedule_read_pulse();
+	void decode_pulses();
+	void update_pulses();
+	void seek(uint32_t pos);
+	void flush_writes();
+
+	int get_pulse();
+	int get_kernal_byte();
+	bool get_kernal_block(std::vector<uint8_t> & data, bool & repeated);
+
+	void schedule_read_pulse(bool after_pulse = false);
 	void trigger_read_pulse();
+	void sleep();
 
+	C64 * the_c64;			// Pointer to C64 object
 	MOS6526 * the_cia;		// Pointer to CIA object
 
 	FILE * the_file;		// File pointer for image file
@@ -84,11 +99,20 @@ private:
 
 	uint32_t current_pos;	// Current position in image file
 
+	std::vector<uint32_t> pulse_length;	// Pulse lengths in cycles, decoded from image file
+	std::vector<uint32_t> pulse_pos;	// Position of each pulse in image file (plus end position)
+	size_t pulse_index;		// Index of next pulse to be read
+	bool pulses_valid;		// Flag: Decoded pulses match image file contents
+
+	std::vector<uint8_t> write_buffer;	// Pulse data not yet written to image file
+	uint32_t write_pos;		// Position in image file of buffered pulse data
+
 	bool motor_on;			// Flag: Tape motor on
 	TapeState button_state;	// Tape button state
 	TapeState drive_state;	// Tape drive mechanism state
 
-	int read_pulse_length;	// Remaining number of cycles in next read pulse (-1 = no pulse pending)
+	bool read_pulse_pending;	// Flag: Read pulse scheduled
+	uint32_t read_pulse_cycle;	// Cycle in which the scheduled read pulse is triggered
 	uint32_t write_cycle;	// Cycle of last write pulse
 	bool first_write_pulse;	// Flag: Waiting for first write pulse to determine length
 };
@@ -105,22 +129,6 @@ struct TapeSaveState {
 };
 
 
-/*
- *  Check for tape pulse
- */
-
-inline void Tape::EmulateCycle()
-{
-	if (read_pulse_length < 0)
-		return;
-
-	--read_pulse_length;
-	if (read_pulse_length == 0) {
-		trigger_read_pulse();
-	}
-}
-
-
 /*
  *  Functions
  */
@@ -23,10 +23,21 @@
  * ------
  *
  *  - The EmulateLine() function is called for every emulated
- *    raster line. It computes one pixel row of the graphics
- *    according to the current VIC register settings and returns
- *    the number of cycles available for the CPU in that line.
+ *    raster line. It captures the VIC registers and graphics
+ *    data needed for drawing one pixel row of the graphics,
+ *    and returns the number of cycles available for the CPU
+ *    in that line.
+ *  - The captured lines are drawn by draw_line(), either
+ *    immediately or in batches by a separate draw thread which
+ *    finishes the frame before the VBlank. Frames which are not
+ *    displayed are not drawn at all. Sprite collisions are
+ *    always detected in EmulateLine() because the CPU can read
+ *    them.
  *  - The graphics are output into an 8 bit chunky bitmap
+ *  - The graphics data of the 40 characters of a line is
+ *    expanded into pixels by functions that are selected at
+ *    run-time for the host CPU (SSE2, AVX2, NEON, or portable
+ *    C++).
  *  - The sprite-graphics priority handling and collision
  *    detection is done in a bit-oriented way with masks.
  *    The foreground/background pixel mask for the graphics
@@ -35,9 +46,11 @@
  *    to a bitplane representation (two bit masks) for easier
  *    handling of priorities and collisions.
  *  - The sprite-sprite priority handling and collision
- *    detection is done in with the byte array spr_coll_buf[],
- *    that is used to keep track of which sprites are already
- *    visible at certain X positions.
+ *    detection is also done with bit masks. The pixels of
+ *    each sprite in a line are stored in a 64 bit mask which
+ *    is compared with the shifted masks of the sprites with
+ *    higher priority, so pixels only have to be touched where
+ *    sprites are actually drawn.
  *
  * Incompatibilities:
  * ------------------
@@ -63,6 +76,17 @@
 #include "Display.h"
 #include "Prefs.h"
 
+#include <bit>
+#include <mutex>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SSE2_EXPANSION 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON_EXPANSION 1
+#endif
+
 
 // Test alignment on run-time for processors that can't access unaligned:
 #undef ALIGNMENT_CHECK
@@ -86,6 +110,9 @@ const int COL40_XSTOP = 0x160;
 const int COL38_XSTART = 0x27;
 const int COL38_XSTOP = 0x157;
 
+// Number of lines handed over to the draw thread at once
+const unsigned DRAW_BATCH_LINES = 16;
+
 
 // Tables for sprite X expansion
 uint16_t ExpTable[256] = {
@@ -166,26 +193,287 @@ static union {
 } TextColorTable[16][16][256][2];
 
 
+/*
+ *  Expand 40 characters of standard mode graphics data into 320 pixels
+ *  (set bits use the color from fg[], cleared bits the one from bg[]),
+ *  portable version
+ */
+
+static void expand_std_generic(uint8_t * p, const uint8_t * data, const uint8_t * fg, const uint8_t * bg)
+{
+	uint32_t *lp = (uint32_t *)p;
+
+	for (unsigned i = 0; i < 40; ++i) {
+		*lp++ = TextColorTable[fg[i]][bg[i]][data[i]][0].b;
+		*lp++ = TextColorTable[fg[i]][bg[i]][data[i]][1].b;
+	}
+}
+
+
+/*
+ *  Expand 40 characters of multicolor graphics data into 320 pixels
+ *  (bit pairs select one of the colors c0..c3 where multi[] is 0xff;
+ *  characters with a zero multi[] entry are displayed in standard mode
+ *  with colors c3 and c0), portable version
+ */
+
+static void expand_multi_generic(uint8_t * p, const uint8_t * data, const uint8_t * multi, const uint8_t * c0, const uint8_t * c1, const uint8_t * c2, const uint8_t * c3)
+{
+	uint16_t *wp = (uint16_t *)p;
+
+	for (unsigned i = 0; i < 40; ++i) {
+		uint8_t d = data[i];
+
+		if (multi[i]) {
+			uint16_t lookup[4];
+			lookup[0] = c0[i] * 0x0101;
+			lookup[1] = c1[i] * 0x0101;
+			lookup[2] = c2[i] * 0x0101;
+			lookup[3] = c3[i] * 0x0101;
+			*wp++ = lookup[(d >> 6) & 3];
+			*wp++ = lookup[(d >> 4) & 3];
+			*wp++ = lookup[(d >> 2) & 3];
+			*wp++ = lookup[(d >> 0) & 3];
+		} else {
+			*(uint32_t *)wp = TextColorTable[c3[i]][c0[i]][d][0].b;
+			wp += 2;
+			*(uint32_t *)wp = TextColorTable[c3[i]][c0[i]][d][1].b;
+			wp += 2;
+		}
+	}
+}
+
+
+#if defined(HAVE_SSE2_EXPANSION)
+/*
+ *  Graphics expansion, SSE2 and AVX2 versions
+ *
+ *  The data and color bytes of each character are replicated to the
+ *  8 pixels of the character, and the pixel colors are selected by
+ *  comparing the data with the bit (or bit pair) of each pixel.
+ */
+
+// Replicate each of the lower 8 bytes of v 8 times, giving 64 bytes
+__attribute__((target("sse2")))
+static inline void replicate8_sse2(__m128i v, __m128i out[4])
+{
+	v = _mm_unpacklo_epi8(v, v);
+	__m128i lo = _mm_unpacklo_epi16(v, v);
+	__m128i hi = _mm_unpackhi_epi16(v, v);
+	out[0] = _mm_unpacklo_epi32(lo, lo);
+	out[1] = _mm_unpackhi_epi32(lo, lo);
+	out[2] = _mm_unpacklo_epi32(hi, hi);
+	out[3] = _mm_unpackhi_epi32(hi, hi);
+}
+
+// Select bytes from a where mask is set, otherwise from b
+__attribute__((target("sse2")))
+static inline __m128i select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__attribute__((target("sse2")))
+static void expand_std_sse2(uint8_t * p, const uint8_t * data, const uint8_t * fg, const uint8_t * bg)
+{
+	const __m128i bits = _mm_setr_epi8((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                   (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+	for (unsigned i = 0; i < 40; i += 8) {
+		__m128i d[4], f[4], b[4];
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (data + i)), d);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (fg + i)), f);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (bg + i)), b);
+
+		for (unsigned k = 0; k < 4; ++k) {
+			__m128i m = _mm_cmpeq_epi8(_mm_and_si128(d[k], bits), bits);
+			_mm_storeu_si128((__m128i *) (p + i * 8 + k * 16), select_sse2(m, f[k], b[k]));
+		}
+	}
+}
+
+__attribute__((target("sse2")))
+static void expand_multi_sse2(uint8_t * p, const uint8_t * data, const uint8_t * multi, const uint8_t * c0, const uint8_t * c1, const uint8_t * c2, const uint8_t * c3)
+{
+	const __m128i bits = _mm_setr_epi8((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                   (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i hi_bits = _mm_setr_epi8((char) 0x80, (char) 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02,
+	                                      (char) 0x80, (char) 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02);
+	const __m128i lo_bits = _mm_setr_epi8(0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01,
+	                                      0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01);
+
+	for (unsigned i = 0; i < 40; i += 8) {
+		__m128i d[4], mc[4], a[4], b[4], c[4], e[4];
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (data + i)), d);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (multi + i)), mc);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (c0 + i)), a);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (c1 + i)), b);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (c2 + i)), c);
+		replicate8_sse2(_mm_loadl_epi64((const __m128i *) (c3 + i)), e);
+
+		for (unsigned k = 0; k < 4; ++k) {
+			__m128i hb = select_sse2(mc[k], hi_bits, bits);
+			__m128i lb = select_sse2(mc[k], lo_bits, bits);
+			__m128i hm = _mm_cmpeq_epi8(_mm_and_si128(d[k], hb), hb);
+			__m128i lm = _mm_cmpeq_epi8(_mm_and_si128(d[k], lb), lb);
+			__m128i pix = select_sse2(hm, select_sse2(lm, e[k], c[k]), select_sse2(lm, b[k], a[k]));
+			_mm_storeu_si128((__m128i *) (p + i * 8 + k * 16), pix);
+		}
+	}
+}
+
+// Replicate each of the 4 bytes at src 8 times, giving 32 bytes
+__attribute__((target("avx2")))
+static inline __m256i replicate4_avx2(const uint8_t * src)
+{
+	const __m256i idx = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+	                                     2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	uint32_t v;
+	memcpy(&v, src, 4);
+	return _mm256_shuffle_epi8(_mm256_set1_epi32(v), idx);
+}
+
+__attribute__((target("avx2")))
+static void expand_std_avx2(uint8_t * p, const uint8_t * data, const uint8_t * fg, const uint8_t * bg)
+{
+	const __m256i bits = _mm256_setr_epi8((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                      (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                      (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                      (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+	for (unsigned i = 0; i < 40; i += 4) {
+		__m256i d = replicate4_avx2(data + i);
+		__m256i m = _mm256_cmpeq_epi8(_mm256_and_si256(d, bits), bits);
+		__m256i pix = _mm256_blendv_epi8(replicate4_avx2(bg + i), replicate4_avx2(fg + i), m);
+		_mm256_storeu_si256((__m256i *) (p + i * 8), pix);
+	}
+}
+
+__attribute__((target("avx2")))
+static void expand_multi_avx2(uint8_t * p, const uint8_t * data, const uint8_t * multi, const uint8_t * c0, const uint8_t * c1, const uint8_t * c2, const uint8_t * c3)
+{
+	const __m256i bits = _mm256_setr_epi8((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                      (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                      (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+	                                      (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m256i hi_bits = _mm256_setr_epi8((char) 0x80, (char) 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02,
+	                                         (char) 0x80, (char) 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02,
+	                                         (char) 0x80, (char) 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02,
+	                                         (char) 0x80, (char) 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02);
+	const __m256i lo_bits = _mm256_setr_epi8(0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01,
+	                                         0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01,
+	                                         0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01,
+	                                         0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01);
+
+	for (unsigned i = 0; i < 40; i += 4) {
+		__m256i d = replicate4_avx2(data + i);
+		__m256i mc = replicate4_avx2(multi + i);
+		__m256i hb = _mm256_blendv_epi8(bits, hi_bits, mc);
+		__m256i lb = _mm256_blendv_epi8(bits, lo_bits, mc);
+		__m256i hm = _mm256_cmpeq_epi8(_mm256_and_si256(d, hb), hb);
+		__m256i lm = _mm256_cmpeq_epi8(_mm256_and_si256(d, lb), lb);
+		__m256i lo = _mm256_blendv_epi8(replicate4_avx2(c0 + i), replicate4_avx2(c1 + i), lm);
+		__m256i hi = _mm256_blendv_epi8(replicate4_avx2(c2 + i), replicate4_avx2(c3 + i), lm);
+		_mm256_storeu_si256((__m256i *) (p + i * 8), _mm256_blendv_epi8(lo, hi, hm));
+	}
+}
+#endif
+
+
+#if defined(HAVE_NEON_EXPANSION)
+/*
+ *  Graphics expansion, NEON versions (see above)
+ */
+
+// Replicate each of the 8 bytes of v 8 times, giving 64 bytes
+static inline void replicate8_neon(uint8x8_t v, uint8x16_t out[4])
+{
+	static const uint8_t idx[4][16] = {
+		{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1},
+		{2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3},
+		{4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5},
+		{6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7}
+	};
+	uint8x16_t v2 = vcombine_u8(v, v);
+	for (unsigned k = 0; k < 4; ++k) {
+		out[k] = vqtbl1q_u8(v2, vld1q_u8(idx[k]));
+	}
+}
+
+static void expand_std_neon(uint8_t * p, const uint8_t * data, const uint8_t * fg, const uint8_t * bg)
+{
+	static const uint8_t bit_tab[16] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+	const uint8x16_t bits = vld1q_u8(bit_tab);
+
+	for (unsigned i = 0; i < 40; i += 8) {
+		uint8x16_t d[4], f[4], b[4];
+		replicate8_neon(vld1_u8(data + i), d);
+		replicate8_neon(vld1_u8(fg + i), f);
+		replicate8_neon(vld1_u8(bg + i), b);
+
+		for (unsigned k = 0; k < 4; ++k) {
+			uint8x16_t m = vtstq_u8(d[k], bits);
+			vst1q_u8(p + i * 8 + k * 16, vbslq_u8(m, f[k], b[k]));
+		}
+	}
+}
+
+static void expand_multi_neon(uint8_t * p, const uint8_t * data, const uint8_t * multi, const uint8_t * c0, const uint8_t * c1, const uint8_t * c2, const uint8_t * c3)
+{
+	static const uint8_t bit_tab[16] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+	static const uint8_t hi_tab[16] = {0x80, 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02, 0x80, 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02};
+	static const uint8_t lo_tab[16] = {0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01, 0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01};
+	const uint8x16_t bits = vld1q_u8(bit_tab);
+	const uint8x16_t hi_bits = vld1q_u8(hi_tab);
+	const uint8x16_t lo_bits = vld1q_u8(lo_tab);
+
+	for (unsigned i = 0; i < 40; i += 8) {
+		uint8x16_t d[4], mc[4], a[4], b[4], c[4], e[4];
+		replicate8_neon(vld1_u8(data + i), d);
+		replicate8_neon(vld1_u8(multi + i), mc);
+		replicate8_neon(vld1_u8(c0 + i), a);
+		replicate8_neon(vld1_u8(c1 + i), b);
+		replicate8_neon(vld1_u8(c2 + i), c);
+		replicate8_neon(vld1_u8(c3 + i), e);
+
+		for (unsigned k = 0; k < 4; ++k) {
+			uint8x16_t hb = vbslq_u8(mc[k], hi_bits, bits);
+			uint8x16_t lb = vbslq_u8(mc[k], lo_bits, bits);
+			uint8x16_t hm = vtstq_u8(d[k], hb);
+			uint8x16_t lm = vtstq_u8(d[k], lb);
+			uint8x16_t pix = vbslq_u8(hm, vbslq_u8(lm, e[k], c[k]), vbslq_u8(lm, b[k], a[k]));
+			vst1q_u8(p + i * 8 + k * 16, pix);
+		}
+	}
+}
+#endif
+
+
 /*
  *  Constructor: Initialize variables
  */
 
-static void init_text_color_table(uint8_t *colors)
+// The table only depends on the (one-to-one) VIC palette, so it is
+// shared by all instances and built by the first one
+static void init_text_color_table()
 {
-	for (int i = 0; i < 16; i++) {
-		for (int j = 0; j < 16; j++) {
-			for (int k = 0; k < 256; k++) {
-				TextColorTable[i][j][k][0].a.a = colors[k & 128 ? i : j];
-				TextColorTable[i][j][k][0].a.b = colors[k & 64 ? i : j];
-				TextColorTable[i][j][k][0].a.c = colors[k & 32 ? i : j];
-				TextColorTable[i][j][k][0].a.d = colors[k & 16 ? i : j];
-				TextColorTable[i][j][k][1].a.a = colors[k & 8 ? i : j];
-				TextColorTable[i][j][k][1].a.b = colors[k & 4 ? i : j];
-				TextColorTable[i][j][k][1].a.c = colors[k & 2 ? i : j];
-				TextColorTable[i][j][k][1].a.d = colors[k & 1 ? i : j];
+	static std::once_flag table_built;
+	std::call_once(table_built, [] {
+		for (int i = 0; i < 16; i++) {
+			for (int j = 0; j < 16; j++) {
+				for (int k = 0; k < 256; k++) {
+					TextColorTable[i][j][k][0].a.a = k & 128 ? i : j;
+					TextColorTable[i][j][k][0].a.b = k & 64 ? i : j;
+					TextColorTable[i][j][k][0].a.c = k & 32 ? i : j;
+					TextColorTable[i][j][k][0].a.d = k & 16 ? i : j;
+					TextColorTable[i][j][k][1].a.a = k & 8 ? i : j;
+					TextColorTable[i][j][k][1].a.b = k & 4 ? i : j;
+					TextColorTable[i][j][k][1].a.c = k & 2 ? i : j;
+					TextColorTable[i][j][k][1].a.d = k & 1 ? i : j;
+				}
 			}
 		}
-	}
+	});
 }
 
 MOS6569::MOS6569(C64 *c64, Display *disp, MOS6510 *CPU, uint8_t *RAM, uint8_t *Char, uint8_t *Color)
@@ -232,7 +520,7 @@ MOS6569::MOS6569(C64 *c64, Display *disp, MOS6510 *CPU, uint8_t *RAM, uint8_t *C
 	}
 
 	// Clear foreground mask
-	memset(fore_mask_buf, 0, DISPLAY_X/8);
+	memset(fore_mask_buf, 0, sizeof(fore_mask_buf));
 
 	// Set one-to-one palette for VIC
 	// TODO: This is obsolete code for direct access to indexed frame
@@ -242,24 +530,62 @@ MOS6569::MOS6569(C64 *c64, Display *disp, MOS6510 *CPU, uint8_t *RAM, uint8_t *C
 	}
 
 	// Preset colors to black
-	init_text_color_table(colors);
+	init_text_color_table();
 	ec_color = b0c_color = b1c_color = b2c_color = b3c_color = mm0_color = mm1_color = colors[0];
-	ec_color_long = (ec_color << 24) | (ec_color << 16) | (ec_color << 8) | ec_color;
 	for (unsigned i = 0; i < 8; ++i) {
 		spr_color[i] = colors[0];
 	}
+
+	// Select graphics expansion functions
+#if defined(HAVE_SSE2_EXPANSION)
+	if (__builtin_cpu_supports("avx2")) {
+		expand_std = expand_std_avx2;
+		expand_multi = expand_multi_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		expand_std = expand_std_sse2;
+		expand_multi = expand_multi_sse2;
+	} else {
+		expand_std = expand_std_generic;
+		expand_multi = expand_multi_generic;
+	}
+#elif defined(HAVE_NEON_EXPANSION)
+	expand_std = expand_std_neon;
+	expand_multi = expand_multi_neon;
+#else
+	expand_std = expand_std_generic;
+	expand_multi = expand_multi_generic;
+#endif
+
+	// Allocate line capture buffer
+	frame_visible = true;
+	line_cmds.resize(LAST_DISP_LINE - FIRST_DISP_LINE + 1);
+	num_line_cmds = 0;
+
+	// Start draw thread if desired
+	lines_submitted = lines_drawn = 0;
+	draw_quit = false;
+	memset(draw_fore_mask_buf, 0, sizeof(draw_fore_mask_buf));
+
+	if (c64->GetPrefs().RenderThread && std::thread::hardware_concurrency() > 1) {
+		draw_thread = std::thread(&MOS6569::draw_thread_func, this);
+	}
 }
 
 
 /*
- *  Init multicolor lookup table
+ *  Destructor: Stop draw thread
  */
 
-void MOS6569::make_mc_table()
+MOS6569::~MOS6569()
 {
-	mc_color_lookup[0] = b0c_color | (b0c_color << 8);
-	mc_color_lookup[1] = b1c_color | (b1c_color << 8);
-	mc_color_lookup[2] = b2c_color | (b2c_color << 8);
+	if (draw_thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(draw_mutex);
+			draw_quit = true;
+		}
+		draw_cond.notify_one();
+		draw_thread.join();
+	}
 }
 
 
@@ -402,14 +728,12 @@ void MOS6569::SetState(const MOS6569State *vd)
 
 	ec = vd->ec;
 	ec_color = colors[ec];
-	ec_color_long = (ec_color << 24) | (ec_color << 16) | (ec_color << 8) | ec_color;
 
 	b0c = vd->b0c; b1c = vd->b1c; b2c = vd->b2c; b3c = vd->b3c;
 	b0c_color = colors[b0c];
 	b1c_color = colors[b1c];
 	b2c_color = colors[b2c];
 	b3c_color = colors[b3c];
-	make_mc_table();
 
 	mm0 = vd->mm0; mm1 = vd->mm1;
 	mm0_color = colors[mm0];
@@ -653,32 +977,10 @@ void MOS6569::WriteRegister(uint16_t adr, uint8_t byte)
 			mxe = byte;
 			break;
 
-		case 0x20:
-			ec_color = colors[ec = byte];
-			ec_color_long = (ec_color << 24) | (ec_color << 16) | (ec_color << 8) | ec_color;
-			break;
-
-		case 0x21:
-			if (b0c != byte) {
-				b0c_color = colors[b0c = byte & 0xF];
-				make_mc_table();
-			}
-			break;
-
-		case 0x22: 
-			if (b1c != byte) {
-				b1c_color = colors[b1c = byte & 0xF];
-				make_mc_table();
-			}
-			break;
-
-		case 0x23: 
-			if (b2c != byte) {
-				b2c_color = colors[b2c = byte & 0xF];
-				make_mc_table();
-			}
-			break;
-
+		case 0x20: ec_color = colors[ec = byte]; break;
+		case 0x21: b0c_color = colors[b0c = byte & 0xF]; break;
+		case 0x22: b1c_color = colors[b1c = byte & 0xF]; break;
+		case 0x23: b2c_color = colors[b2c = byte & 0xF]; break;
 		case 0x24: b3c_color = colors[b3c = byte & 0xF]; break;
 		case 0x25: mm0_color = colors[mm0 = byte]; break;
 		case 0x26: mm1_color = colors[mm1 = byte]; break;
@@ -724,150 +1026,230 @@ void MOS6569::TriggerLightpen()
 
 
 /*
- *  Display line drawing routines...
+ *  Capture registers and graphics data needed for drawing the current
+ *  line, and compute the foreground mask of the graphics
  */
 
-inline void MOS6569::el_std_text(uint8_t *p, uint8_t *q, uint8_t *r)
+inline void MOS6569::capture_line(LineCmd &cmd)
 {
-	unsigned int b0cc = b0c;
-	uint32_t *lp = (uint32_t *)p;
-	uint8_t *cp = color_line;
-	uint8_t *mp = matrix_line;
+	cmd.display_state = display_state;
+	cmd.border_40_col = border_40_col;
+	cmd.display_idx = display_idx;
+	cmd.x_scroll = x_scroll;
+	cmd.bg_color[0] = b0c_color;
+	cmd.bg_color[1] = b1c_color;
+	cmd.bg_color[2] = b2c_color;
+	cmd.bg_color[3] = b3c_color;
+
+	uint8_t *gp = cmd.gfx_data;
+	uint8_t *r = cmd.fore_mask;
+
+	if (display_state) {
+		uint8_t *mp = matrix_line;
+		uint8_t *cp = color_line;
+		memcpy(cmd.matrix_line, mp, 40);
+		memcpy(cmd.color_line, cp, 40);
+
+		switch (display_idx) {
+
+			case 0: {	// Standard text
+				uint8_t *q = char_base + rc;
+				for (unsigned i = 0; i < 40; ++i) {
+					gp[i] = r[i] = q[mp[i] << 3];
+				}
+				break;
+			}
 
-	// Loop for 40 characters
-	for (int i=0; i<40; i++) {
-		uint8_t color = cp[i];
-		uint8_t data = r[i] = q[mp[i] << 3];
+			case 1: {	// Multicolor text
+				uint8_t *q = char_base + rc;
+				for (unsigned i = 0; i < 40; ++i) {
+					uint8_t data = gp[i] = q[mp[i] << 3];
+					if (cp[i] & 8) {
+						r[i] = (data & 0xaa) | (data & 0xaa) >> 1;
+					} else {
+						r[i] = data;
+					}
+				}
+				break;
+			}
+
+			case 2: {	// Standard bitmap
+				uint8_t *q = bitmap_base + (vc << 3) + rc;
+				for (unsigned i = 0; i < 40; ++i, q += 8) {
+					gp[i] = r[i] = *q;
+				}
+				break;
+			}
+
+			case 3: {	// Multicolor bitmap
+				uint8_t *q = bitmap_base + (vc << 3) + rc;
+				for (unsigned i = 0; i < 40; ++i, q += 8) {
+					uint8_t data = gp[i] = *q;
+					r[i] = (data & 0xaa) | (data & 0xaa) >> 1;
+				}
+				break;
+			}
+
+			case 4: {	// ECM text
+				uint8_t *q = char_base + rc;
+				for (unsigned i = 0; i < 40; ++i) {
+					r[i] = mp[i];
+					gp[i] = q[(mp[i] & 0x3f) << 3];
+				}
+				break;
+			}
+
+			default:	// Invalid mode (all black)
+				memset(r, 0, 40);
+				break;
+		}
+
+	} else {	// Idle state graphics
+		switch (display_idx) {
+
+			case 0:		// Standard text
+			case 1:		// Multicolor text
+			case 4:		// ECM text
+				gp[0] = *get_physical(ctrl1 & 0x40 ? 0x39ff : 0x3fff);
+				memset(r, gp[0], 40);
+				break;
 
-		*lp++ = TextColorTable[color][b0cc][data][0].b;
-		*lp++ = TextColorTable[color][b0cc][data][1].b;
+			case 3:		// Multicolor bitmap
+				gp[0] = *get_physical(0x3fff);
+				memset(r, gp[0], 40);
+				break;
+
+			default:	// Invalid mode (all black)
+				memset(r, 0, 40);
+				break;
+		}
+	}
+
+	cmd.sprite_on = sprite_on;
+	if (sprite_on) {
+		cmd.mm0_color = mm0_color;
+		cmd.mm1_color = mm1_color;
+		cmd.mxe = mxe;
+		cmd.mdp = mdp;
+		cmd.mmc = mmc;
+
+		for (unsigned snum = 0; snum < 8; ++snum) {
+			cmd.mx[snum] = mx[snum];
+			cmd.spr_color[snum] = spr_color[snum];
+
+			// Fetch sprite data
+			if ((sprite_on & (1 << snum)) && mx[snum] < DISPLAY_X-32) {
+				uint8_t *sdatap = get_physical(matrix_base[0x3f8 + snum] << 6 | mc[snum]);
+				cmd.spr_data[snum] = (*sdatap << 24) | (*(sdatap+1) << 16) | (*(sdatap+2) << 8);
+			}
+		}
 	}
 }
 
 
-inline void MOS6569::el_mc_text(uint8_t *p, uint8_t *q, uint8_t *r)
+/*
+ *  Display line drawing routines...
+ */
+
+inline void MOS6569::el_std_text(const LineCmd &cmd, uint8_t *p)
 {
-	uint16_t *wp = (uint16_t *)p;
-	uint8_t *cp = color_line;
-	uint8_t *mp = matrix_line;
-	uint16_t *mclp = mc_color_lookup;
+	uint8_t bg[40];
+	memset(bg, cmd.bg_color[0], 40);
+
+	expand_std(p, cmd.gfx_data, cmd.color_line, bg);
+}
 
-	// Loop for 40 characters
-	for (unsigned i = 0; i < 40; ++i) {
-		uint8_t data = q[mp[i] << 3];
 
+inline void MOS6569::el_mc_text(const LineCmd &cmd, uint8_t *p)
+{
+	const uint8_t *cp = cmd.color_line;
+	uint8_t multi[40], c0[40], c1[40], c2[40], c3[40];
+
+	memset(c0, cmd.bg_color[0], 40);
+	memset(c1, cmd.bg_color[1], 40);
+	memset(c2, cmd.bg_color[2], 40);
+
+	for (unsigned i = 0; i < 40; ++i) {
 		if (cp[i] & 8) {
-			uint8_t color = colors[cp[i] & 7];
-			r[i] = (data & 0xaa) | (data & 0xaa) >> 1;
-			mclp[3] = color | (color << 8);
-			*wp++ = mclp[(data >> 6) & 3];
-			*wp++ = mclp[(data >> 4) & 3];
-			*wp++ = mclp[(data >> 2) & 3];
-			*wp++ = mclp[(data >> 0) & 3];
-
-		} else { // Standard mode in multicolor mode
-			uint8_t color = cp[i];
-			r[i] = data;
-			*(uint32_t *)wp = TextColorTable[color][b0c][data][0].b;
-			wp += 2;
-			*(uint32_t *)wp = TextColorTable[color][b0c][data][1].b;
-			wp += 2;
+			multi[i] = 0xff;
+			c3[i] = colors[cp[i] & 7];
+		} else {	// Standard mode in multicolor mode
+			multi[i] = 0;
+			c3[i] = cp[i];
 		}
 	}
+
+	expand_multi(p, cmd.gfx_data, multi, c0, c1, c2, c3);
 }
 
 
-inline void MOS6569::el_std_bitmap(uint8_t *p, uint8_t *q, uint8_t *r)
+inline void MOS6569::el_std_bitmap(const LineCmd &cmd, uint8_t *p)
 {
-	uint32_t *lp = (uint32_t *)p;
-	uint8_t *mp = matrix_line;
-
-	// Loop for 40 characters
-	for (unsigned i = 0; i < 40; ++i, q += 8) {
-		uint8_t data = r[i] = *q;
-		uint8_t color = mp[i] >> 4;
-		uint8_t bcolor = mp[i] & 15;
+	const uint8_t *mp = cmd.matrix_line;
+	uint8_t fg[40], bg[40];
 
-		*lp++ = TextColorTable[color][bcolor][data][0].b;
-		*lp++ = TextColorTable[color][bcolor][data][1].b;
+	for (unsigned i = 0; i < 40; ++i) {
+		fg[i] = colors[mp[i] >> 4];
+		bg[i] = colors[mp[i]];
 	}
+
+	expand_std(p, cmd.gfx_data, fg, bg);
 }
 
 
-inline void MOS6569::el_mc_bitmap(uint8_t *p, uint8_t *q, uint8_t *r)
+inline void MOS6569::el_mc_bitmap(const LineCmd &cmd, uint8_t *p)
 {
-	uint16_t lookup[4];
-	uint16_t *wp = (uint16_t *)p - 1;
-	uint8_t *cp = color_line;
-	uint8_t *mp = matrix_line;
-
-	lookup[0] = (b0c_color << 8) | b0c_color;
-
-	// Loop for 40 characters
-	for (unsigned i = 0; i < 40; ++i, q+=8) {
-		uint8_t color, acolor, bcolor;
-
-		color = colors[mp[i] >> 4];
-		lookup[1] = (color << 8) | color;
-		bcolor = colors[mp[i]];
-		lookup[2] = (bcolor << 8) | bcolor;
-		acolor = colors[cp[i]];
-		lookup[3] = (acolor << 8) | acolor;
-
-		uint8_t data = *q;
-		r[i] = (data & 0xaa) | (data & 0xaa) >> 1;
-
-		*++wp = lookup[(data >> 6) & 3];
-		*++wp = lookup[(data >> 4) & 3];
-		*++wp = lookup[(data >> 2) & 3];
-		*++wp = lookup[(data >> 0) & 3];
+	const uint8_t *cp = cmd.color_line;
+	const uint8_t *mp = cmd.matrix_line;
+	uint8_t multi[40], c0[40], c1[40], c2[40], c3[40];
+
+	memset(multi, 0xff, 40);
+	memset(c0, cmd.bg_color[0], 40);
+
+	for (unsigned i = 0; i < 40; ++i) {
+		c1[i] = colors[mp[i] >> 4];
+		c2[i] = colors[mp[i]];
+		c3[i] = colors[cp[i]];
 	}
+
+	expand_multi(p, cmd.gfx_data, multi, c0, c1, c2, c3);
 }
 
 
-inline void MOS6569::el_ecm_text(uint8_t *p, uint8_t *q, uint8_t *r)
+inline void MOS6569::el_ecm_text(const LineCmd &cmd, uint8_t *p)
 {
-	uint32_t *lp = (uint32_t *)p;
-	uint8_t *cp = color_line;
-	uint8_t *mp = matrix_line;
-	uint8_t *bcp = &b0c;
+	const uint8_t *mp = cmd.matrix_line;
+	uint8_t bg[40];
 
-	// Loop for 40 characters
 	for (unsigned i = 0; i < 40; ++i) {
-		uint8_t data = r[i] = mp[i];
-		uint8_t color = cp[i];
-		uint8_t bcolor = bcp[(data >> 6) & 3];
-
-		data = q[(data & 0x3f) << 3];
-		*lp++ = TextColorTable[color][bcolor][data][0].b;
-		*lp++ = TextColorTable[color][bcolor][data][1].b;
+		bg[i] = cmd.bg_color[(mp[i] >> 6) & 3];
 	}
+
+	expand_std(p, cmd.gfx_data, cmd.color_line, bg);
 }
 
 
-inline void MOS6569::el_std_idle(uint8_t *p, uint8_t *r)
+inline void MOS6569::el_std_idle(const LineCmd &cmd, uint8_t *p)
 {
-	uint8_t data = *get_physical(ctrl1 & 0x40 ? 0x39ff : 0x3fff);
+	uint8_t data = cmd.gfx_data[0];
 	uint32_t *lp = (uint32_t *)p;
-	uint32_t conv0 = TextColorTable[0][b0c][data][0].b;
-	uint32_t conv1 = TextColorTable[0][b0c][data][1].b;
+	uint32_t conv0 = TextColorTable[0][cmd.bg_color[0]][data][0].b;
+	uint32_t conv1 = TextColorTable[0][cmd.bg_color[0]][data][1].b;
 
 	for (unsigned i = 0; i < 40; ++i) {
 		*lp++ = conv0;
 		*lp++ = conv1;
-		*r++ = data;
 	}
 }
 
 
-inline void MOS6569::el_mc_idle(uint8_t *p, uint8_t *r)
+inline void MOS6569::el_mc_idle(const LineCmd &cmd, uint8_t *p)
 {
-	uint8_t data = *get_physical(0x3fff);
+	uint8_t data = cmd.gfx_data[0];
 	uint32_t *lp = (uint32_t *)p - 1;
-	r--;
 
 	uint16_t lookup[4];
-	lookup[0] = (b0c_color << 8) | b0c_color;
+	lookup[0] = (cmd.bg_color[0] << 8) | cmd.bg_color[0];
 	lookup[1] = lookup[2] = lookup[3] = colors[0];
 
 	uint16_t conv0 = (lookup[(data >> 6) & 3] << 16) | lookup[(data >> 4) & 3];
@@ -876,228 +1258,137 @@ inline void MOS6569::el_mc_idle(uint8_t *p, uint8_t *r)
 	for (unsigned i = 0; i < 40; ++i) {
 		*++lp = conv0;
 		*++lp = conv1;
-		*++r = data;
 	}
 }
 
 
-inline void MOS6569::el_sprites(uint8_t *chunky_ptr)
+/*
+ *  Draw sprites of line and detect collisions, returns sprite-sprite
+ *  collisions in the lower and sprite-graphics collisions in the upper
+ *  byte. With DRAW = false, only the collisions are detected.
+ */
+
+template <bool DRAW>
+inline unsigned MOS6569::el_sprites(const LineCmd &cmd, uint8_t *chunky_ptr, uint8_t *mask_buf)
 {
 	unsigned spr_coll = 0, gfx_coll = 0;
 
+	// Set up foreground mask
+	memcpy(mask_buf + COL40_XSTART/8, cmd.fore_mask, 40);
+
+	// Pixel masks and X positions of the sprites already handled, which
+	// have higher priority than the following ones
+	uint64_t prio_pix[8];
+	unsigned prio_x[8];
+	uint8_t prio_bit[8];
+	unsigned num_prio = 0;
+
 	// Draw each active sprite
 	for (unsigned snum = 0; snum < 8; ++snum) {
 		uint8_t sbit = 1 << snum;
 
 		// Is sprite visible?
-		if ((sprite_on & sbit) && mx[snum] < DISPLAY_X-32) {
-			uint8_t *p = chunky_ptr + mx[snum] + 8;
-			uint8_t *q = spr_coll_buf + mx[snum] + 8;
-
-			// Fetch sprite data and mask
-			uint8_t *sdatap = get_physical(matrix_base[0x3f8 + snum] << 6 | mc[snum]);
-			uint32_t sdata = (*sdatap << 24) | (*(sdatap+1) << 16) | (*(sdatap+2) << 8);
+		if ((cmd.sprite_on & sbit) && cmd.mx[snum] < DISPLAY_X-32) {
+			unsigned x = cmd.mx[snum];
+			uint8_t *p = chunky_ptr + x + 8;
 
-			uint8_t color = spr_color[snum];
+			uint32_t sdata = cmd.spr_data[snum];
+			uint8_t color = cmd.spr_color[snum];
 
-			unsigned spr_mask_pos = mx[snum] + 8 - x_scroll;	// Sprite bit position in fore_mask_buf
-			unsigned sshift = spr_mask_pos & 7;
-			
-			uint8_t *fmbp = fore_mask_buf + (spr_mask_pos / 8);
-			uint32_t fore_mask = (fmbp[0] << 24) | (fmbp[1] << 16) | (fmbp[2] << 8) | (fmbp[3] << 0);
-			fore_mask = (fore_mask << sshift) | (fmbp[4] >> (8-sshift));
-
-			if (mxe & sbit) {		// X-expanded
-				if (mx[snum] >= DISPLAY_X-56)
+			// Expand sprite data to one bit per pixel, left-aligned
+			uint64_t spr_data;
+			if (cmd.mxe & sbit) {		// X-expanded
+				if (x >= DISPLAY_X-56)
 					continue;
 
-				// Fetch extra sprite mask
-				uint32_t sdata_l = 0, sdata_r = 0;
-				uint32_t fore_mask_r = (fmbp[4] << 24) | (fmbp[5] << 16) | (fmbp[6] << 8);
-				fore_mask_r <<= sshift;
-
-				if (mmc & sbit) {	// X-expanded multicolor mode
-					uint32_t plane0_l, plane0_r, plane1_l, plane1_r;
-
-					// Expand sprite data
-					sdata_l = MultiExpTable[sdata >> 24 & 0xff] << 16 | MultiExpTable[sdata >> 16 & 0xff];
-					sdata_r = MultiExpTable[sdata >> 8 & 0xff] << 16;
-
-					// Convert sprite chunky pixels to bitplanes
-					plane0_l = (sdata_l & 0x55555555) | (sdata_l & 0x55555555) << 1;
-					plane1_l = (sdata_l & 0xaaaaaaaa) | (sdata_l & 0xaaaaaaaa) >> 1;
-					plane0_r = (sdata_r & 0x55555555) | (sdata_r & 0x55555555) << 1;
-					plane1_r = (sdata_r & 0xaaaaaaaa) | (sdata_r & 0xaaaaaaaa) >> 1;
-
-					// Collision with graphics?
-					if ((fore_mask & (plane0_l | plane1_l)) || (fore_mask_r & (plane0_r | plane1_r))) {
-						gfx_coll |= sbit;
-					}
-
-					// Mask sprite if in background
-					if ((mdp & sbit) == 0) {
-						fore_mask = 0;
-						fore_mask_r = 0;
-					}
-
-					// Paint sprite
-					for (unsigned i = 0; i < 32; ++i, plane0_l <<= 1, plane1_l <<= 1, fore_mask <<= 1) {
-						uint8_t col;
-						if (plane1_l & 0x80000000) {
-							if (plane0_l & 0x80000000) {
-								col = mm1_color;
-							} else {
-								col = color;
-							}
-						} else {
-							if (plane0_l & 0x80000000) {
-								col = mm0_color;
-							} else {
-								continue;
-							}
-						}
-						if (q[i]) {	// Obscured by higher-priority data?
-							spr_coll |= q[i] | sbit;
-						} else if ((fore_mask & 0x80000000) == 0) {
-							p[i] = col;
-						}
-						q[i] |= sbit;
-					}
-					for (unsigned i = 32; i < 48; ++i, plane0_r <<= 1, plane1_r <<= 1, fore_mask_r <<= 1) {
-						uint8_t col;
-						if (plane1_r & 0x80000000) {
-							if (plane0_r & 0x80000000) {
-								col = mm1_color;
-							} else {
-								col = color;
-							}
-						} else {
-							if (plane0_r & 0x80000000) {
-								col = mm0_color;
-							} else {
-								continue;
-							}
-						}
-						if (q[i]) {	// Obscured by higher-priority data?
-							spr_coll |= q[i] | sbit;
-						} else if ((fore_mask_r & 0x80000000) == 0) {
-							p[i] = col;
-						}
-						q[i] |= sbit;
-					}
-
-				} else {			// X-expanded standard mode
-
-					// Expand sprite data
-					sdata_l = ExpTable[sdata >> 24 & 0xff] << 16 | ExpTable[sdata >> 16 & 0xff];
-					sdata_r = ExpTable[sdata >> 8 & 0xff] << 16;
-
-					// Collision with graphics?
-					if ((fore_mask & sdata_l) || (fore_mask_r & sdata_r)) {
-						gfx_coll |= sbit;
-					}
-
-					// Mask sprite if in background
-					if ((mdp & sbit) == 0) {
-						fore_mask = 0;
-						fore_mask_r = 0;
-					}
-
-					// Paint sprite
-					for (unsigned i = 0; i < 32; ++i, sdata_l <<= 1, fore_mask <<= 1) {
-						if (sdata_l & 0x80000000) {
-							if (q[i]) {	// Obscured by higher-priority data?
-								spr_coll |= q[i] | sbit;
-							} else if ((fore_mask & 0x80000000) == 0) {
-								p[i] = color;
-							}
-							q[i] |= sbit;
-						}
-					}
-					for (unsigned i = 32; i < 48; ++i, sdata_r <<= 1, fore_mask_r <<= 1) {
-						if (sdata_r & 0x80000000) {
-							if (q[i]) {	// Obscured by higher-priority data?
-								spr_coll |= q[i] | sbit;
-							} else if ((fore_mask_r & 0x80000000) == 0) {
-								p[i] = color;
-							}
-							q[i] |= sbit;
-						}
-					}
+				if (cmd.mmc & sbit) {
+					spr_data = (uint64_t(MultiExpTable[sdata >> 24 & 0xff]) << 48) | (uint64_t(MultiExpTable[sdata >> 16 & 0xff]) << 32) | (uint64_t(MultiExpTable[sdata >> 8 & 0xff]) << 16);
+				} else {
+					spr_data = (uint64_t(ExpTable[sdata >> 24 & 0xff]) << 48) | (uint64_t(ExpTable[sdata >> 16 & 0xff]) << 32) | (uint64_t(ExpTable[sdata >> 8 & 0xff]) << 16);
 				}
+			} else {					// Unexpanded
+				spr_data = uint64_t(sdata) << 32;
+			}
 
-			} else {				// Unexpanded
-
-				if (mmc & sbit) {	// Unexpanded multicolor mode
-					uint32_t plane0, plane1;
+			// Fetch 48 bits of foreground mask at sprite position
+			unsigned spr_mask_pos = x + 8 - cmd.x_scroll;	// Sprite bit position in mask_buf
+			unsigned sshift = spr_mask_pos & 7;
 
-					// Convert sprite chunky pixels to bitplanes
-					plane0 = (sdata & 0x55555555) | (sdata & 0x55555555) << 1;
-					plane1 = (sdata & 0xaaaaaaaa) | (sdata & 0xaaaaaaaa) >> 1;
+			uint8_t *fmbp = mask_buf + (spr_mask_pos / 8);
+			uint64_t fore_mask = (uint64_t(fmbp[0]) << 56) | (uint64_t(fmbp[1]) << 48) | (uint64_t(fmbp[2]) << 40) | (uint64_t(fmbp[3]) << 32)
+			                   | (uint64_t(fmbp[4]) << 24) | (uint64_t(fmbp[5]) << 16) | (uint64_t(fmbp[6]) << 8);
+			fore_mask <<= sshift;
+
+			// Convert sprite chunky pixels to bitplanes (a standard sprite
+			// is all plane 1)
+			uint64_t plane0, plane1;
+			if (cmd.mmc & sbit) {
+				plane0 = (spr_data & 0x5555555555555555) | (spr_data & 0x5555555555555555) << 1;
+				plane1 = (spr_data & 0xaaaaaaaaaaaaaaaa) | (spr_data & 0xaaaaaaaaaaaaaaaa) >> 1;
+			} else {
+				plane0 = 0;
+				plane1 = spr_data;
+			}
+			uint64_t spr_pix = plane0 | plane1;
 
-					// Collision with graphics?
-					if (fore_mask & (plane0 | plane1)) {
-						gfx_coll |= sbit;
-					}
+			// Collision with graphics?
+			if (fore_mask & spr_pix) {
+				gfx_coll |= sbit;
+			}
 
-					// Mask sprite if in background
-					if ((mdp & sbit) == 0) {
-						fore_mask = 0;
-					}
+			// Collision with higher-priority sprites?
+			uint64_t obscured = 0;
+			for (unsigned i = 0; i < num_prio; ++i) {
+				int dx = int(prio_x[i]) - int(x);
+				if (dx >= 48 || dx <= -48)
+					continue;
 
-					// Paint sprite
-					for (unsigned i = 0; i < 24; ++i, plane0 <<= 1, plane1 <<= 1, fore_mask <<= 1) {
-						uint8_t col;
-						if (plane1 & 0x80000000) {
-							if (plane0 & 0x80000000) {
-								col = mm1_color;
-							} else {
-								col = color;
-							}
-						} else {
-							if (plane0 & 0x80000000) {
-								col = mm0_color;
-							} else {
-								continue;
-							}
-						}
-						if (q[i]) {	// Obscured by higher-priority data?
-							spr_coll |= q[i] | sbit;
-						} else if ((fore_mask & 0x80000000) == 0) {
-							p[i] = col;
-						}
-						q[i] |= sbit;
-					}
+				uint64_t m = dx >= 0 ? prio_pix[i] >> dx : prio_pix[i] << -dx;
+				if (m & spr_pix) {
+					spr_coll |= prio_bit[i] | sbit;
+					obscured |= m;
+				}
+			}
 
-				} else {			// Unexpanded standard mode
+			prio_pix[num_prio] = spr_pix;
+			prio_x[num_prio] = x;
+			prio_bit[num_prio] = sbit;
+			++num_prio;
+
+			// Paint sprite where it is not obscured by higher-priority
+			// sprites or foreground graphics
+			if (DRAW) {
+				uint64_t draw_pix = spr_pix & ~obscured;
+				if (cmd.mdp & sbit) {
+					draw_pix &= ~fore_mask;
+				}
 
-					// Collision with graphics?
-					if (fore_mask & sdata) {
-						gfx_coll |= sbit;
-					}
-	
-					// Mask sprite if in background
-					if ((mdp & sbit) == 0) {
-						fore_mask = 0;
-					}
+				while (draw_pix) {
+					unsigned i = std::countl_zero(draw_pix);
+					uint64_t bit = 0x8000000000000000 >> i;
+					draw_pix &= ~bit;
 
-					// Paint sprite
-					for (unsigned i = 0; i < 24; ++i, sdata <<= 1, fore_mask <<= 1) {
-						if (sdata & 0x80000000) {
-							if (q[i]) {		// Obscured by higher-priority data?
-								spr_coll |= q[i] | sbit;
-							} else if ((fore_mask & 0x80000000) == 0) {
-								p[i] = color;
-							}
-							q[i] |= sbit;
-						}
+					if (plane1 & bit) {
+						p[i] = (plane0 & bit) ? cmd.mm1_color : color;
+					} else {
+						p[i] = cmd.mm0_color;
 					}
 				}
 			}
 		}
 	}
 
-	if (ThePrefs.SpriteCollisions) {
+	return spr_coll | (gfx_coll << 8);
+}
+
+
+/*
+ *  Latch detected sprite collisions, trigger collision IRQ
+ */
+
+void MOS6569::set_collisions(uint8_t spr_coll, uint8_t gfx_coll)
+{
+	if (the_c64->GetPrefs().SpriteCollisions) {
 
 		// Check sprite-sprite collisions
 		if (spr_coll) {
@@ -1128,6 +1419,286 @@ inline void MOS6569::el_sprites(uint8_t *chunky_ptr)
 }
 
 
+/*
+ *  Draw captured line into bitmap, returns detected sprite collisions
+ *  (see el_sprites())
+ */
+
+unsigned MOS6569::draw_line(const LineCmd &cmd, uint8_t *mask_buf)
+{
+	uint8_t *chunky_ptr = cmd.chunky_ptr;
+	uint32_t ec_color_long = cmd.ec_color * 0x01010101;
+
+	if (cmd.border_on) {
+
+		// Display border
+		uint32_t *lp = (uint32_t *)chunky_ptr - 1;
+		for (unsigned i = 0; i < DISPLAY_X/4; ++i) {
+			*++lp = ec_color_long;
+		}
+		return 0;
+	}
+
+	// Display window contents
+	uint8_t *p = chunky_ptr + COL40_XSTART;		// Pointer in chunky display buffer
+#ifdef ALIGNMENT_CHECK
+	uint8_t *use_p = ((((int)p) & 3) == 0) ? p : text_chunky_buf;
+#endif
+
+	{
+		p--;
+		uint8_t b0cc = cmd.bg_color[0];
+		unsigned limit = cmd.x_scroll;
+		for (unsigned i = 0; i < limit; ++i) {	// Background on the left if XScroll>0
+			*++p = b0cc;
+		}
+		p++;
+	}
+
+	if (cmd.display_state) {
+		switch (cmd.display_idx) {
+
+			case 0:	// Standard text
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_std_text(cmd, use_p);
+				if (use_p != p) {
+					memcpy(p, use_p, 8*40);
+				}
+#else
+				if (cmd.x_scroll) {
+					el_std_text(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else {
+					el_std_text(cmd, p);
+				}
+#endif
+#else
+				el_std_text(cmd, p);
+#endif
+				break;
+
+			case 1:	// Multicolor text
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_mc_text(cmd, use_p);
+				if (use_p != p) {
+					memcpy(p, use_p, 8*40);
+				}
+#else
+				if (cmd.x_scroll) {
+					el_mc_text(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else {
+					el_mc_text(cmd, p);
+				}
+#endif
+#else
+				el_mc_text(cmd, p);
+#endif
+				break;
+
+			case 2:	// Standard bitmap
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_std_bitmap(cmd, use_p);
+				if (use_p != p)
+					memcpy(p, use_p, 8*40);
+#else
+				if (cmd.x_scroll) {
+					el_std_bitmap(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else
+					el_std_bitmap(cmd, p);
+#endif
+#else
+				el_std_bitmap(cmd, p);
+#endif
+				break;
+
+			case 3:	// Multicolor bitmap
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_mc_bitmap(cmd, use_p);
+				if (use_p != p) {
+					memcpy(p, use_p, 8*40);
+				}
+#else
+				if (cmd.x_scroll) {
+					el_mc_bitmap(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else {
+					el_mc_bitmap(cmd, p);
+				}
+#endif
+#else
+				el_mc_bitmap(cmd, p);
+#endif
+				break;
+
+			case 4:	// ECM text
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_ecm_text(cmd, use_p);
+				if (use_p != p) {
+					memcpy(p, use_p, 8*40);
+				}
+#else
+				if (cmd.x_scroll) {
+					el_ecm_text(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else {
+					el_ecm_text(cmd, p);
+				}
+#endif
+#else
+				el_ecm_text(cmd, p);
+#endif
+				break;
+
+			default:	// Invalid mode (all black)
+				memset(p, colors[0], 320);
+				break;
+		}
+
+	} else {	// Idle state graphics
+		switch (cmd.display_idx) {
+
+			case 0:		// Standard text
+			case 1:		// Multicolor text
+			case 4:		// ECM text
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_std_idle(cmd, use_p);
+				if (use_p != p) {memcpy(p, use_p, 8*40);}
+#else
+				if (cmd.x_scroll) {
+					el_std_idle(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else {
+					el_std_idle(cmd, p);
+				}
+#endif
+#else
+				el_std_idle(cmd, p);
+#endif
+				break;
+
+			case 3:		// Multicolor bitmap
+#ifndef CAN_ACCESS_UNALIGNED
+#ifdef ALIGNMENT_CHECK
+				el_mc_idle(cmd, use_p);
+				if (use_p != p) {memcpy(p, use_p, 8*40);}
+#else
+				if (cmd.x_scroll) {
+					el_mc_idle(cmd, text_chunky_buf);
+					memcpy(p, text_chunky_buf, 8*40);					        
+				} else {
+					el_mc_idle(cmd, p);
+				}
+#endif
+#else
+				el_mc_idle(cmd, p);
+#endif
+				break;
+
+			default:	// Invalid mode (all black)
+				memset(p, colors[0], 320);
+				break;
+		}
+	}
+
+	// Draw sprites
+	unsigned coll = 0;
+	if (cmd.sprite_on) {
+		coll = el_sprites<true>(cmd, chunky_ptr, mask_buf);
+	}
+
+	// Handle left/right border
+	uint32_t *lp = (uint32_t *)chunky_ptr - 1;
+	uint32_t c = ec_color_long;
+	for (unsigned i = 0; i < COL40_XSTART/4; ++i) {
+		*++lp = c;
+	}
+	lp = (uint32_t *)(chunky_ptr + COL40_XSTOP) - 1;
+	for (unsigned i = 0; i < (DISPLAY_X-COL40_XSTOP)/4; ++i) {
+		*++lp = c;
+	}
+	if (!cmd.border_40_col) {
+		c = cmd.ec_color;
+		p = chunky_ptr + COL40_XSTART - 1;
+		for (unsigned i = 0; i < COL38_XSTART-COL40_XSTART; ++i) {
+			*++p = c;
+		}
+		p = chunky_ptr + COL38_XSTOP - 1;
+		for (unsigned i = 0; i < COL40_XSTOP-COL38_XSTOP; ++i) {
+			*++p = c;
+		}
+	}
+
+	return coll;
+}
+
+
+/*
+ *  Hand captured lines over to draw thread
+ */
+
+void MOS6569::submit_lines()
+{
+	{
+		std::lock_guard<std::mutex> lock(draw_mutex);
+		lines_submitted = num_line_cmds;
+	}
+	draw_cond.notify_one();
+}
+
+
+/*
+ *  Wait until all captured lines of the frame have been drawn
+ */
+
+void MOS6569::finish_frame()
+{
+	if (num_line_cmds > 0) {
+		submit_lines();
+
+		std::unique_lock<std::mutex> lock(draw_mutex);
+		draw_done_cond.wait(lock, [this]{ return lines_drawn == lines_submitted; });
+		lines_submitted = lines_drawn = 0;
+	}
+	num_line_cmds = 0;
+}
+
+
+/*
+ *  Draw thread: Draw lines handed over by submit_lines() until the VIC
+ *  is destroyed
+ */
+
+void MOS6569::draw_thread_func()
+{
+	std::unique_lock<std::mutex> lock(draw_mutex);
+
+	while (true) {
+		draw_cond.wait(lock, [this]{ return lines_drawn < lines_submitted || draw_quit; });
+		if (draw_quit)
+			break;
+
+		unsigned first = lines_drawn, last = lines_submitted;
+		lock.unlock();
+
+		for (unsigned i = first; i < last; ++i) {
+			draw_line(line_cmds[i], draw_fore_mask_buf);
+		}
+
+		lock.lock();
+		lines_drawn = last;
+		draw_done_cond.notify_one();
+	}
+}
+
+
 inline int MOS6569::el_update_mc(int raster)
 {
 	int i, j;
@@ -1189,8 +1760,7 @@ spr_off:
 
 unsigned MOS6569::EmulateLine(int & retCyclesLeft)
 {
-	int cycles_left = ThePrefs.NormalCycles;	// Cycles left for CPU
-	bool is_bad_line = false;
+	int cycles_left = the_c64->GetPrefs().NormalCycles;	// Cycles left for CPU
 
 	// Get raster counter into local variable for faster access and increment
 	unsigned raster = raster_y + 1;
@@ -1227,9 +1797,6 @@ unsigned MOS6569::EmulateLine(int & retCyclesLeft)
 	// Within the visible range?
 	if (raster >= FIRST_DISP_LINE && raster <= LAST_DISP_LINE) {
 
-		// Our output goes here
-		uint8_t *chunky_ptr = chunky_line_start;
-
 		// Set video counter
 		vc = vc_base;
 
@@ -1237,8 +1804,8 @@ unsigned MOS6569::EmulateLine(int & retCyclesLeft)
 		if (raster >= FIRST_DMA_LINE && raster <= LAST_DMA_LINE && ((raster & 7) == y_scroll) && bad_lines_enabled) {
 
 			// Turn on display
-			display_state = is_bad_line = true;
-			cycles_left = ThePrefs.BadLineCycles;
+			display_state = true;
+			cycles_left = the_c64->GetPrefs().BadLineCycles;
 			rc = 0;
 
 			// Read and latch 40 bytes from video matrix and color RAM
@@ -1261,254 +1828,41 @@ unsigned MOS6569::EmulateLine(int & retCyclesLeft)
 			border_on = false;
 		}
 
-		if (!border_on) {
-
-			// Display window contents
-			uint8_t *p = chunky_ptr + COL40_XSTART;		// Pointer in chunky display buffer
-			uint8_t *r = fore_mask_buf + COL40_XSTART/8;	// Pointer in foreground mask buffer
-#ifdef ALIGNMENT_CHECK
-			uint8_t *use_p = ((((int)p) & 3) == 0) ? p : text_chunky_buf;
-#endif
-
-			{
-				p--;
-				uint8_t b0cc = b0c_color;
-				unsigned limit = x_scroll;
-				for (unsigned i = 0; i < limit; ++i) {	// Background on the left if XScroll>0
-					*++p = b0cc;
-				}
-				p++;
-			}
+		// Capture line for drawing
+		LineCmd &cmd = line_cmds[num_line_cmds];
+		cmd.chunky_ptr = chunky_line_start;	// Our output goes here
+		cmd.border_on = border_on;
+		cmd.ec_color = ec_color;
 
+		if (!border_on) {
+			capture_line(cmd);
 			if (display_state) {
-				switch (display_idx) {
-
-					case 0:	// Standard text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_std_text(use_p, char_base + rc, r);
-						if (use_p != p) {
-							memcpy(p, use_p, 8*40);
-						}
-#else
-						if (x_scroll) {
-							el_std_text(text_chunky_buf, char_base + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else {
-							el_std_text(p, char_base + rc, r);
-						}
-#endif
-#else
-						el_std_text(p, char_base + rc, r);
-#endif
-						break;
-
-					case 1:	// Multicolor text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_mc_text(use_p, char_base + rc, r);
-						if (use_p != p) {
-							memcpy(p, use_p, 8*40);
-						}
-#else
-						if (x_scroll) {
-							el_mc_text(text_chunky_buf, char_base + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else {
-							el_mc_text(p, char_base + rc, r);
-						}
-#endif
-#else
-						el_mc_text(p, char_base + rc, r);
-#endif
-						break;
-
-					case 2:	// Standard bitmap
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_std_bitmap(use_p, bitmap_base + (vc << 3) + rc, r);
-						if (use_p != p)
-							memcpy(p, use_p, 8*40);
-#else
-						if (x_scroll) {
-							el_std_bitmap(text_chunky_buf, bitmap_base + (vc << 3) + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else
-							el_std_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-#else
-						el_std_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-						break;
-
-					case 3:	// Multicolor bitmap
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_mc_bitmap(use_p, bitmap_base + (vc << 3) + rc, r);
-						if (use_p != p) {
-							memcpy(p, use_p, 8*40);
-						}
-#else
-						if (x_scroll) {
-							el_mc_bitmap(text_chunky_buf, bitmap_base + (vc << 3) + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else {
-							el_mc_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-						}
-#endif
-#else
-						el_mc_bitmap(p, bitmap_base + (vc << 3) + rc, r);
-#endif
-						break;
-
-					case 4:	// ECM text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_ecm_text(use_p, char_base + rc, r);
-						if (use_p != p) {
-							memcpy(p, use_p, 8*40);
-						}
-#else
-						if (x_scroll) {
-							el_ecm_text(text_chunky_buf, char_base + rc, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else {
-							el_ecm_text(p, char_base + rc, r);
-						}
-#endif
-#else
-						el_ecm_text(p, char_base + rc, r);
-#endif
-						break;
-
-					default:	// Invalid mode (all black)
-						memset(p, colors[0], 320);
-						memset(r, 0, 40);
-						break;
-				}
 				vc += 40;
-
-			} else {	// Idle state graphics
-				switch (display_idx) {
-
-					case 0:		// Standard text
-					case 1:		// Multicolor text
-					case 4:		// ECM text
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_std_idle(use_p, r);
-						if (use_p != p) {memcpy(p, use_p, 8*40);}
-#else
-						if (x_scroll) {
-							el_std_idle(text_chunky_buf, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else {
-							el_std_idle(p, r);
-						}
-#endif
-#else
-						el_std_idle(p, r);
-#endif
-						break;
-
-					case 3:		// Multicolor bitmap
-#ifndef CAN_ACCESS_UNALIGNED
-#ifdef ALIGNMENT_CHECK
-						el_mc_idle(use_p, r);
-						if (use_p != p) {memcpy(p, use_p, 8*40);}
-#else
-						if (x_scroll) {
-							el_mc_idle(text_chunky_buf, r);
-							memcpy(p, text_chunky_buf, 8*40);					        
-						} else {
-							el_mc_idle(p, r);
-						}
-#endif
-#else
-						el_mc_idle(p, r);
-#endif
-						break;
-
-					default:	// Invalid mode (all black)
-						memset(p, colors[0], 320);
-						memset(r, 0, 40);
-						break;
-				}
-			}
-
-			// Draw sprites
-			if (sprite_on) {
-
-				// Clear sprite collision buffer
-				uint32_t *lp = (uint32_t *)spr_coll_buf - 1;
-				for (unsigned i = 0; i < DISPLAY_X/4; ++i) {
-					*++lp = 0;
-				}
-
-				el_sprites(chunky_ptr);
 			}
+		}
 
-			// Handle left/right border
-			uint32_t *lp = (uint32_t *)chunky_ptr - 1;
-			uint32_t c = ec_color_long;
-			for (unsigned i = 0; i < COL40_XSTART/4; ++i) {
-				*++lp = c;
-			}
-			lp = (uint32_t *)(chunky_ptr + COL40_XSTOP) - 1;
-			for (unsigned i = 0; i < (DISPLAY_X-COL40_XSTOP)/4; ++i) {
-				*++lp = c;
-			}
-			if (!border_40_col) {
-				c = ec_color;
-				p = chunky_ptr + COL40_XSTART - 1;
-				for (unsigned i = 0; i < COL38_XSTART-COL40_XSTART; ++i) {
-					*++p = c;
+		// Draw line now, or let the draw thread do it later, unless the
+		// frame is not displayed at all. Collisions are always detected
+		// here because they can be read by the CPU.
+		unsigned coll = 0;
+		bool coll_checked = false;
+		if (frame_visible) {
+			if (draw_thread.joinable()) {
+				++num_line_cmds;
+				if (num_line_cmds % DRAW_BATCH_LINES == 0) {
+					submit_lines();
 				}
-				p = chunky_ptr + COL38_XSTOP - 1;
-				for (unsigned i = 0; i < COL40_XSTOP-COL38_XSTOP; ++i) {
-					*++p = c;
-				}
-			}
-
-#if 0	// For debugging...
-			if (is_bad_line) {
-				chunky_ptr[DISPLAY_X-2] = colors[7];
-				chunky_ptr[DISPLAY_X-3] = colors[7];
-			}
-			if (rc & 1) {
-				chunky_ptr[DISPLAY_X-4] = colors[1];
-				chunky_ptr[DISPLAY_X-5] = colors[1];
-			}
-			if (rc & 2) {
-				chunky_ptr[DISPLAY_X-6] = colors[1];
-				chunky_ptr[DISPLAY_X-7] = colors[1];
-			}
-			if (rc & 4) {
-				chunky_ptr[DISPLAY_X-8] = colors[1];
-				chunky_ptr[DISPLAY_X-9] = colors[1];
-			}
-			if (ctrl1 & 0x40) {
-				chunky_ptr[DISPLAY_X-10] = colors[5];
-				chunky_ptr[DISPLAY_X-11] = colors[5];
-			}
-			if (ctrl1 & 0x20) {
-				chunky_ptr[DISPLAY_X-12] = colors[3];
-				chunky_ptr[DISPLAY_X-13] = colors[3];
-			}
-			if (ctrl2 & 0x10) {
-				chunky_ptr[DISPLAY_X-14] = colors[2];
-				chunky_ptr[DISPLAY_X-15] = colors[2];
-			}
-#endif
-		} else {
-
-			// Display border
-			uint32_t *lp = (uint32_t *)chunky_ptr - 1;
-			uint32_t c = ec_color_long;
-			for (unsigned i = 0; i < DISPLAY_X/4; ++i) {
-				*++lp = c;
+			} else {
+				coll = draw_line(cmd, fore_mask_buf);
+				coll_checked = true;
 			}
 		}
+		if (!border_on && sprite_on && !coll_checked) {
+			coll = el_sprites<false>(cmd, cmd.chunky_ptr, fore_mask_buf);
+		}
+		if (coll) {
+			set_collisions(coll & 0xff, coll >> 8);
+		}
 
 		// Increment pointer in chunky buffer
 		chunky_line_start += xmod;
@@ -1534,6 +1888,7 @@ unsigned MOS6569::EmulateLine(int & retCyclesLeft)
 	retCyclesLeft = cycles_left;
 
 	if (raster == 0) {
+		finish_frame();
 		return VIC_VBLANK;
 	} else {
 		return 0;
@@ -21,6 +21,21 @@
 #ifndef VIC_H
 #define VIC_H
 
+#ifndef FRODO_SC
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+
+#ifndef FRODO_SC
+// Functions for expanding the graphics data of the 40 characters of a line
+// into 320 pixels, in standard mode and multicolor mode
+using ExpandStdFunc = void (*)(uint8_t * p, const uint8_t * data, const uint8_t * fg, const uint8_t * bg);
+using ExpandMultiFunc = void (*)(uint8_t * p, const uint8_t * data, const uint8_t * multi, const uint8_t * c0, const uint8_t * c1, const uint8_t * c2, const uint8_t * c3);
+#endif
+
 
 // Define this if you have a processor that can do unaligned accesses quickly
 #if defined(__i386) || defined(__x86_64) || defined(mc68000) || defined(__MC68K__)
@@ -53,6 +68,9 @@ struct MOS6569State;
 class MOS6569 {
 public:
 	MOS6569(C64 *c64, Display *disp, MOS6510 *CPU, uint8_t *RAM, uint8_t *Char, uint8_t *Color);
+#ifndef FRODO_SC
+	~MOS6569();
+#endif
 
 	uint8_t ReadRegister(uint16_t adr);
 	void WriteRegister(uint16_t adr, uint8_t byte);
@@ -63,6 +81,8 @@ public:
 	unsigned EmulateLine(int & retCyclesLeft);
 #endif
 
+	void SetFrameVisible(bool visible) { frame_visible = visible; }	// Set whether next frame will be displayed
+
 	void ChangedVA(uint16_t new_va);	// CIA VA14/15 has changed
 	void TriggerLightpen();				// Trigger lightpen interrupt
 
@@ -119,8 +139,7 @@ private:
 	unsigned display_idx;			// Index of current display mode
 
 	long pad0;	// Keep buffers long-aligned
-	uint8_t spr_coll_buf[0x1f8];				// Buffer for sprite-sprite collisions and priorities
-	uint8_t fore_mask_buf[(0x200 + 48) / 8];	// Foreground mask for sprite-graphics collisions and priorities
+	uint8_t fore_mask_buf[(0x200 + 64) / 8];	// Foreground mask for sprite-graphics collisions and priorities
 												// (must be wider than line to handle X-expanded sprites under
 												// the left border (MxX = 0x1e1..0x1f7))
 #ifndef CAN_ACCESS_UNALIGNED
@@ -131,6 +150,7 @@ private:
 	bool border_on;				// Flag: Upper/lower border on (Frodo SC: Main border flip-flop)
 	bool bad_lines_enabled;		// Flag: Bad Lines enabled for this frame
 	bool lp_triggered;			// Flag: Lightpen was triggered in this frame
+	bool frame_visible;			// Flag: Current frame will be displayed (otherwise only collisions are detected)
 
 #ifdef FRODO_SC
 	uint8_t read_byte(uint16_t adr);
@@ -138,7 +158,7 @@ private:
 	void graphics_access();
 	void load_pixel_shifter(uint8_t gfx_data, uint8_t char_data, uint8_t color_data);
 	void draw_graphics();
-	void draw_sprites();
+	template <bool DRAW> void draw_sprites();
 	void draw_background();
 
 	unsigned cycle;					// Current cycle in line (1..63)
@@ -197,35 +217,75 @@ private:
 	};
 	SprLatch spr_latch[8];			// Latched sprite data for drawing
 #else
+	// Everything needed for drawing one raster line, captured by
+	// EmulateLine() so the line can be drawn later by the draw thread
+	struct LineCmd {
+		uint8_t *chunky_ptr;		// Output line in bitmap buffer
+		bool border_on;				// Flag: Line is covered by upper/lower border
+		bool display_state;			// Flag: Display state
+		bool border_40_col;			// Flag: 40 column border
+		uint8_t display_idx;		// Display mode
+		uint8_t x_scroll;			// X scroll value
+		uint8_t ec_color;			// Exterior color
+		uint8_t bg_color[4];		// Background colors 0..3
+		uint8_t mm0_color, mm1_color;	// Sprite multicolors
+		uint8_t spr_color[8];		// Sprite colors
+		uint8_t sprite_on;			// 8 flags: Sprite display active
+		uint8_t mxe, mdp, mmc;		// Sprite X expansion, priority, and multicolor flags
+		uint16_t mx[8];				// Sprite X positions
+		uint32_t spr_data[8];		// Sprite data (upper 24 bits)
+		uint8_t matrix_line[40];	// Video matrix and color RAM data of line
+		uint8_t color_line[40];
+		uint8_t gfx_data[40];		// Graphics data from char generator or bitmap (idle state: only first byte)
+		uint8_t fore_mask[40];		// Foreground mask of graphics
+	};
+
 	uint8_t *get_physical(uint16_t adr);
-	void make_mc_table();
-	void el_std_text(uint8_t *p, uint8_t *q, uint8_t *r);
-	void el_mc_text(uint8_t *p, uint8_t *q, uint8_t *r);
-	void el_std_bitmap(uint8_t *p, uint8_t *q, uint8_t *r);
-	void el_mc_bitmap(uint8_t *p, uint8_t *q, uint8_t *r);
-	void el_ecm_text(uint8_t *p, uint8_t *q, uint8_t *r);
-	void el_std_idle(uint8_t *p, uint8_t *r);
-	void el_mc_idle(uint8_t *p, uint8_t *r);
-	void el_sprites(uint8_t *chunky_ptr);
+	void capture_line(LineCmd &cmd);
+	unsigned draw_line(const LineCmd &cmd, uint8_t *mask_buf);
+	void el_std_text(const LineCmd &cmd, uint8_t *p);
+	void el_mc_text(const LineCmd &cmd, uint8_t *p);
+	void el_std_bitmap(const LineCmd &cmd, uint8_t *p);
+	void el_mc_bitmap(const LineCmd &cmd, uint8_t *p);
+	void el_ecm_text(const LineCmd &cmd, uint8_t *p);
+	void el_std_idle(const LineCmd &cmd, uint8_t *p);
+	void el_mc_idle(const LineCmd &cmd, uint8_t *p);
+	template <bool DRAW> unsigned el_sprites(const LineCmd &cmd, uint8_t *chunky_ptr, uint8_t *mask_buf);
+	void set_collisions(uint8_t spr_coll, uint8_t gfx_coll);
 	int el_update_mc(int raster);
 
+	void submit_lines();
+	void finish_frame();
+	void draw_thread_func();
+
 	uint8_t colors[256];			// Indices of the 16 C64 colors (16 times mirrored to avoid "& 0x0f")
+	ExpandStdFunc expand_std;		// Graphics expansion functions selected for host CPU
+	ExpandMultiFunc expand_multi;
 
 	uint8_t ec_color, b0c_color, b1c_color,
 	        b2c_color, b3c_color;	// Indices for exterior/background colors
 	uint8_t mm0_color, mm1_color;	// Indices for MOB multicolors
 	uint8_t spr_color[8];			// Indices for MOB colors
 
-	uint32_t ec_color_long;			// ec_color expanded to 32 bits
-
-	uint16_t mc_color_lookup[4];
-
 	bool border_40_col;				// Flag: 40 column border
 	uint8_t sprite_on;				// 8 flags: Sprite display/DMA active
 
 	uint8_t *matrix_base;			// Video matrix base
 	uint8_t *char_base;				// Character generator base
 	uint8_t *bitmap_base;			// Bitmap base
+
+	std::vector<LineCmd> line_cmds;	// Captured lines of current frame
+	unsigned num_line_cmds;			// Number of captured lines
+
+	std::thread draw_thread;		// Thread for drawing captured lines
+	std::mutex draw_mutex;			// Protects lines_submitted, lines_drawn, and draw_quit
+	std::condition_variable draw_cond;		// Signals new lines or quit request to draw thread
+	std::condition_variable draw_done_cond;	// Signals drawn lines to emulation thread
+	unsigned lines_submitted;		// Number of lines handed over to draw thread
+	unsigned lines_drawn;			// Number of lines drawn by draw thread
+	bool draw_quit;					// Flag: Draw thread shall quit
+
+	uint8_t draw_fore_mask_buf[(0x200 + 64) / 8];	// Foreground mask buffer of draw thread
 #endif
 };
 
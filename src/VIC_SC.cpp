@@ -38,6 +38,8 @@
 #include "Display.h"
 #include "Prefs.h"
 
+#include <bit>
+
 
 // Define to enable VIC state overlay
 #undef VIS_DEBUG
@@ -181,6 +183,7 @@ MOS6569::MOS6569(C64 *c64, Display *disp, MOS6510 *CPU, uint8_t *RAM, uint8_t *C
 	bad_lines_enabled = false;
 	lp_triggered = draw_this_line = false;
 	is_bad_line = false;
+	frame_visible = true;
 
     spr_adv_y = 0xff;
     spr_dma_on = spr_disp_on = 0;
@@ -191,7 +194,6 @@ MOS6569::MOS6569(C64 *c64, Display *disp, MOS6510 *CPU, uint8_t *RAM, uint8_t *C
 	}
 
 	memset(spr_latch, 0, sizeof(spr_latch));
-	memset(spr_coll_buf, 0, sizeof(spr_coll_buf));
 	memset(fore_mask_buf, 0, sizeof(fore_mask_buf));
 }
 
@@ -786,6 +788,11 @@ void MOS6569::draw_background()
 	if (!draw_this_line)
 		return;
 
+	if (!frame_visible) {
+		fore_mask_shifter = 0;
+		return;
+	}
+
 	uint8_t *p = chunky_ptr;
 	chunky_ptr += 8;
 
@@ -964,6 +971,22 @@ void MOS6569::draw_graphics()
 	uint8_t char_data = char_delay >> 8;
 	uint8_t color_data = color_delay >> 8;
 
+	if (!frame_visible) {
+
+		// Frame is not displayed, only set foreground mask for sprite
+		// collisions
+		uint8_t m0 = fore_mask_shifter << (8 - x_scroll);
+		if ((display_idx & 3) == 3 || ((display_idx & 3) == 1 && (color_data & 8))) {
+			fore_mask_shifter = (gfx_data & 0xaa) | ((gfx_data & 0xaa) >> 1);
+		} else {
+			fore_mask_shifter = gfx_data;
+		}
+		f[0] = m0 | (fore_mask_shifter >> x_scroll);
+
+		fore_mask_ptr++;
+		return;
+	}
+
 	if (x_scroll == 0) {
 
 		// Load next 8 pixels into shifter
@@ -997,7 +1020,7 @@ void MOS6569::draw_graphics()
 
 		// Draw new pixels
 		s = pixel_shifter;
-		for (unsigned i = 0; i < 8 - x_scroll; ++i) {
+		for (unsigned i = 0; i < 8u - x_scroll; ++i) {
 			*p++ = s & 0xf;
 			s = (s >> 4) | back_pixel;
 		}
@@ -1015,9 +1038,10 @@ void MOS6569::draw_graphics()
 
 
 /*
- *  Sprite display
+ *  Sprite display (with DRAW = false, only collisions are detected)
  */
 
+template <bool DRAW>
 inline void MOS6569::draw_sprites()
 {
 	unsigned spr_coll = 0, gfx_coll = 0;
@@ -1033,8 +1057,12 @@ inline void MOS6569::draw_sprites()
 	if (! draw_any_sprite)
 		return;
 
-	// Clear sprite collision/priority buffer
-	memset(spr_coll_buf, 0, sizeof(spr_coll_buf));
+	// Pixel masks and X positions of the sprites already handled, which
+	// have higher priority than the following ones
+	uint64_t prio_pix[8];
+	unsigned prio_x[8];
+	uint8_t prio_bit[8];
+	unsigned num_prio = 0;
 
 	// Loop for all sprites in descending order of priority
 	for (unsigned snum = 0; snum < 8; ++snum) {
@@ -1049,30 +1077,39 @@ inline void MOS6569::draw_sprites()
 			if (x >= DISPLAY_X - 8) {
 				p -= 0x1f8;
 			}
-			uint8_t *q = spr_coll_buf;
 
 			uint8_t color = latch->sc;
 
-			// Fetch sprite data and mask
+			// Fetch sprite data
 			uint32_t sdata = latch->data;
 			latch->data = 0;
 
+			// Fetch 48 bits of foreground mask at sprite position
 			unsigned spr_mask_pos = x + 8;	// Sprite bit position in fore_mask_buf
 			unsigned sshift = spr_mask_pos & 7;
 
 			uint8_t *fmbp = fore_mask_buf + (spr_mask_pos / 8);
-			uint32_t fore_mask = (fmbp[0] << 24) | (fmbp[1] << 16) | (fmbp[2] << 8) | (fmbp[3] << 0);
-			fore_mask = (fore_mask << sshift) | (fmbp[4] >> (8-sshift));
+			uint64_t fore_mask = (uint64_t(fmbp[0]) << 56) | (uint64_t(fmbp[1]) << 48) | (uint64_t(fmbp[2]) << 40) | (uint64_t(fmbp[3]) << 32)
+			                   | (uint64_t(fmbp[4]) << 24) | (uint64_t(fmbp[5]) << 16) | (uint64_t(fmbp[6]) << 8);
+			fore_mask <<= sshift;
+
+			// Expand sprite data to one bit per pixel, left-aligned
+			uint64_t spr_data;
+			unsigned first_pix = 0, last_pix;
 
 			if (latch->mxe) {		// X-expanded
+				if (latch->mmc) {
+					spr_data = (uint64_t(MultiExpTable[sdata >> 24 & 0xff]) << 48) | (uint64_t(MultiExpTable[sdata >> 16 & 0xff]) << 32) | (uint64_t(MultiExpTable[sdata >> 8 & 0xff]) << 16);
+				} else {
+					spr_data = (uint64_t(ExpTable[sdata >> 24 & 0xff]) << 48) | (uint64_t(ExpTable[sdata >> 16 & 0xff]) << 32) | (uint64_t(ExpTable[sdata >> 8 & 0xff]) << 16);
+				}
 
 				// Perform clipping
-				unsigned first_pix = 0;
 				if (x > 0x1c0 && x < 0x1f0) {
 					first_pix = 0x1f0 - x;		// Clipped on the left
 				}
 
-				unsigned last_pix = 48;
+				last_pix = 48;
 				if (x > (DISPLAY_X - 8 - 48)) {
 					if (x < (DISPLAY_X - 8)) {	// Clipped on the right
 						last_pix = DISPLAY_X - 8 - x;
@@ -1081,152 +1118,15 @@ inline void MOS6569::draw_sprites()
 					}
 				}
 
-				// Fetch extra sprite mask
-				uint32_t sdata_l = 0, sdata_r = 0;
-				uint32_t fore_mask_r = (fmbp[4] << 24) | (fmbp[5] << 16) | (fmbp[6] << 8);
-				fore_mask_r <<= sshift;
-
-				if (latch->mmc) {	// X-expanded multicolor mode
-					uint32_t plane0_l, plane0_r, plane1_l, plane1_r;
-
-					// Expand sprite data
-					sdata_l = MultiExpTable[sdata >> 24 & 0xff] << 16 | MultiExpTable[sdata >> 16 & 0xff];
-					sdata_r = MultiExpTable[sdata >> 8 & 0xff] << 16;
-
-					// Convert sprite chunky pixels to bitplanes
-					plane0_l = (sdata_l & 0x55555555) | (sdata_l & 0x55555555) << 1;
-					plane1_l = (sdata_l & 0xaaaaaaaa) | (sdata_l & 0xaaaaaaaa) >> 1;
-					plane0_r = (sdata_r & 0x55555555) | (sdata_r & 0x55555555) << 1;
-					plane1_r = (sdata_r & 0xaaaaaaaa) | (sdata_r & 0xaaaaaaaa) >> 1;
-
-					// Collision with graphics?
-					if ((fore_mask & (plane0_l | plane1_l)) || (fore_mask_r & (plane0_r | plane1_r))) {
-						gfx_coll |= sbit;
-					}
-
-					// Mask sprite if in background
-					if (!latch->mdp) {
-						fore_mask = 0;
-						fore_mask_r = 0;
-					}
-
-					// Paint sprite
-					for (unsigned i = 0; i < 32; ++i, plane0_l <<= 1, plane1_l <<= 1, fore_mask <<= 1) {
-						uint8_t col;
-						if (plane1_l & 0x80000000) {
-							if (plane0_l & 0x80000000) {
-								col = mm1;
-							} else {
-								col = color;
-							}
-						} else {
-							if (plane0_l & 0x80000000) {
-								col = mm0;
-							} else {
-								continue;
-							}
-						}
-
-						unsigned qi = x + i;
-						if (qi >= 0x1f8) { qi -= 0x1f8; }
-
-						if (q[qi]) {	// Obscured by higher-priority data?
-							spr_coll |= q[qi] | sbit;
-						} else if ((fore_mask & 0x80000000) == 0) {
-							if (i >= first_pix && i < last_pix) {
-								p[i] = col;
-							}
-						}
-						q[qi] |= sbit;
-					}
-					for (unsigned i = 32; i < 48; ++i, plane0_r <<= 1, plane1_r <<= 1, fore_mask_r <<= 1) {
-						uint8_t col;
-						if (plane1_r & 0x80000000) {
-							if (plane0_r & 0x80000000) {
-								col = mm1;
-							} else {
-								col = color;
-							}
-						} else {
-							if (plane0_r & 0x80000000) {
-								col = mm0;
-							} else {
-								continue;
-							}
-						}
-
-						unsigned qi = x + i;
-						if (qi >= 0x1f8) { qi -= 0x1f8; }
-
-						if (q[qi]) {		// Obscured by higher-priority data?
-							spr_coll |= q[qi] | sbit;
-						} else if ((fore_mask_r & 0x80000000) == 0) {
-							if (i >= first_pix && i < last_pix) {
-								p[i] = col;
-							}
-						}
-						q[qi] |= sbit;
-					}
-
-				} else {			// X-expanded standard mode
-
-					// Expand sprite data
-					sdata_l = ExpTable[sdata >> 24 & 0xff] << 16 | ExpTable[sdata >> 16 & 0xff];
-					sdata_r = ExpTable[sdata >> 8 & 0xff] << 16;
-
-					// Collision with graphics?
-					if ((fore_mask & sdata_l) || (fore_mask_r & sdata_r)) {
-						gfx_coll |= sbit;
-					}
-
-					// Mask sprite if in background
-					if (!latch->mdp) {
-						fore_mask = 0;
-						fore_mask_r = 0;
-					}
-
-					// Paint sprite
-					for (unsigned i = 0; i < 32; ++i, sdata_l <<= 1, fore_mask <<= 1) {
-						if (sdata_l & 0x80000000) {
-							unsigned qi = x + i;
-							if (qi >= 0x1f8) { qi -= 0x1f8; }
-
-							if (q[qi]) {	// Obscured by higher-priority data?
-								spr_coll |= q[qi] | sbit;
-							} else if ((fore_mask & 0x80000000) == 0) {
-								if (i >= first_pix && i < last_pix) {
-									p[i] = color;
-								}
-							}
-							q[qi] |= sbit;
-						}
-					}
-					for (unsigned i = 32; i < 48; ++i, sdata_r <<= 1, fore_mask_r <<= 1) {
-						if (sdata_r & 0x80000000) {
-							unsigned qi = x + i;
-							if (qi >= 0x1f8) { qi -= 0x1f8; }
-
-							if (q[qi]) {	// Obscured by higher-priority data?
-								spr_coll |= q[qi] | sbit;
-							} else if ((fore_mask_r & 0x80000000) == 0) {
-								if (i >= first_pix && i < last_pix) {
-									p[i] = color;
-								}
-							}
-							q[qi] |= sbit;
-						}
-					}
-				}
-
 			} else {				// Unexpanded
+				spr_data = uint64_t(sdata) << 32;
 
 				// Perform clipping
-				unsigned first_pix = 0;
 				if (x > 0x1d8 && x < 0x1f0) {
 					first_pix = 0x1f0 - x;		// Clipped on the left
 				}
 
-				unsigned last_pix = 24;
+				last_pix = 24;
 				if (x > (DISPLAY_X - 8 - 24)) {
 					if (x < (DISPLAY_X - 8)) {	// Clipped on the right
 						last_pix = DISPLAY_X - 8 - x;
@@ -1234,88 +1134,74 @@ inline void MOS6569::draw_sprites()
 						last_pix = 0;
 					}
 				}
+			}
 
-				if (latch->mmc) {	// Unexpanded multicolor mode
-					uint32_t plane0, plane1;
-
-					// Convert sprite chunky pixels to bitplanes
-					plane0 = (sdata & 0x55555555) | (sdata & 0x55555555) << 1;
-					plane1 = (sdata & 0xaaaaaaaa) | (sdata & 0xaaaaaaaa) >> 1;
-
-					// Collision with graphics?
-					if (fore_mask & (plane0 | plane1)) {
-						gfx_coll |= sbit;
-					}
-
-					// Mask sprite if in background
-					if (!latch->mdp) {
-						fore_mask = 0;
-					}
-
-					// Paint sprite
-					for (unsigned i = 0; i < 24; ++i, plane0 <<= 1, plane1 <<= 1, fore_mask <<= 1) {
-						uint8_t col;
-						if (plane1 & 0x80000000) {
-							if (plane0 & 0x80000000) {
-								col = mm1;
-							} else {
-								col = color;
-							}
-						} else {
-							if (plane0 & 0x80000000) {
-								col = mm0;
-							} else {
-								continue;
-							}
-						}
+			// Convert sprite chunky pixels to bitplanes (a standard sprite
+			// is all plane 1)
+			uint64_t plane0, plane1;
+			if (latch->mmc) {
+				plane0 = (spr_data & 0x5555555555555555) | (spr_data & 0x5555555555555555) << 1;
+				plane1 = (spr_data & 0xaaaaaaaaaaaaaaaa) | (spr_data & 0xaaaaaaaaaaaaaaaa) >> 1;
+			} else {
+				plane0 = 0;
+				plane1 = spr_data;
+			}
+			uint64_t spr_pix = plane0 | plane1;
 
-						unsigned qi = x + i;
-						if (qi >= 0x1f8) { qi -= 0x1f8; }
+			// Collision with graphics?
+			if (fore_mask & spr_pix) {
+				gfx_coll |= sbit;
+			}
 
-						if (q[qi]) {	// Obscured by higher-priority data?
-							spr_coll |= q[qi] | sbit;
-						} else if ((fore_mask & 0x80000000) == 0) {
-							if (i >= first_pix && i < last_pix) {
-								p[i] = col;
-							}
-						}
-						q[qi] |= sbit;
-					}
+			// Collision with higher-priority sprites? (X positions wrap
+			// around at 0x1f8)
+			uint64_t obscured = 0;
+			for (unsigned i = 0; i < num_prio; ++i) {
+				int dx = int(prio_x[i]) - int(x);
+				if (dx > 0x1f8 / 2) {
+					dx -= 0x1f8;
+				} else if (dx < -0x1f8 / 2) {
+					dx += 0x1f8;
+				}
+				if (dx >= 48 || dx <= -48)
+					continue;
 
-				} else {			// Unexpanded standard mode
+				uint64_t m = dx >= 0 ? prio_pix[i] >> dx : prio_pix[i] << -dx;
+				if (m & spr_pix) {
+					spr_coll |= prio_bit[i] | sbit;
+					obscured |= m;
+				}
+			}
 
-					// Collision with graphics?
-					if (fore_mask & sdata) {
-						gfx_coll |= sbit;
-					}
+			prio_pix[num_prio] = spr_pix;
+			prio_x[num_prio] = x;
+			prio_bit[num_prio] = sbit;
+			++num_prio;
+
+			// Paint sprite where it is not obscured by higher-priority
+			// sprites or foreground graphics
+			if (DRAW) {
+				uint64_t draw_pix = spr_pix & ~obscured & (~0ull >> first_pix) & ~(~0ull >> last_pix);
+				if (latch->mdp) {
+					draw_pix &= ~fore_mask;
+				}
 
-					// Mask sprite if in background
-					if (!latch->mdp) {
-						fore_mask = 0;
-					}
+				while (draw_pix) {
+					unsigned i = std::countl_zero(draw_pix);
+					uint64_t bit = 0x8000000000000000 >> i;
+					draw_pix &= ~bit;
 
-					// Paint sprite
-					for (unsigned i = 0; i < 24; ++i, sdata <<= 1, fore_mask <<= 1) {
-						if (sdata & 0x80000000) {
-							unsigned qi = x + i;
-							if (qi >= 0x1f8) { qi -= 0x1f8; }
-
-							if (q[qi]) {	// Obscured by higher-priority data?
-								spr_coll |= q[qi] | sbit;
-							} else if ((fore_mask & 0x80000000) == 0) {
-								if (i >= first_pix && i < last_pix) {
-									p[i] = color;
-								}
-							}
-							q[qi] |= sbit;
-						}
+					if (plane1 & bit) {
+						p[i] = (plane0 & bit) ? mm1 : color;
+					} else {
+						p[i] = mm0;
 					}
 				}
 			}
 		}
 	}
 
-	if (ThePrefs.SpriteCollisions) {
+	if (the_c64->GetPrefs().SpriteCollisions) {
 
 		// Check sprite-sprite collisions
 		if (spr_coll) {
@@ -1428,7 +1314,7 @@ inline void MOS6569::draw_sprites()
 
 // Sample border color for deferred drawing at end of line
 #define SampleBorderColor \
-	if (draw_this_line) { \
+	if (draw_this_line && frame_visible) { \
 		border_color_sample[cycle-13] = ec; \
 	}
 
@@ -1544,9 +1430,6 @@ unsigned MOS6569::EmulateCycle()
 
 				retFlags = VIC_VBLANK;
 
-				chunky_line_start = the_display->BitmapBase();
-				xmod = the_display->BitmapXMod();
-
 				// Trigger raster IRQ if IRQ in line 0
 				if (irq_raster == 0 && !hold_off_raster_irq) {
 					raster_irq();
@@ -1554,6 +1437,14 @@ unsigned MOS6569::EmulateCycle()
 					raster_irq_triggered = false;
 				}
 				hold_off_raster_irq = false;
+
+			} else if (raster_y == 1) {
+
+				// Get bitmap pointer for next frame. This must be done
+				// after the C64 VBlank activities because the display
+				// may have switched to a different buffer there
+				chunky_line_start = the_display->BitmapBase();
+				xmod = the_display->BitmapXMod();
 			}
 
 			// Our output goes here
@@ -1943,97 +1834,105 @@ unsigned MOS6569::EmulateCycle()
 				fore_mask_buf[0x218 / 8 + 1] = fore_mask_buf[COL40_XSTART / 8 + 1];
 				fore_mask_buf[0x218 / 8 + 2] = fore_mask_buf[COL40_XSTART / 8 + 2];
 
-				// Draw sprites
-				draw_sprites();
+				if (frame_visible) {
+
+					// Draw sprites
+					draw_sprites<true>();
 
-				// Draw border
-				if (border_on_sample[0]) {
-					for (unsigned i = 0; i < 4; ++i) {
-						memset8(chunky_line_start+i*8, border_color_sample[i+1]);
+					// Draw border
+					if (border_on_sample[0]) {
+						for (unsigned i = 0; i < 4; ++i) {
+							memset8(chunky_line_start+i*8, border_color_sample[i+1]);
+						}
 					}
-				}
-				if (border_on_sample[1]) {	// 38 columns: 7 pixels on left side
-					uint8_t c = border_color_sample[5];
-					chunky_line_start[4*8+0] = c;
-					chunky_line_start[4*8+1] = c;
-					chunky_line_start[4*8+2] = c;
-					chunky_line_start[4*8+3] = c;
-					chunky_line_start[4*8+4] = c;
-					chunky_line_start[4*8+5] = c;
-					chunky_line_start[4*8+6] = c;
-				}
-				if (border_on_sample[2]) {
-					chunky_line_start[4*8+7] = border_color_sample[5];
-					for (unsigned i = 5; i < 43; ++i) {
-						memset8(chunky_line_start+i*8, border_color_sample[i+1]);
+					if (border_on_sample[1]) {	// 38 columns: 7 pixels on left side
+						uint8_t c = border_color_sample[5];
+						chunky_line_start[4*8+0] = c;
+						chunky_line_start[4*8+1] = c;
+						chunky_line_start[4*8+2] = c;
+						chunky_line_start[4*8+3] = c;
+						chunky_line_start[4*8+4] = c;
+						chunky_line_start[4*8+5] = c;
+						chunky_line_start[4*8+6] = c;
 					}
-				}
-				if (border_on_sample[3]) {	// 38 columns: 9 pixels on right side
-					uint8_t c = border_color_sample[44];
-					chunky_line_start[42*8+7] = c;
-					memset8(chunky_line_start+43*8, c);
-				}
-				if (border_on_sample[4]) {
-					for (unsigned i = 44; i < DISPLAY_X/8; ++i) {
-						memset8(chunky_line_start+i*8, border_color_sample[i+1]);
+					if (border_on_sample[2]) {
+						chunky_line_start[4*8+7] = border_color_sample[5];
+						for (unsigned i = 5; i < 43; ++i) {
+							memset8(chunky_line_start+i*8, border_color_sample[i+1]);
+						}
+					}
+					if (border_on_sample[3]) {	// 38 columns: 9 pixels on right side
+						uint8_t c = border_color_sample[44];
+						chunky_line_start[42*8+7] = c;
+						memset8(chunky_line_start+43*8, c);
+					}
+					if (border_on_sample[4]) {
+						for (unsigned i = 44; i < DISPLAY_X/8; ++i) {
+							memset8(chunky_line_start+i*8, border_color_sample[i+1]);
+						}
 					}
-				}
 
 #ifdef VIS_DEBUG
-				for (unsigned c = 12; c <= 59; ++c) {
-					uint8_t * p = chunky_line_start + (c - 12) * 8;
+					for (unsigned c = 12; c <= 59; ++c) {
+						uint8_t * p = chunky_line_start + (c - 12) * 8;
 
-					// First pixel: BA/AEC state
-					if (vis_debug[c].ba_low) {
-						if (vis_debug[c].aec_delay) {
-							p[0] = 10;	// Light red: BA low, AEC clocking
-						} else {
-							p[0] = 2;	// Red: BA and AEC low
+						// First pixel: BA/AEC state
+						if (vis_debug[c].ba_low) {
+							if (vis_debug[c].aec_delay) {
+								p[0] = 10;	// Light red: BA low, AEC clocking
+							} else {
+								p[0] = 2;	// Red: BA and AEC low
+							}
 						}
-					}
 
-					// Pixel 1: Display mode
-					if (vis_debug[c].display_state) {
-						unsigned idx = vis_debug[c].display_idx;
-						if (idx == 0) {
-							p[1] = 5;	// Green: standard text
-						} else if (idx == 1 || idx == 4) {
-							p[1] = 13;	// Light green: multicolor text
-						} else if (idx == 2) {
-							p[1] = 6;	// Blue: standard bitmap
-						} else if (idx == 3) {
-							p[1] = 14;	// Light blue: multicolor bitmap
+						// Pixel 1: Display mode
+						if (vis_debug[c].display_state) {
+							unsigned idx = vis_debug[c].display_idx;
+							if (idx == 0) {
+								p[1] = 5;	// Green: standard text
+							} else if (idx == 1 || idx == 4) {
+								p[1] = 13;	// Light green: multicolor text
+							} else if (idx == 2) {
+								p[1] = 6;	// Blue: standard bitmap
+							} else if (idx == 3) {
+								p[1] = 14;	// Light blue: multicolor bitmap
+							} else {
+								p[1] = 7;	// Yellow: invalid
+							}
 						} else {
-							p[1] = 7;	// Yellow: invalid
+							p[1] = 12;		// Gray: idle
 						}
-					} else {
-						p[1] = 12;		// Gray: idle
-					}
 
-					if (raster_y >= FIRST_DMA_LINE && raster_y < LAST_DMA_LINE + 8 && vis_debug[c].display_state) {
+						if (raster_y >= FIRST_DMA_LINE && raster_y < LAST_DMA_LINE + 8 && vis_debug[c].display_state) {
 
-						// Pixel 2: Video matrix base
-						p[2] = vis_debug[c].vbase >> 4;
+							// Pixel 2: Video matrix base
+							p[2] = vis_debug[c].vbase >> 4;
 
-						// Pixel 3: Character generator base
-						p[3] = vis_debug[c].vbase & 0x0f;
-					}
-
-					// Pixels 4..6: RC
-					if (c == 13 || c == 14 || c ==57 || c == 58) {
-						if (vis_debug[c].rc & 4) {
-							p[4] = 15;
+							// Pixel 3: Character generator base
+							p[3] = vis_debug[c].vbase & 0x0f;
 						}
-						if (vis_debug[c].rc & 2) {
-							p[5] = 15;
-						}
-						if (vis_debug[c].rc & 1) {
-							p[6] = 15;
+
+						// Pixels 4..6: RC
+						if (c == 13 || c == 14 || c ==57 || c == 58) {
+							if (vis_debug[c].rc & 4) {
+								p[4] = 15;
+							}
+							if (vis_debug[c].rc & 2) {
+								p[5] = 15;
+							}
+							if (vis_debug[c].rc & 1) {
+								p[6] = 15;
+							}
 						}
 					}
-				}
 #endif
 
+				} else {
+
+					// Frame is not displayed, only detect sprite collisions
+					draw_sprites<false>();
+				}
+
 				// Increment pointer in chunky buffer
 				chunky_line_start += xmod;
 			}
@@ -156,16 +156,24 @@ int Frodo::ReadyToRun()
 		ThePrefs.ParseItem(item);
 	}
 
+	// Initialize video, audio, and controller subsystems unless running headless
+	if (! ThePrefs.Headless) {
+		if (SDL_InitSubSystem(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER) < 0) {
+			fprintf(stderr, "Cannot initialize SDL: %s\n", SDL_GetError());
+			return 1;
+		}
+	}
+
 #ifdef HAVE_GTK
 	// Show preferences editor
-	if (! ThePrefs.AutoStart) {
+	if (! ThePrefs.AutoStart && ! ThePrefs.Headless) {
 		if (! ThePrefs.ShowEditor(true, prefs_path, snapshot_path))
 			return 0;  // "Quit" clicked
 	}
 #endif
 
 	// Create and start C64
-	TheC64 = new C64;
+	TheC64 = new C64(ThePrefs);
 	int exit_code = TheC64->Run();
 
 	// Save test screenshot on exit if requested
@@ -173,6 +181,9 @@ int Frodo::ReadyToRun()
 		save_test_screenshot(ThePrefs.TestScreenshotPath);
 	}
 
+	// Keep settings changed while running (e.g. controller assignment)
+	ThePrefs = TheC64->GetPrefs();
+
 	// Shutdown
 	delete TheC64;
 
@@ -189,11 +200,10 @@ int Frodo::ReadyToRun()
 
 bool Frodo::RunPrefsEditor()
 {
-	auto prefs = std::make_unique<Prefs>(ThePrefs);
+	auto prefs = std::make_unique<Prefs>(TheC64->GetPrefs());
 	bool result = prefs->ShowEditor(false, prefs_path, snapshot_path);
 	if (result) {
 		TheC64->NewPrefs(prefs.get());
-		ThePrefs = *prefs;
 	}
 	return result;
 }
@@ -290,7 +300,8 @@ int main(int argc, char ** argv)
 	fflush(stdout);
 #endif
 
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) < 0) {
+	// Video and audio are initialized later, after the preferences are loaded
+	if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) < 0) {
 		fprintf(stderr, "Cannot initialize SDL: %s\n", SDL_GetError());
 		return 1;
 	}